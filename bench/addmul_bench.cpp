@@ -0,0 +1,113 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <array>
+#include <string>
+#include <vector>
+#include "benchmark/benchmark.h"
+
+#include "addmul.hpp"
+#include "bench.hpp"
+
+namespace infectious::bench {
+
+namespace {
+
+// a multiplier with no special structure.
+constexpr uint8_t multiplier = 0x8e;
+
+// the number of inputs summed by the dot product benchmarks.
+constexpr size_t dot_inputs = 8;
+
+// sizes run from a single cache line to well past the last level cache.
+constexpr int64_t min_size = 64;
+constexpr int64_t max_size = 64L << 20;
+constexpr int size_multiplier = 8;
+
+// the mixed multiplier benchmark cycles through every nonzero multiplier,
+// over blocks small enough that the whole input stays in L1 cache too.
+constexpr size_t mixed_blocks = 256;
+constexpr int64_t mixed_min_block = 16;
+constexpr int64_t mixed_max_block = 128;
+constexpr int mixed_multiplier = 2;
+
+// bench_kernel measures a provider's addmul kernel, with the portable loop
+// finishing whatever tail it leaves, as the library does.
+void bench_kernel(benchmark::State& state, const internal::AddmulProvider* provider) {
+	const auto size = static_cast<size_t>(state.range(0));
+	const auto x = random_bytes(size);
+	std::vector<uint8_t> z(size);
+
+	for (auto _ : state) {
+		const size_t done = provider->kernel(z.data(), x.data(), multiplier, size);
+		internal::addmul_scalar(z.data() + done, x.data() + done, multiplier, size - done);
+		benchmark::DoNotOptimize(z.data());
+		benchmark::ClobberMemory();
+	}
+	set_throughput(state, size);
+}
+
+// bench_dot measures a provider's dot product kernel over dot_inputs inputs
+// of the given size each. The bytes processed are those read.
+void bench_dot(benchmark::State& state, const internal::AddmulProvider* provider) {
+	const auto size = static_cast<size_t>(state.range(0));
+	std::vector<std::vector<uint8_t>> inputs;
+	std::array<const uint8_t*, dot_inputs> xs {};
+	std::array<uint8_t, dot_inputs> ys {};
+	for (size_t i = 0; i < dot_inputs; ++i) {
+		inputs.push_back(random_bytes(size, static_cast<uint32_t>(i + 1)));
+		xs[i] = inputs.back().data();
+		ys[i] = static_cast<uint8_t>(multiplier + i);
+	}
+	std::vector<uint8_t> z(size);
+
+	for (auto _ : state) {
+		const size_t done = provider->dot(z.data(), xs.data(), ys.data(), dot_inputs, 0, size);
+		internal::addmul_dot_scalar(z.data(), xs.data(), ys.data(), dot_inputs, done, size - done);
+		benchmark::DoNotOptimize(z.data());
+		benchmark::ClobberMemory();
+	}
+	set_throughput(state, size * dot_inputs);
+}
+
+// bench_mixed is bench_kernel, but working through the input in blocks of
+// the given size, with a different multiplier for every block, as matrix
+// multiplication and inversion do. Between them the multipliers touch every
+// row of a provider's tables, so this shows how well those stay in L1 cache
+// alongside the data, where bench_kernel only ever needs one row.
+void bench_mixed(benchmark::State& state, const internal::AddmulProvider* provider) {
+	const auto block = static_cast<size_t>(state.range(0));
+	const size_t size = mixed_blocks * block;
+	const auto x = random_bytes(size);
+	std::vector<uint8_t> z(size);
+
+	for (auto _ : state) {
+		for (size_t b = 0; b < mixed_blocks; ++b) {
+			const auto y = static_cast<uint8_t>(1 + b % (mixed_blocks - 1));
+			const size_t done = provider->kernel(&z[b * block], &x[b * block], y, block);
+			internal::addmul_scalar(&z[b * block + done], &x[b * block + done], y, block - done);
+		}
+		benchmark::DoNotOptimize(z.data());
+		benchmark::ClobberMemory();
+	}
+	set_throughput(state, size);
+}
+
+} // namespace
+
+void register_addmul_benchmarks() {
+	for (const auto& provider : internal::addmul_provider_table()) {
+		if (!provider.supported()) {
+			continue;
+		}
+		const std::string name = provider.name;
+		benchmark::RegisterBenchmark(("Addmul/" + name).c_str(), bench_kernel, &provider)
+			->RangeMultiplier(size_multiplier)->Range(min_size, max_size);
+		benchmark::RegisterBenchmark(("AddmulDot/" + name).c_str(), bench_dot, &provider)
+			->RangeMultiplier(size_multiplier)->Range(min_size, max_size);
+		benchmark::RegisterBenchmark(("AddmulMixed/" + name).c_str(), bench_mixed, &provider)
+			->RangeMultiplier(mixed_multiplier)->Range(mixed_min_block, mixed_max_block);
+	}
+}
+
+} // namespace infectious::bench
@@ -0,0 +1,41 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_BENCH_HPP
+#define INFECTIOUS_BENCH_HPP
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "benchmark/benchmark.h"
+
+namespace infectious::bench {
+
+// random_bytes returns size bytes of pseudorandom data, the same every run.
+[[nodiscard]] inline auto random_bytes(size_t size, uint32_t seed = 1) -> std::vector<uint8_t> {
+	std::mt19937 generator(seed);
+	std::uniform_int_distribution<unsigned> distrib(0, UINT8_MAX);
+	std::vector<uint8_t> out(size);
+	for (auto& b : out) {
+		b = static_cast<uint8_t>(distrib(generator));
+	}
+	return out;
+}
+
+// set_throughput reports that every iteration processed bytes bytes, both
+// as Google Benchmark's usual bytes_per_second and as a decimal GB counter,
+// shown per second, which is what we compare releases by.
+inline void set_throughput(benchmark::State& state, size_t bytes) {
+	const auto total = static_cast<double>(bytes) * static_cast<double>(state.iterations());
+	state.SetBytesProcessed(static_cast<int64_t>(total));
+	state.counters["GB"] = benchmark::Counter(total / 1e9, benchmark::Counter::kIsRate);
+}
+
+// register_addmul_benchmarks registers the kernel benchmarks for every addmul
+// provider this CPU supports. They are registered at run time, as which
+// providers those are isn't known until then.
+void register_addmul_benchmarks();
+
+} // namespace infectious::bench
+
+#endif // INFECTIOUS_BENCH_HPP
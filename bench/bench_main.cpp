@@ -0,0 +1,17 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include "benchmark/benchmark.h"
+
+#include "bench.hpp"
+
+auto main(int argc, char** argv) -> int {
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+		return 1;
+	}
+	infectious::bench::register_addmul_benchmarks();
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
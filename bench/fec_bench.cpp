@@ -0,0 +1,219 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <span>
+#include <vector>
+#include "benchmark/benchmark.h"
+
+#include "infectious/fec.hpp"
+#include "infectious/fixed_fec.hpp"
+#include "bench.hpp"
+
+namespace infectious::bench {
+
+// clang-tidy doesn't much care for benchmark's macros either.
+// NOLINTBEGIN(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory)
+
+namespace {
+
+// every benchmark encodes about this much data per iteration.
+constexpr size_t data_size = 1UL << 20;
+
+// the (k, n) schemes benchmarked, from small local redundancy up to the
+// wide schemes used for storing data across many nodes. 4/8 and 29/80 are
+// the ones deployed.
+constexpr std::array<std::array<int, 2>, 5> schemes {{
+	{4, 6},
+	{4, 8},
+	{10, 14},
+	{16, 20},
+	{29, 80},
+}};
+
+void noop(int /*num*/, ByteView /*data*/) {}
+
+// Coder holds a FEC along with some data and all n of its shares.
+struct Coder {
+	Coder(int k, int n)
+		: fec(k, n)
+		, block_size {data_size / k}
+		, data(random_bytes(block_size * k))
+		, pieces(n, std::vector<uint8_t>(block_size))
+	{
+		std::vector<uint8_t*> outputs;
+		for (auto& piece : pieces) {
+			outputs.push_back(piece.data());
+		}
+		fec.EncodeInto(data, std::span<uint8_t* const>(outputs));
+	}
+
+	FEC fec;
+	size_t block_size;
+	std::vector<uint8_t> data;
+	std::vector<std::vector<uint8_t>> pieces;
+};
+
+void scheme_args(benchmark::internal::Benchmark* b) {
+	b->ArgNames({"k", "n"});
+	for (const auto& [k, n] : schemes) {
+		b->Args({k, n});
+	}
+}
+
+// missing_args runs every scheme with from none up to as many of the data
+// shares missing as there are parity shares to replace them.
+void missing_args(benchmark::internal::Benchmark* b) {
+	b->ArgNames({"k", "n", "missing"});
+	for (const auto& [k, n] : schemes) {
+		for (int missing = 0; missing <= std::min(n - k, k); ++missing) {
+			b->Args({k, n, missing});
+		}
+	}
+}
+
+// corrupt_args runs every scheme with no bad shares, one, and as many as can
+// be corrected.
+void corrupt_args(benchmark::internal::Benchmark* b) {
+	b->ArgNames({"k", "n", "bad"});
+	for (const auto& [k, n] : schemes) {
+		const int most = (n - k) / 2;
+		b->Args({k, n, 0});
+		if (most >= 1) {
+			b->Args({k, n, 1});
+		}
+		if (most > 1) {
+			b->Args({k, n, most});
+		}
+	}
+}
+
+void BM_Encode(benchmark::State& state) {
+	const Coder coder(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+	for (auto _ : state) {
+		coder.fec.Encode(coder.data, noop);
+	}
+	set_throughput(state, coder.data.size());
+}
+BENCHMARK(BM_Encode)->Apply(scheme_args);
+
+void BM_EncodeParity(benchmark::State& state) {
+	Coder coder(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+	std::vector<uint8_t*> parity;
+	for (int i = coder.fec.Required(); i < coder.fec.Total(); i++) {
+		parity.push_back(coder.pieces[i].data());
+	}
+	for (auto _ : state) {
+		coder.fec.EncodeParity(coder.data, std::span<uint8_t* const>(parity));
+		benchmark::ClobberMemory();
+	}
+	set_throughput(state, coder.data.size());
+}
+BENCHMARK(BM_EncodeParity)->Apply(scheme_args);
+
+// BM_FixedEncodeParity is BM_EncodeParity with the scheme fixed at compile
+// time, to compare against it.
+template <int K, int N>
+void BM_FixedEncodeParity(benchmark::State& state) {
+	Coder coder(K, N);
+	std::array<uint8_t*, N - K> parity {};
+	for (int i = K; i < N; i++) {
+		parity[i - K] = coder.pieces[i].data();
+	}
+	for (auto _ : state) {
+		FixedFEC<K, N>::EncodeParity(ByteView(coder.data.data(), coder.data.size()), parity);
+		benchmark::ClobberMemory();
+	}
+	set_throughput(state, coder.data.size());
+}
+BENCHMARK_TEMPLATE(BM_FixedEncodeParity, 4, 6);
+BENCHMARK_TEMPLATE(BM_FixedEncodeParity, 4, 8);
+BENCHMARK_TEMPLATE(BM_FixedEncodeParity, 10, 14);
+BENCHMARK_TEMPLATE(BM_FixedEncodeParity, 16, 20);
+BENCHMARK_TEMPLATE(BM_FixedEncodeParity, 29, 80);
+
+void BM_RebuildSorted(benchmark::State& state) {
+	const Coder coder(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+	const auto k = coder.fec.Required();
+	const auto n = coder.fec.Total();
+	const auto missing = static_cast<int>(state.range(2));
+
+	// drop the first missing data shares, and take the highest numbered
+	// parity shares in their place.
+	std::map<int, ByteView> shares;
+	for (int i = missing; i < k; i++) {
+		shares.try_emplace(i, coder.pieces[i].data(), coder.block_size);
+	}
+	for (int i = n - missing; i < n; i++) {
+		shares.try_emplace(i, coder.pieces[i].data(), coder.block_size);
+	}
+
+	for (auto _ : state) {
+		coder.fec.RebuildSorted(shares, noop);
+	}
+	set_throughput(state, coder.data.size());
+}
+BENCHMARK(BM_RebuildSorted)->Apply(missing_args);
+
+void BM_Correct(benchmark::State& state) {
+	const Coder coder(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+	const auto bad = static_cast<int>(state.range(2));
+
+	// every byte of the bad shares is wrong, as from a failing disk. Correct
+	// fixes them, so they are put back before each iteration.
+	auto corrupted = coder.pieces;
+	for (int i = 0; i < bad; i++) {
+		for (auto& b : corrupted[i]) {
+			b ^= 0x5a;
+		}
+	}
+	auto work = corrupted;
+
+	std::map<int, std::span<uint8_t>> shares;
+	for (size_t i = 0; i < work.size(); i++) {
+		shares.try_emplace(static_cast<int>(i), work[i]);
+	}
+
+	for (auto _ : state) {
+		if (bad > 0) {
+			state.PauseTiming();
+			for (int i = 0; i < bad; i++) {
+				std::copy(corrupted[i].begin(), corrupted[i].end(), work[i].begin());
+			}
+			state.ResumeTiming();
+		}
+		coder.fec.Correct(shares);
+	}
+	set_throughput(state, coder.data.size());
+}
+BENCHMARK(BM_Correct)->Apply(corrupt_args);
+
+// BM_Inversion measures building a decoding matrix, which is all RebuildBatch
+// does when given no stripes. It reports inversions per second, since there
+// is no data involved.
+void BM_Inversion(benchmark::State& state) {
+	const auto k = static_cast<int>(state.range(0));
+	const auto n = static_cast<int>(state.range(1));
+	const FEC fec(k, n);
+
+	// the highest numbered shares, which replace as many data shares as the
+	// scheme allows.
+	std::vector<int> share_nums;
+	for (int i = n - k; i < n; i++) {
+		share_nums.push_back(i);
+	}
+
+	for (auto _ : state) {
+		fec.RebuildBatch(share_nums, {}, 0, {});
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Inversion)->Apply(scheme_args);
+
+} // namespace
+
+// NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory)
+
+} // namespace infectious::bench
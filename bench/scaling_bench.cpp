@@ -0,0 +1,694 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+//
+// infectious-scaling sweeps the main FEC operations across schemes, share
+// sizes, missing and corrupt share counts and executor thread counts, to
+// show how throughput scales rather than how fast any one case is. Every
+// case reports, besides the usual times:
+//
+//  - GB: decimal gigabytes of data per second, as in infectious-bench;
+//  - cycles/B: time stamp counter ticks per byte of data, on x86 only. The
+//    counter runs at a fixed rate, not the core clock, and counts the wall
+//    time of the calling thread, so with threads > 1 this is wall cycles;
+//  - allocs/op: calls of operator new per operation, by any thread;
+//  - k, n, share_bytes, threads, missing and bad, so that CSV and JSON
+//    output can be plotted without picking the benchmark names apart.
+//
+// On top of Google Benchmark's own flags (--benchmark_filter,
+// --benchmark_out=<file>, --benchmark_out_format=json|csv, ...) it takes:
+//
+//  --schemes=K/N,...      the schemes to run, 1 <= K <= N <= 256
+//  --share_sizes=S,...    bytes per share, with an optional K, M or G suffix
+//  --threads=T,...        threads working on each operation; 1 runs without
+//                         an executor, T > 1 with a T-1 worker ThreadPool
+//  --matrix=M,...         vandermonde and/or cauchy
+//  --ops=OP,...           the operations to run, all of them by default
+//  --chunk=S              the executor chunk size (see FEC::SetExecutor)
+//  --stripe=S             the share size of each stripe for EncodeBatch and
+//                         RebuildBatch
+//  --max_memory=S         skip cases that need more memory than this
+//
+// For example, to compare the wide schemes on this machine:
+//
+//  infectious-scaling --schemes=29/80,64/128 --share_sizes=64K,1M,16M
+//      --benchmark_out=scaling.json --benchmark_out_format=json
+//
+// Two such JSON files can be compared, and a CI run failed on a regression,
+// with tools/compare.py from Google Benchmark.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "benchmark/benchmark.h"
+
+#include "infectious/build_env.h"
+#include "infectious/executor.hpp"
+#include "infectious/fec.hpp"
+#include "bench.hpp"
+
+#if defined(INFECTIOUS_TARGET_ARCH_IS_X86_64) || defined(INFECTIOUS_TARGET_ARCH_IS_X86_32)
+# include <x86intrin.h>
+# define INFECTIOUS_BENCH_HAS_TSC
+#endif
+
+// operator new and delete are replaced below to count allocations.
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+namespace {
+std::atomic<uint64_t> allocations {0};
+} // namespace
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+namespace infectious::bench {
+
+namespace {
+
+using namespace std::string_literals;
+
+constexpr size_t kib = 1UL << 10;
+constexpr size_t mib = 1UL << 20;
+constexpr size_t gib = 1UL << 30;
+
+enum class Op {
+	Encode,
+	EncodeSingle,
+	EncodeParity,
+	EncodeBatch,
+	RebuildSorted,
+	RebuildBatch,
+	Correct,
+};
+
+struct OpInfo {
+	Op op;
+	const char* name;
+	// whether the operation spreads its work over the FEC's executor.
+	bool parallel;
+	// whether the operation needs parity shares, and so n > k.
+	bool needs_parity;
+};
+
+constexpr std::array<OpInfo, 7> op_table {{
+	{Op::Encode, "Encode", true, false},
+	{Op::EncodeSingle, "EncodeSingle", true, true},
+	{Op::EncodeParity, "EncodeParity", true, true},
+	{Op::EncodeBatch, "EncodeBatch", false, true},
+	{Op::RebuildSorted, "RebuildSorted", true, false},
+	{Op::RebuildBatch, "RebuildBatch", false, false},
+	{Op::Correct, "Correct", true, false},
+}};
+
+struct Options {
+	std::vector<std::array<int, 2>> schemes {{10, 14}, {29, 80}, {64, 128}, {128, 256}};
+	std::vector<size_t> share_sizes {kib, 16*kib, 256*kib, 4*mib, 64*mib, gib};
+	std::vector<size_t> threads;
+	std::vector<FEC::Matrix> matrices {FEC::Matrix::Vandermonde};
+	std::vector<Op> ops;
+	size_t chunk {FEC::default_parallel_chunk};
+	size_t stripe {4*kib};
+	size_t max_memory {2*gib};
+};
+
+// Case is a single benchmark of the sweep. lost is the number of missing
+// shares for the rebuilds and of bad shares for Correct.
+struct Case {
+	OpInfo info;
+	int k;
+	int n;
+	size_t share_size;
+	FEC::Matrix matrix;
+	size_t threads;
+	int lost;
+	size_t chunk;
+	size_t stripe;
+};
+
+[[nodiscard]] auto split(std::string_view list) -> std::vector<std::string> {
+	std::vector<std::string> out;
+	while (!list.empty()) {
+		const auto comma = list.find(',');
+		out.emplace_back(list.substr(0, comma));
+		list.remove_prefix(comma == std::string_view::npos ? list.size() : comma + 1);
+	}
+	return out;
+}
+
+[[nodiscard]] auto parse_size(const std::string& text) -> size_t {
+	size_t used = 0;
+	const auto value = std::stoull(text, &used);
+	const auto suffix = text.substr(used);
+	if (suffix.empty()) {
+		return value;
+	}
+	if (suffix == "K") {
+		return value * kib;
+	}
+	if (suffix == "M") {
+		return value * mib;
+	}
+	if (suffix == "G") {
+		return value * gib;
+	}
+	throw std::invalid_argument("bad size "s + text);
+}
+
+[[nodiscard]] auto parse_scheme(const std::string& text) -> std::array<int, 2> {
+	const auto slash = text.find('/');
+	if (slash == std::string::npos) {
+		throw std::invalid_argument("bad scheme "s + text + ", want K/N");
+	}
+	const int k = std::stoi(text.substr(0, slash));
+	const int n = std::stoi(text.substr(slash + 1));
+	if (k < 1 || n < k || n > FEC::byte_max) {
+		throw std::invalid_argument("bad scheme "s + text + ", want 1 <= K <= N <= 256");
+	}
+	return {k, n};
+}
+
+[[nodiscard]] auto parse_matrix(const std::string& text) -> FEC::Matrix {
+	if (text == "vandermonde") {
+		return FEC::Matrix::Vandermonde;
+	}
+	if (text == "cauchy") {
+		return FEC::Matrix::Cauchy;
+	}
+	throw std::invalid_argument("bad matrix "s + text + ", want vandermonde or cauchy");
+}
+
+[[nodiscard]] auto parse_op(const std::string& text) -> Op {
+	for (const auto& info : op_table) {
+		if (text == info.name) {
+			return info.op;
+		}
+	}
+	throw std::invalid_argument("bad op "s + text);
+}
+
+template <typename T, typename Parse>
+[[nodiscard]] auto parse_list(const std::string& text, Parse parse) -> std::vector<T> {
+	std::vector<T> out;
+	for (const auto& item : split(text)) {
+		out.push_back(parse(item));
+	}
+	if (out.empty()) {
+		throw std::invalid_argument("empty list");
+	}
+	return out;
+}
+
+// parse_options takes our own flags out of argv, leaving the rest in place
+// for ReportUnrecognizedArguments.
+[[nodiscard]] auto parse_options(int& argc, char** argv) -> Options {
+	Options options;
+	const std::span<char*> args(argv, static_cast<size_t>(argc));
+	size_t kept = 1;
+	for (size_t i = 1; i < args.size(); ++i) {
+		const std::string_view arg = args[i];
+		const auto eq = arg.find('=');
+		const std::string flag(arg.substr(0, eq));
+		const std::string value(eq == std::string_view::npos ? "" : arg.substr(eq + 1));
+		if (flag == "--schemes") {
+			options.schemes = parse_list<std::array<int, 2>>(value, parse_scheme);
+		} else if (flag == "--share_sizes") {
+			options.share_sizes = parse_list<size_t>(value, parse_size);
+		} else if (flag == "--threads") {
+			options.threads = parse_list<size_t>(value, [](const std::string& t) { return std::max(parse_size(t), size_t {1}); });
+		} else if (flag == "--matrix") {
+			options.matrices = parse_list<FEC::Matrix>(value, parse_matrix);
+		} else if (flag == "--ops") {
+			options.ops = parse_list<Op>(value, parse_op);
+		} else if (flag == "--chunk") {
+			options.chunk = parse_size(value);
+		} else if (flag == "--stripe") {
+			options.stripe = std::max(parse_size(value), size_t {1});
+		} else if (flag == "--max_memory") {
+			options.max_memory = parse_size(value);
+		} else {
+			args[kept++] = args[i];
+		}
+	}
+	argc = static_cast<int>(kept);
+
+	if (options.threads.empty()) {
+		options.threads.push_back(1);
+		if (const auto hw = std::thread::hardware_concurrency(); hw > 1) {
+			options.threads.push_back(hw);
+		}
+	}
+	if (options.ops.empty()) {
+		for (const auto& info : op_table) {
+			options.ops.push_back(info.op);
+		}
+	}
+	return options;
+}
+
+// fill_bytes fills out with pseudorandom bytes, like random_bytes, but
+// quickly enough for shares of a gigabyte.
+void fill_bytes(std::span<uint8_t> out, uint64_t seed) {
+	for (auto& b : out) {
+		// splitmix64
+		seed += 0x9E3779B97F4A7C15ULL;
+		uint64_t z = seed;
+		z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+		b = static_cast<uint8_t>(z ^ (z >> 31U));
+	}
+}
+
+// Coder holds a FEC along with some data and its parity shares. The data
+// shares are the data itself, share_size bytes apiece.
+struct Coder {
+	Coder(int k, int n, size_t share_size_, FEC::Matrix matrix)
+		: fec(k, n, matrix)
+		, share_size {share_size_}
+		, data(share_size * static_cast<size_t>(k))
+		, parity(share_size * static_cast<size_t>(n - k))
+	{
+		fill_bytes(data, 1);
+		fec.EncodeParity(data, std::span<uint8_t* const>(ParityPointers()));
+	}
+
+	[[nodiscard]] auto Piece(int num) -> uint8_t* {
+		if (num < fec.Required()) {
+			return &data[static_cast<size_t>(num) * share_size];
+		}
+		return &parity[static_cast<size_t>(num - fec.Required()) * share_size];
+	}
+
+	[[nodiscard]] auto ParityPointers() -> std::vector<uint8_t*> {
+		std::vector<uint8_t*> out;
+		for (int i = fec.Required(); i < fec.Total(); i++) {
+			out.push_back(Piece(i));
+		}
+		return out;
+	}
+
+	FEC fec;
+	size_t share_size;
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> parity;
+};
+
+// coder_for returns a Coder for the case, reusing the last one if it fits.
+// Cases are registered so that those sharing a Coder run one after another,
+// which saves encoding up to gigabytes of data for every one of them.
+auto coder_for(const Case& c) -> Coder& {
+	static std::unique_ptr<Coder> coder;
+	if (!coder || coder->fec.Required() != c.k || coder->fec.Total() != c.n
+			|| coder->share_size != c.share_size || coder->fec.EncodingMatrix() != c.matrix) {
+		coder.reset();
+		coder = std::make_unique<Coder>(c.k, c.n, c.share_size, c.matrix);
+	}
+	return *coder;
+}
+
+// pool_for returns a pool for threads threads in all, the caller included.
+auto pool_for(size_t threads) -> std::shared_ptr<Executor> {
+	static std::map<size_t, std::shared_ptr<ThreadPool>> pools;
+	if (threads <= 1) {
+		return nullptr;
+	}
+	auto& pool = pools[threads];
+	if (!pool) {
+		pool = std::make_shared<ThreadPool>(threads - 1);
+	}
+	return pool;
+}
+
+[[nodiscard]] auto read_cycles() -> uint64_t {
+#if defined(INFECTIOUS_BENCH_HAS_TSC)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+// Meter counts the cycles and allocations of a benchmark loop, leaving out
+// the time spent between Pause and Resume.
+class Meter {
+public:
+	Meter()
+		: allocs(allocations.load(std::memory_order_relaxed))
+		, start(read_cycles())
+	{}
+
+	void Pause() {
+		paused = read_cycles();
+	}
+
+	void Resume() {
+		start += read_cycles() - paused;
+	}
+
+	void Report(benchmark::State& state, const Case& c, size_t bytes) const {
+		const uint64_t cycles = read_cycles() - start;
+		const auto used = allocations.load(std::memory_order_relaxed) - allocs;
+
+		set_throughput(state, bytes);
+		const auto total = static_cast<double>(bytes) * static_cast<double>(state.iterations());
+		state.counters["cycles/B"] = total > 0 ? static_cast<double>(cycles) / total : 0;
+		state.counters["allocs/op"] = benchmark::Counter(static_cast<double>(used), benchmark::Counter::kAvgIterations);
+
+		// CSV output needs every case to have the same counters.
+		state.counters["k"] = c.k;
+		state.counters["n"] = c.n;
+		state.counters["share_bytes"] = static_cast<double>(c.share_size);
+		state.counters["threads"] = static_cast<double>(c.threads);
+		state.counters["missing"] = c.info.op == Op::RebuildSorted || c.info.op == Op::RebuildBatch ? c.lost : 0;
+		state.counters["bad"] = c.info.op == Op::Correct ? c.lost : 0;
+	}
+
+private:
+	uint64_t allocs;
+	uint64_t start;
+	uint64_t paused {0};
+};
+
+void noop(int /*num*/, ByteView /*data*/) {}
+
+// present_shares returns the share numbers a rebuild is given: all the data
+// shares but the first missing, and the highest numbered parity shares in
+// their place, as in infectious-bench.
+[[nodiscard]] auto present_shares(int k, int n, int missing) -> std::vector<int> {
+	std::vector<int> nums;
+	for (int i = missing; i < k; i++) {
+		nums.push_back(i);
+	}
+	for (int i = n - missing; i < n; i++) {
+		nums.push_back(i);
+	}
+	return nums;
+}
+
+// batch_stripes returns the stripe size and count that EncodeBatch and
+// RebuildBatch split the shares of a case into.
+[[nodiscard]] auto batch_stripes(const Case& c) -> std::pair<size_t, size_t> {
+	const size_t stripe = std::min(c.stripe, c.share_size);
+	return {stripe, c.share_size / stripe};
+}
+
+// footprint returns roughly how many bytes a case needs.
+[[nodiscard]] auto footprint(const Case& c) -> size_t {
+	const size_t coder = c.share_size * static_cast<size_t>(c.n);
+	switch (c.info.op) {
+	case Op::EncodeBatch:
+		return coder + c.share_size * static_cast<size_t>(c.n - c.k);
+	case Op::RebuildBatch:
+		return coder + c.share_size * static_cast<size_t>(c.k);
+	case Op::Correct:
+		return coder + 2 * c.share_size * static_cast<size_t>(c.lost);
+	default:
+		return coder;
+	}
+}
+
+void run(benchmark::State& state, const Case& c) {
+	Coder& coder = coder_for(c);
+	coder.fec.SetExecutor(pool_for(c.threads), c.chunk);
+	const size_t data_size = coder.data.size();
+
+	switch (c.info.op) {
+	case Op::Encode: {
+		Meter meter;
+		for (auto _ : state) {
+			coder.fec.Encode(coder.data, noop);
+		}
+		meter.Report(state, c, data_size);
+		break;
+	}
+	case Op::EncodeSingle: {
+		// the first parity share, which has to be computed; the data shares
+		// are only copied.
+		const uint8_t* in = coder.data.data();
+		uint8_t* out = coder.Piece(c.k);
+		Meter meter;
+		for (auto _ : state) {
+			coder.fec.EncodeSingle(c.k, in, in + data_size, out, out + c.share_size);
+			benchmark::ClobberMemory();
+		}
+		meter.Report(state, c, data_size);
+		break;
+	}
+	case Op::EncodeParity: {
+		const auto parity = coder.ParityPointers();
+		Meter meter;
+		for (auto _ : state) {
+			coder.fec.EncodeParity(coder.data, std::span<uint8_t* const>(parity));
+			benchmark::ClobberMemory();
+		}
+		meter.Report(state, c, data_size);
+		break;
+	}
+	case Op::EncodeBatch: {
+		// the data in stripes of k*stripe bytes, each encoded on its own,
+		// into parity of their own to leave the Coder's alone.
+		const auto [stripe, stripes] = batch_stripes(c);
+		const auto m = static_cast<size_t>(c.n - c.k);
+		std::vector<uint8_t> parity(stripes * m * stripe);
+		std::vector<ByteView> inputs;
+		std::vector<uint8_t*> outputs;
+		for (size_t s = 0; s < stripes; ++s) {
+			inputs.emplace_back(&coder.data[s * c.k * stripe], c.k * stripe);
+			for (size_t i = 0; i < m; ++i) {
+				outputs.push_back(&parity[(s * m + i) * stripe]);
+			}
+		}
+		Meter meter;
+		for (auto _ : state) {
+			coder.fec.EncodeBatch(inputs, outputs);
+			benchmark::ClobberMemory();
+		}
+		meter.Report(state, c, stripes * c.k * stripe);
+		break;
+	}
+	case Op::RebuildSorted: {
+		std::map<int, ByteView> shares;
+		for (const int num : present_shares(c.k, c.n, c.lost)) {
+			shares.try_emplace(num, coder.Piece(num), c.share_size);
+		}
+		Meter meter;
+		for (auto _ : state) {
+			coder.fec.RebuildSorted(shares, noop);
+		}
+		meter.Report(state, c, data_size);
+		break;
+	}
+	case Op::RebuildBatch: {
+		// every column range of stripe bytes of the shares is a stripe of
+		// its own, with the same shares present.
+		const auto [stripe, stripes] = batch_stripes(c);
+		const auto nums = present_shares(c.k, c.n, c.lost);
+		std::vector<const uint8_t*> shares;
+		std::vector<uint8_t> out(stripes * c.k * stripe);
+		std::vector<uint8_t*> outputs;
+		for (size_t s = 0; s < stripes; ++s) {
+			for (const int num : nums) {
+				shares.push_back(coder.Piece(num) + s * stripe);
+			}
+			outputs.push_back(&out[s * c.k * stripe]);
+		}
+		Meter meter;
+		for (auto _ : state) {
+			coder.fec.RebuildBatch(nums, shares, stripe, outputs);
+			benchmark::ClobberMemory();
+		}
+		meter.Report(state, c, stripes * c.k * stripe);
+		break;
+	}
+	case Op::Correct: {
+		// every byte of the first lost shares is wrong, as from a failing
+		// disk. Correct fixes them, so they are put back before each
+		// iteration; the good shares are used where they are.
+		std::vector<std::vector<uint8_t>> corrupted;
+		for (int i = 0; i < c.lost; i++) {
+			const uint8_t* piece = coder.Piece(i);
+			auto& bad = corrupted.emplace_back(piece, piece + c.share_size);
+			for (auto& b : bad) {
+				b ^= 0x5a; // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+			}
+		}
+		auto work = corrupted;
+		std::map<int, std::span<uint8_t>> shares;
+		for (int i = 0; i < c.n; i++) {
+			if (i < c.lost) {
+				shares.try_emplace(i, work[i]);
+			} else {
+				shares.try_emplace(i, coder.Piece(i), c.share_size);
+			}
+		}
+		Meter meter;
+		for (auto _ : state) {
+			if (c.lost > 0) {
+				state.PauseTiming();
+				meter.Pause();
+				for (int i = 0; i < c.lost; i++) {
+					std::copy(corrupted[i].begin(), corrupted[i].end(), work[i].begin());
+				}
+				meter.Resume();
+				state.ResumeTiming();
+			}
+			coder.fec.Correct(shares);
+		}
+		meter.Report(state, c, data_size);
+		break;
+	}
+	}
+
+	coder.fec.SetExecutor(nullptr);
+}
+
+// lost_counts returns the missing (or, with correct, bad) share counts to
+// run a scheme with: none, one, and as many as it can take.
+[[nodiscard]] auto lost_counts(Op op, int k, int n) -> std::vector<int> {
+	if (op != Op::RebuildSorted && op != Op::RebuildBatch && op != Op::Correct) {
+		return {0};
+	}
+	const int most = op == Op::Correct ? (n - k) / 2 : std::min(n - k, k);
+	std::vector<int> counts {0};
+	for (const int count : {1, most}) {
+		if (count <= most && count != counts.back()) {
+			counts.push_back(count);
+		}
+	}
+	return counts;
+}
+
+[[nodiscard]] auto case_name(const Case& c) -> std::string {
+	std::string name = c.info.name;
+	name += "/k:" + std::to_string(c.k) + "/n:" + std::to_string(c.n);
+	name += "/share:" + std::to_string(c.share_size);
+	name += c.matrix == FEC::Matrix::Cauchy ? "/matrix:cauchy" : "/matrix:vandermonde";
+	if (c.info.op == Op::RebuildSorted || c.info.op == Op::RebuildBatch) {
+		name += "/missing:" + std::to_string(c.lost);
+	} else if (c.info.op == Op::Correct) {
+		name += "/bad:" + std::to_string(c.lost);
+	}
+	name += "/threads:" + std::to_string(c.threads);
+	return name;
+}
+
+// register_cases registers every case of the sweep that fits in memory,
+// grouped by the Coder they need, and returns how many were skipped.
+auto register_cases(const Options& options) -> size_t {
+	size_t skipped = 0;
+	for (const auto& [k, n] : options.schemes) {
+		for (const size_t share_size : options.share_sizes) {
+			for (const auto matrix : options.matrices) {
+				for (const auto& info : op_table) {
+					if (std::find(options.ops.begin(), options.ops.end(), info.op) == options.ops.end()) {
+						continue;
+					}
+					if (info.needs_parity && n == k) {
+						continue;
+					}
+					for (const int lost : lost_counts(info.op, k, n)) {
+						for (const size_t threads : options.threads) {
+							if (!info.parallel && threads != options.threads.front()) {
+								continue;
+							}
+							const Case c {
+								info, k, n, share_size, matrix,
+								info.parallel ? threads : 1, lost,
+								options.chunk, options.stripe,
+							};
+							if (footprint(c) > options.max_memory) {
+								++skipped;
+								continue;
+							}
+							benchmark::RegisterBenchmark(case_name(c).c_str(), [c](benchmark::State& state) {
+								run(state, c);
+							})->UseRealTime();
+						}
+					}
+				}
+			}
+		}
+	}
+	return skipped;
+}
+
+} // namespace
+
+} // namespace infectious::bench
+
+auto main(int argc, char** argv) -> int {
+	benchmark::Initialize(&argc, argv);
+	infectious::bench::Options options;
+	try {
+		options = infectious::bench::parse_options(argc, argv);
+	} catch (const std::exception& e) {
+		std::cerr << "infectious-scaling: " << e.what() << '\n';
+		return 1;
+	}
+	if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+		return 1;
+	}
+	if (const auto skipped = infectious::bench::register_cases(options); skipped > 0) {
+		std::cerr << "skipping " << skipped << " cases needing more than --max_memory=" << options.max_memory << " bytes\n";
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
+
+// Counting allocations. The nothrow and array forms of operator new all
+// come through these in libstdc++ and libc++.
+// NOLINTBEGIN(cppcoreguidelines-no-malloc,cppcoreguidelines-owning-memory,hicpp-no-malloc)
+
+// once these are inlined, GCC sees memory from operator new passed to free,
+// and warns of a mismatch without noticing that both were replaced.
+#if defined(__GNUC__) && !defined(__clang__)
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+auto operator new(size_t size) -> void* {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size == 0 ? 1 : size)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+auto operator new(size_t size, std::align_val_t align) -> void* {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	const auto alignment = static_cast<size_t>(align);
+	if (void* p = std::aligned_alloc(alignment, (std::max(size, size_t {1}) + alignment - 1) / alignment * alignment)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t /*size*/) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t /*align*/) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t /*size*/, std::align_val_t /*align*/) noexcept {
+	std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+# pragma GCC diagnostic pop
+#endif
+
+// NOLINTEND(cppcoreguidelines-no-malloc,cppcoreguidelines-owning-memory,hicpp-no-malloc)
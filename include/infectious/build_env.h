@@ -80,6 +80,10 @@
 # define INFECTIOUS_TARGET_CPU_IS_X86_FAMILY
 # define INFECTIOUS_TARGET_CPU_IS_LITTLE_ENDIAN
 # define INFECTIOUS_HAS_VPERM
+# define INFECTIOUS_HAS_SSE2
+# define INFECTIOUS_HAS_AVX2
+# define INFECTIOUS_HAS_AVX512BW
+# define INFECTIOUS_HAS_GFNI
 #endif
 
 #if defined(INFECTIOUS_TARGET_ARCH_IS_ARM64) || defined(INFECTIOUS_TARGET_ARCH_IS_ARM32)
@@ -88,10 +92,11 @@
 # define INFECTIOUS_HAS_VPERM
 #endif
 
+/* simd_32.hpp has no AltiVec backend, so POWER has no vperm kernels and
+   uses the portable ones. */
 #if defined(INFECTIOUS_TARGET_ARCH_IS_PPC64)
 # define INFECTIOUS_TARGET_CPU_IS_PPC_FAMILY
 # define INFECTIOUS_TARGET_CPU_IS_BIG_ENDIAN
-# define INFECTIOUS_HAS_VPERM
 #endif
 
 #if defined(INFECTIOUS_TARGET_ARCH_IS_ALPHA)
@@ -167,6 +172,14 @@
 # define INFECTIOUS_TARGET_OS_HAS_AUXINFO
 #endif
 
+/* io_uring is used through its system calls directly, so all it takes is
+   the kernel's header for them. */
+#if defined(INFECTIOUS_TARGET_OS_IS_LINUX) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  define INFECTIOUS_TARGET_OS_HAS_IO_URING
+# endif
+#endif
+
 #if defined(INFECTIOUS_TARGET_CPU_IS_X86_FAMILY)
 # define INFECTIOUS_TARGET_SUPPORTS_SSE2
 #endif
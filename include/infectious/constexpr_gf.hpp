@@ -0,0 +1,73 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_CONSTEXPR_GF_HPP
+#define INFECTIOUS_CONSTEXPR_GF_HPP
+
+#include <array>
+#include <cinttypes>
+
+namespace infectious::internal::constexpr_gf {
+
+// Arithmetic in GF(2^8) modulo the polynomial x^8 + x^4 + x^3 + x^2 + 1,
+// usable at compile time. This is the one definition of the field, and the
+// lookup tables in tables.hpp, like every other table or matrix the library
+// builds at compile time, are built from it.
+
+constexpr int field_size = 256;
+constexpr int field_polynomial = 0x11D;
+constexpr uint8_t high_bit = 0x80;
+
+// mul multiplies a by b the long way, one bit of b at a time, reducing
+// modulo the field polynomial whenever a overflows a byte.
+constexpr auto mul(uint8_t a, uint8_t b) -> uint8_t {
+	uint8_t out = 0;
+	while (b != 0) {
+		if ((b & 1U) != 0) {
+			out ^= a;
+		}
+		// shifting out the high bit drops x^8, and the XOR adds back the
+		// rest of the polynomial in its place.
+		const bool overflow = (a & high_bit) != 0;
+		a = static_cast<uint8_t>(a << 1U);
+		if (overflow) {
+			a ^= static_cast<uint8_t>(field_polynomial);
+		}
+		b >>= 1U;
+	}
+	return out;
+}
+
+// exp holds the powers of 2 twice over, so that exp[log[a] + log[b]]
+// needs no reduction modulo 255. log[0] is never meaningful, and is 0xFF.
+struct Tables {
+	std::array<uint8_t, 2 * (field_size - 1)> exp {};
+	std::array<uint8_t, field_size> log {};
+};
+
+consteval auto make_tables() -> Tables {
+	Tables t;
+	t.log[0] = field_size - 1;
+	uint8_t x = 1;
+	for (int i = 0; i < field_size - 1; i++) {
+		t.exp[i] = x;
+		t.exp[i + field_size - 1] = x;
+		t.log[x] = static_cast<uint8_t>(i);
+		x = mul(x, 2);
+	}
+	return t;
+}
+
+inline constexpr Tables tables = make_tables();
+
+// inverse returns the multiplicative inverse of a, or 0 for 0.
+constexpr auto inverse(uint8_t a) -> uint8_t {
+	if (a == 0) {
+		return 0;
+	}
+	return tables.exp[field_size - 1 - tables.log[a]];
+}
+
+} // namespace infectious::internal::constexpr_gf
+
+#endif // ifndef INFECTIOUS_CONSTEXPR_GF_HPP
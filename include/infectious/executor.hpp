@@ -0,0 +1,68 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_EXECUTOR_HPP
+#define INFECTIOUS_EXECUTOR_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "infectious/build_env.h"
+
+namespace infectious {
+
+// Executor runs independent pieces of work, possibly concurrently. A FEC
+// given an executor with FEC::SetExecutor splits large operations into
+// column ranges and runs them through it.
+//
+// Implement this to run the work on an existing thread pool or task system;
+// otherwise ThreadPool is a reasonable default.
+class INFECTIOUS_EXPORT Executor {
+public:
+	Executor() = default;
+	Executor(const Executor&) = delete;
+	Executor(Executor&&) = delete;
+	auto operator=(const Executor&) -> Executor& = delete;
+	auto operator=(Executor&&) -> Executor& = delete;
+	virtual ~Executor() = default;
+
+	// ParallelFor calls fn(i) once for every i in [0, count), in any order
+	// and on any threads, and returns once all of the calls have returned.
+	// If any call throws, one of the exceptions is rethrown from ParallelFor
+	// after the rest of the calls are done.
+	//
+	// It must be safe to call ParallelFor from several threads at once, and
+	// from within fn itself.
+	virtual void ParallelFor(size_t count, const std::function<void(size_t)>& fn) = 0;
+};
+
+// ThreadPool is an Executor backed by a fixed set of worker threads. Work
+// is handed out an index at a time, so threads that finish early pick up
+// what is left, and the thread calling ParallelFor works on its own calls
+// too instead of just waiting for them.
+class INFECTIOUS_EXPORT ThreadPool : public Executor {
+public:
+	// This constructor starts threads worker threads. With 0 threads it
+	// starts one fewer than the number of hardware threads, the caller of
+	// ParallelFor making up the last one.
+	explicit ThreadPool(size_t threads = 0);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+	auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+	auto operator=(ThreadPool&&) -> ThreadPool& = delete;
+	~ThreadPool() override;
+
+	void ParallelFor(size_t count, const std::function<void(size_t)>& fn) override;
+
+	// Threads returns the number of worker threads.
+	[[nodiscard]] auto Threads() const -> size_t;
+
+private:
+	struct State;
+	std::unique_ptr<State> state;
+};
+
+} // namespace infectious
+
+#endif // INFECTIOUS_EXECUTOR_HPP
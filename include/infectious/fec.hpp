@@ -5,15 +5,23 @@
 #define INFECTIOUS_FEC_HPP
 
 #include <algorithm>
+#include <array>
 #include <functional>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "infectious/build_env.h"
+#include "infectious/executor.hpp"
+#include "infectious/stats.hpp"
+#include "infectious/workspace.hpp"
 
 namespace infectious {
 
@@ -28,6 +36,15 @@ public:
 	{}
 };
 
+// CacheStats reports on the use of one of the optional matrix caches a FEC
+// may keep.
+struct CacheStats {
+	uint64_t hits;
+	uint64_t misses;
+	size_t entries;
+	size_t capacity;
+};
+
 class INFECTIOUS_EXPORT NotEnoughShares : public std::out_of_range {
 public:
 	using std::out_of_range::out_of_range;
@@ -41,7 +58,14 @@ using ByteView = std::basic_string_view<uint8_t>;
 
 using ShareOutputFunc = std::function<void(int num, ByteView output)>;
 
+// ShareSegments describes a single share laid out across several buffers, in
+// order, in the manner of an iovec.
+using ShareSegments = std::span<const std::span<uint8_t>>;
+
 namespace internal {
+	template <typename Value>
+	class MatrixCache;
+
 	template <typename T, typename = void>
 	struct is_sortable : std::false_type {};
 
@@ -70,21 +94,52 @@ auto share_data(const T& t) -> const decltype(t.second)& {
 	return t.second;
 }
 
+template <int K, int N>
+class FixedFEC;
+
+class IncrementalDecoder;
+
 // FEC represents operations performed on a Reed-Solomon-based
 // forward error correction code.
+//
+// The scratch memory FEC operations need comes from the calling thread's
+// Workspace, so once a thread has done an operation, repeating it on shares
+// of the same size and numbers does no heap allocation. The exceptions are
+// filling the decode and syndrome caches, running through an executor, and
+// whatever the output callbacks do themselves.
 class INFECTIOUS_EXPORT FEC {
 public:
 	static const int byte_max = 256;
 
+	// Matrix is the construction of a FEC's encoding matrix. Both give a
+	// systematic code, with the data pieces as the first k shares, and
+	// every operation works the same way for either; only the parity shares
+	// differ.
+	enum class Matrix {
+		// Vandermonde is the construction used by zfec, whose shares this
+		// code is compatible with.
+		Vandermonde,
+		// Cauchy uses a Cauchy matrix for the parity shares, with its rows
+		// and columns scaled to have as few ones as possible in their
+		// binary form, which is what the "xor" addmul provider spends its
+		// time on. The first parity share is then the plain XOR of the data
+		// pieces. Decoding matrices have a closed form taking O(k^2) steps
+		// to build, rather than the O(k^3) of inverting one, which makes a
+		// difference to uncached decodes at large k.
+		Cauchy,
+	};
+
 	// This constructor creates a FEC using k required pieces and n total
 	// pieces. Encoding data with this FEC will generate n pieces, and decoding
 	// data requires k uncorrupted pieces. If during decode more than k pieces
 	// exist, corrupted data can be detected and recovered from.
-	FEC(int k_, int n_)
+	FEC(int k_, int n_, Matrix matrix_ = Matrix::Vandermonde)
 		: k {k_}
 		, n {n_}
+		, matrix_kind {matrix_}
 		, enc_matrix(n*k, 0)
 		, vand_matrix(k*n, 0)
+		, eval_powers(n*n, 0)
 	{
 		initialize();
 	}
@@ -101,6 +156,67 @@ public:
 		return n;
 	}
 
+	// EncodingMatrix returns the construction of this FEC's encoding matrix.
+	[[nodiscard]] auto EncodingMatrix() const -> Matrix {
+		return matrix_kind;
+	}
+
+	// default_parallel_chunk is the default size, in bytes, of the column
+	// ranges that work is split into when this FEC has an executor.
+	static constexpr size_t default_parallel_chunk = 256UL * 1024UL;
+
+	// SetExecutor makes this FEC split the work of Encode, EncodeSingle,
+	// EncodeParity, EncodeInto, Rebuild, Correct and Verify into column
+	// ranges of about chunk_size bytes of each share, and run them through
+	// executor. Every byte column of a share is independent of the others,
+	// so the results do not change. Shares smaller than chunk_size are still
+	// handled on the calling thread. A null executor turns this off again.
+	//
+	// The executor is shared with any copies of this FEC made afterward.
+	// Setting it is not safe while this FEC is in use on another thread.
+	void SetExecutor(std::shared_ptr<Executor> executor_, size_t chunk_size = default_parallel_chunk);
+
+	// EnableDecodeCache makes this FEC keep up to capacity inverted decoding
+	// matrices, keyed by the set of share numbers they were built from, so
+	// that rebuilding from a set of shares seen recently can skip the matrix
+	// inversion. The least recently used matrix is evicted when it is full.
+	// A capacity of 0 disables the cache again.
+	//
+	// The cache is safe to use from concurrent Rebuild calls, and is shared
+	// with any copies of this FEC made afterward. Enabling or disabling it is
+	// not safe while this FEC is in use on another thread.
+	void EnableDecodeCache(size_t capacity);
+
+	// DecodeCacheStats reports the hits, misses and size of the decode cache.
+	// It returns all zeroes if the cache is not enabled.
+	[[nodiscard]] auto DecodeCacheStats() const -> CacheStats;
+
+	// EnableSyndromeCache makes this FEC keep up to capacity parity-check
+	// matrices, keyed by the set of share numbers present, so that Correct
+	// (and so Decode) on a set of shares seen recently only has to apply the
+	// syndrome check instead of also rebuilding it. It otherwise behaves just
+	// like EnableDecodeCache.
+	void EnableSyndromeCache(size_t capacity);
+
+	// SyndromeCacheStats reports the hits, misses and size of the syndrome
+	// cache. It returns all zeroes if the cache is not enabled.
+	[[nodiscard]] auto SyndromeCacheStats() const -> CacheStats;
+
+	// registry_cache_capacity is the capacity of the decode and syndrome
+	// caches of the FECs handed out by Get.
+	static constexpr size_t registry_cache_capacity = 16;
+
+	// Get returns the process-wide FEC for k required and n total pieces.
+	// The first call for a given k and n builds it, with decode and syndrome
+	// caches of registry_cache_capacity entries; every later call returns
+	// the same instance, so its matrices and caches are shared by all of
+	// its users. Every operation on a const FEC may be used concurrently, so
+	// there is no need to make copies for other threads.
+	//
+	// Lookups of codes that already exist take only a shared lock. Throws
+	// std::domain_error for k and n that the constructor would reject.
+	[[nodiscard]] static auto Get(int k, int n) -> std::shared_ptr<const FEC>;
+
 	// Encode will take input data and encode to the total number of pieces n
 	// this FEC is configured for. It will call the output callback n times.
 	//
@@ -111,35 +227,148 @@ public:
 	// output returns.
 	template <typename InputType>
 	void Encode(const InputType& input, const ShareOutputFunc& output) const {
-		int size = input.size();
+		const size_t size = std::size(input);
 
-		if (size < 0 || size % k != 0) {
+		if (size % k != 0) {
 			throw std::invalid_argument("input length must be a multiple of k");
 		}
 
-		int block_size = size / k;
+		const size_t block_size = size / k;
+		const internal::PhaseTimer timer(internal::Stat::EncodeNanos);
+		internal::count_stat(internal::Stat::BytesEncoded, size);
 
 		auto ibegin = std::begin(input);
 		for (int i = 0; i < k; i++) {
 			output(i, ByteView(std::to_address(ibegin) + i*block_size, block_size));
 		}
 
-		std::vector<uint8_t> fec_buf(block_size);
+		if (n == k) {
+			return;
+		}
+
+		BlockPointers inputs {};
+		for (int j = 0; j < k; j++) {
+			inputs[j] = std::to_address(ibegin) + j*block_size;
+		}
+
+		auto& ws = Workspace::ForThisThread();
+		const Workspace::Scope scope(ws);
+		const auto fec_buf = ws.Allocate<uint8_t>(block_size);
+		uint8_t* const fec_out = fec_buf.data();
 		for (int i = k; i < n; i++) {
-			std::fill(fec_buf.begin(), fec_buf.end(), 0);
-
-			for (int j = 0; j < k; j++) {
-				addmul(
-					fec_buf.data(), fec_buf.data() + block_size,
-					std::to_address(ibegin) + j*block_size,
-					enc_matrix[i*k+j]
-				);
+			mulMatrix(&enc_matrix[i*k], 1, k, inputs.data(), &fec_out, block_size);
+			output(i, ByteView(fec_buf.data(), block_size));
+		}
+	}
+
+	// EncodeParity will take input data and encode only the n-k parity pieces
+	// of it, writing parity piece k+i to parity[i]. The data pieces are the
+	// input itself, split into k blocks, and are not copied anywhere.
+	//
+	// Unlike Encode, every parity piece is computed in the same pass over the
+	// input, working through it in cache-sized column tiles, so the input is
+	// only read from memory once no matter how many parity pieces there are.
+	//
+	// The input data must be a multiple of the required number of pieces k.
+	// Padding to this multiple is up to the caller.
+	//
+	// There must be exactly n-k parity buffers, each at least len(input) / k
+	// bytes, and none of them may overlap the input.
+	template <typename InputType>
+	void EncodeParity(const InputType& input, std::span<uint8_t* const> parity) const {
+		if (parity.size() != static_cast<size_t>(n - k)) {
+			throw std::invalid_argument("parity must have exactly "s + std::to_string(n - k) + " buffers");
+		}
+
+		const auto [inputs, block_size] = split_blocks(input);
+		const internal::PhaseTimer timer(internal::Stat::EncodeNanos);
+		internal::count_stat(internal::Stat::BytesEncoded, std::size(input));
+		mulMatrix(&enc_matrix[k*k], n - k, k, inputs.data(), parity.data(), block_size);
+	}
+
+	// EncodeParity is like the above, but for input that is not contiguous:
+	// blocks holds a pointer to each of the k data pieces, which are
+	// block_size bytes each and may be anywhere. Any parity entry may be
+	// nullptr, in which case that parity piece is not produced.
+	void EncodeParity(std::span<const uint8_t* const> blocks, size_t block_size, std::span<uint8_t* const> parity) const;
+
+	// EncodeInto will take input data and encode it directly into the n
+	// caller-owned share buffers in outputs, without allocating. outputs[i]
+	// receives share i, and must hold at least len(input) / k bytes.
+	//
+	// Any entry may be nullptr, in which case that share is not produced. In
+	// particular, passing nullptr for the first k entries avoids copying the
+	// data shares, which are just the input split into k blocks. The parity
+	// shares are all computed in one pass over the input, as in EncodeParity.
+	//
+	// The input data must be a multiple of the required number of pieces k.
+	// Padding to this multiple is up to the caller. None of the outputs may
+	// overlap the input.
+	template <typename InputType>
+	void EncodeInto(const InputType& input, std::span<uint8_t* const> outputs) const {
+		if (outputs.size() != static_cast<size_t>(n)) {
+			throw std::invalid_argument("outputs must have exactly "s + std::to_string(n) + " buffers");
+		}
+
+		const auto [inputs, block_size] = split_blocks(input);
+		const internal::PhaseTimer timer(internal::Stat::EncodeNanos);
+		internal::count_stat(internal::Stat::BytesEncoded, std::size(input));
+		for (int i = 0; i < k; i++) {
+			if (outputs[i] != nullptr) {
+				std::copy_n(inputs[i], block_size, outputs[i]);
 			}
+		}
+		encode_parity(inputs.data(), &outputs[k], block_size);
+	}
 
-			output(i, ByteView(fec_buf.data(), block_size));
+	// EncodeInto is like the above, but each share may be scattered across
+	// several buffers. The segments of outputs[i] must add up to exactly
+	// len(input) / k bytes, or be empty to skip that share.
+	template <typename InputType>
+	void EncodeInto(const InputType& input, std::span<const ShareSegments> outputs) const {
+		if (outputs.size() != static_cast<size_t>(n)) {
+			throw std::invalid_argument("outputs must have exactly "s + std::to_string(n) + " shares");
+		}
+
+		const auto [inputs, block_size] = split_blocks(input);
+		for (size_t i = 0; i < outputs.size(); i++) {
+			size_t share_size = 0;
+			for (auto segment : outputs[i]) {
+				share_size += segment.size();
+			}
+			if (!outputs[i].empty() && share_size != block_size) {
+				throw std::invalid_argument("share "s + std::to_string(i) + " segments must total " + std::to_string(block_size) + " bytes");
+			}
 		}
+
+		const internal::PhaseTimer timer(internal::Stat::EncodeNanos);
+		internal::count_stat(internal::Stat::BytesEncoded, std::size(input));
+		encode_segments(inputs.data(), outputs, block_size);
 	}
 
+	// EncodeBatch encodes many independent stripes back to back, as if by
+	// calling EncodeParity on each, but without any per-stripe allocation or
+	// callbacks. It is meant for large numbers of small stripes, where the
+	// overhead of the other calls would dominate.
+	//
+	// Each input must be a multiple of k bytes long; they need not all be the
+	// same length. parity must hold n-k pointers per input, with parity piece
+	// k+i of inputs[s] written to parity[s*(n-k) + i].
+	void EncodeBatch(std::span<const ByteView> inputs, std::span<uint8_t* const> parity) const;
+
+	// RebuildBatch rebuilds the data of many independent stripes that all
+	// have the same share numbers available, share_size bytes each, with one
+	// decoding matrix for the lot of them.
+	//
+	// share_nums must hold exactly k distinct share numbers. shares must hold
+	// k pointers per stripe, with shares[s*k + j] holding share share_nums[j]
+	// of stripe s. The data for stripe s, k*share_size bytes, is written to
+	// outputs[s].
+	void RebuildBatch(
+		std::span<const int> share_nums, std::span<const uint8_t* const> shares,
+		size_t share_size, std::span<uint8_t* const> outputs
+	) const;
+
 	// EncodeSingle will take input data and encode it to output only for the
 	// num piece.
 	//
@@ -155,7 +384,7 @@ public:
 		const IBegin ibegin, IEnd iend,
 		OBegin obegin, OEnd oend
 	) const {
-		int isize = iend - ibegin;
+		const auto isize = static_cast<size_t>(iend - ibegin);
 
 		if (num < 0) {
 			throw std::invalid_argument("num must be non-negative");
@@ -167,27 +396,29 @@ public:
 			throw std::invalid_argument("input length must be a multiple of k");
 		}
 
-		int block_size = isize / k;
+		const size_t block_size = isize / k;
 
-		int osize = static_cast<int>(oend - obegin);
+		const auto osize = static_cast<size_t>(oend - obegin);
 		if (osize != block_size) {
 			throw std::invalid_argument("output length must be equal to "s + std::to_string(block_size));
 		}
 
+		const internal::PhaseTimer timer(internal::Stat::EncodeNanos);
+		internal::count_stat(internal::Stat::BytesEncoded, isize);
+
 		if (num < k) {
-			std::copy(ibegin + num*block_size, ibegin + (num+1)*block_size, obegin);
+			const auto* data = std::to_address(ibegin) + num*block_size;
+			std::copy(data, data + block_size, obegin);
 			return;
 		}
 
-		std::fill(obegin, oend, 0);
-
+		BlockPointers inputs {};
 		for (int i = 0; i < k; i++) {
-			addmul(
-				std::to_address(obegin), std::to_address(oend),
-				std::to_address(ibegin) + i*block_size,
-				enc_matrix[num*k+i]
-			);
+			inputs[i] = std::to_address(ibegin) + i*block_size;
 		}
+
+		uint8_t* const out = std::to_address(obegin);
+		mulMatrix(&enc_matrix[num*k], 1, k, inputs.data(), &out, block_size);
 	}
 
 	// RebuildSorted will take a list of corrected, sorted shares (pieces) and a
@@ -210,47 +441,16 @@ public:
 			throw NotEnoughShares();
 		}
 
-		std::vector<uint8_t> decoding_matrix(k*k);
-		std::vector<int> indexes(k);
-		std::vector<const uint8_t*> shares_begins(k);
-
-		auto shares_b_iter = std::begin(shares);
-		auto shares_e_iter = std::rbegin(shares);
-
-		bool missing_primary_share = false;
-		int share_size = 0;
+		std::array<int, byte_max> indexes {};
+		BlockPointers shares_begins {};
+		const internal::PhaseTimer timer(internal::Stat::RebuildNanos);
+		const auto [share_size, missing_primary_share] = pickShares(shares, indexes, shares_begins);
+		internal::count_stat(internal::Stat::BytesRebuilt, static_cast<size_t>(k) * share_size);
 
 		for (int i = 0; i < k; i++) {
-			int share_id = 0;
-			int shares_b_num = share_num(*shares_b_iter);
-			if (shares_b_num == i) {
-				share_id = shares_b_num;
-				auto& data = share_data(*shares_b_iter);
-				shares_begins[i] = std::to_address(std::begin(data));
-				share_size = std::to_address(std::end(data)) - shares_begins[i];
-				++shares_b_iter;
-			} else {
-				share_id = share_num(*shares_e_iter);
-				auto& data = share_data(*shares_e_iter);
-				shares_begins[i] = std::to_address(std::begin(data));
-				share_size = std::to_address(std::end(data)) - shares_begins[i];
-				++shares_e_iter;
-				missing_primary_share = true;
-			}
-
-			if (share_id < 0 || share_id >= n) {
-				throw std::invalid_argument("invalid share id: "s + std::to_string(share_id));
+			if (indexes[i] < k) {
+				output(indexes[i], ByteView(shares_begins[i], share_size));
 			}
-
-			if (share_id < k) {
-				decoding_matrix[i*(k+1)] = 1;
-				output(share_id, ByteView(shares_begins[i], share_size));
-			} else {
-				// decode this after inverting the decoding matrix
-				std::copy(&enc_matrix[share_id*k], &enc_matrix[(share_id+1)*k], &decoding_matrix[i*k]);
-			}
-
-			indexes[i] = share_id;
 		}
 
 		// shortcut: if we have all the original data shares, we don't need to
@@ -259,31 +459,104 @@ public:
 			return;
 		}
 
-		invertMatrix(decoding_matrix, k);
+		auto& ws = Workspace::ForThisThread();
+		const Workspace::Scope scope(ws);
+		const auto decoding_matrix = decodingMatrix(std::span(indexes.data(), static_cast<size_t>(k)));
 
-		std::vector<uint8_t> buf(share_size);
-		for (int i = 0; i < int(indexes.size()); ++i) {
+		const auto buf = ws.Allocate<uint8_t>(share_size);
+		uint8_t* const buf_out = buf.data();
+		for (int i = 0; i < k; ++i) {
 			if (indexes[i] >= k) {
-				std::fill(buf.begin(), buf.end(), 0);
-
-				for (int col = 0; col < k; ++col) {
-					addmul(buf.data(), buf.data() + share_size, shares_begins[col], decoding_matrix[i*k+col]);
-				}
+				mulMatrix(&(*decoding_matrix)[i*k], 1, k, shares_begins.data(), &buf_out, share_size);
 				output(i, ByteView(buf.data(), share_size));
 			}
 		}
 	}
 
-	// if shares isn't already a sorted map and we can't sort in-place,
-	// we need to copy the elements into a new sorted map.
+	// RebuildRange is like RebuildSorted, but only rebuilds length bytes of
+	// each data piece starting at offset, and only the data pieces numbered
+	// in wanted, or all k of them if wanted is empty. output is called once
+	// for each of those, in the order given, with just that range of it.
+	//
+	// The work done is proportional to the range rebuilt rather than to the
+	// whole share size, which suits random access reads of a few kilobytes
+	// out of large shares. Wanted data pieces that are among the shares are
+	// passed straight through, and each missing one costs one row of the
+	// decoding matrix, which is taken from the decode cache if enabled.
+	template <typename ShareMap>
+	void RebuildRange(
+		const ShareMap& shares, size_t offset, size_t length,
+		std::span<const int> wanted, const ShareOutputFunc& output
+	) const {
+		if (static_cast<int>(shares.size()) < k) {
+			throw NotEnoughShares();
+		}
+
+		std::array<int, byte_max> indexes {};
+		BlockPointers shares_begins {};
+		const auto share_size = pickShares(shares, indexes, shares_begins).first;
+		if (offset > share_size || length > share_size - offset) {
+			throw std::invalid_argument("range must be within the "s + std::to_string(share_size) + " byte shares");
+		}
+		for (const int num : wanted) {
+			if (num < 0 || num >= k) {
+				throw std::invalid_argument("invalid data piece: "s + std::to_string(num));
+			}
+		}
+
+		const internal::PhaseTimer timer(internal::Stat::RebuildNanos);
+		internal::count_stat(internal::Stat::BytesRebuilt, length * (wanted.empty() ? static_cast<size_t>(k) : wanted.size()));
+
+		BlockPointers range_begins {};
+		for (int i = 0; i < k; i++) {
+			range_begins[i] = shares_begins[i] + offset;
+		}
+
+		auto& ws = Workspace::ForThisThread();
+		const Workspace::Scope scope(ws);
+		std::shared_ptr<const std::pmr::vector<uint8_t>> decoding_matrix;
+		const auto buf = ws.Allocate<uint8_t>(length);
+		uint8_t* const buf_out = buf.data();
+
+		auto rebuild = [&](int num) {
+			if (indexes[num] < k) {
+				output(num, ByteView(range_begins[num], length));
+				return;
+			}
+			if (!decoding_matrix) {
+				decoding_matrix = decodingMatrix(std::span(indexes.data(), static_cast<size_t>(k)));
+			}
+			mulMatrix(&(*decoding_matrix)[num*k], 1, k, range_begins.data(), &buf_out, length);
+			output(num, ByteView(buf.data(), length));
+		};
+
+		if (wanted.empty()) {
+			for (int i = 0; i < k; i++) {
+				rebuild(i);
+			}
+		} else {
+			for (const int num : wanted) {
+				rebuild(num);
+			}
+		}
+	}
+
+	// if shares isn't already a sorted map and we can't sort in-place, we
+	// put them in order of share number by placing each in a bucket for its
+	// number, which takes one pass since there are at most byte_max of them.
 	template <typename ShareMap, typename = void>
 	struct rebuild_specialization {
-		using DataType = decltype(share_data(*std::declval<ShareMap>().begin()));
-
-		static void SortAndRebuild(FEC* this_, ShareMap& shares, const ShareOutputFunc& output) {
-			std::map<int, DataType> sorted_shares;
-			for (auto& share : shares) {
-				sorted_shares.try_emplace(share_num(share), share_data(share));
+		static void SortAndRebuild(const FEC* this_, ShareMap& shares, const ShareOutputFunc& output) {
+			const auto placed = this_->placeShares(shares);
+
+			auto& ws = Workspace::ForThisThread();
+			const Workspace::Scope scope(ws);
+			std::pmr::vector<std::pair<int, ByteView>> sorted_shares(&ws);
+			sorted_shares.reserve(static_cast<size_t>(placed.count));
+			for (int num = 0; num < this_->n; num++) {
+				if (placed.present[num]) {
+					sorted_shares.emplace_back(num, ByteView(placed.data[num], placed.share_size));
+				}
 			}
 			this_->RebuildSorted(sorted_shares, output);
 		}
@@ -292,7 +565,7 @@ public:
 	// if shares is sortable in-place, we will do that.
 	template <typename ShareMap>
 	struct rebuild_specialization<ShareMap, std::enable_if_t<internal::is_sortable_v<ShareMap>>> {
-		static void SortAndRebuild(FEC* this_, ShareMap& shares, const ShareOutputFunc& output) {
+		static void SortAndRebuild(const FEC* this_, ShareMap& shares, const ShareOutputFunc& output) {
 			std::sort(shares);
 			this_->RebuildSorted(shares, output);
 		}
@@ -301,7 +574,7 @@ public:
 	// if shares is already a sorted map, we can pass it straight through.
 	template <typename IntType, typename DataType>
 	struct rebuild_specialization<std::map<IntType, DataType>> {
-		static void SortAndRebuild(FEC* this_, const std::map<IntType, DataType>& shares, const ShareOutputFunc& output) {
+		static void SortAndRebuild(const FEC* this_, const std::map<IntType, DataType>& shares, const ShareOutputFunc& output) {
 			this_->RebuildSorted(shares, output);
 		}
 	};
@@ -319,7 +592,7 @@ public:
 	//
 	// Rebuild assumes that you have already called Correct or did not need to.
 	template <typename ShareMap>
-	void Rebuild(ShareMap& shares, const ShareOutputFunc& output) {
+	void Rebuild(ShareMap& shares, const ShareOutputFunc& output) const {
 		rebuild_specialization<ShareMap>::SortAndRebuild(this, shares, output);
 	}
 
@@ -340,87 +613,482 @@ public:
 	// If you don't want the data concatenated for you, you can use Correct and
 	// then Rebuild individually.
 	template <typename ShareMap, typename OutputType>
-	auto Decode(ShareMap& shares, OutputType& output) -> int {
+	auto Decode(ShareMap& shares, OutputType& output) const -> size_t {
 		Correct(shares);
-		int share_size = 0;
 
-		Rebuild(shares, [&](int num, const ByteView& rebuilt) {
-			if (share_size == 0) {
-				share_size = static_cast<int>(rebuilt.size());
-				if (static_cast<int>(output.size()) < share_size * k) {
-					throw std::invalid_argument("output buffer must have at least "s + std::to_string(share_size * k) + " bytes available"s);
+		// the callback only captures state, so that it is small enough for
+		// std::function to hold without allocating.
+		struct {
+			OutputType& output;
+			size_t required;
+			size_t share_size;
+		} state {output, static_cast<size_t>(k), 0};
+
+		Rebuild(shares, [&state](int num, const ByteView& rebuilt) {
+			if (state.share_size == 0) {
+				state.share_size = rebuilt.size();
+				if (std::size(state.output) < state.share_size * state.required) {
+					throw std::invalid_argument("output buffer must have at least "s + std::to_string(state.share_size * state.required) + " bytes available"s);
 				}
 			}
-			std::copy(rebuilt.begin(), rebuilt.end(), output.begin() + num*share_size);
+			std::copy(rebuilt.begin(), rebuilt.end(), std::begin(state.output) + static_cast<ptrdiff_t>(num*state.share_size));
 		});
 
-		return share_size * k;
+		return state.share_size * state.required;
 	}
 
 	template <typename ShareMap>
-	void DecodeTo(ShareMap& shares, const ShareOutputFunc& output) {
+	void DecodeTo(ShareMap& shares, const ShareOutputFunc& output) const {
 		Correct(shares);
 		Rebuild(shares, output);
 	}
 
+	// DecodeViews is like Decode, but rather than concatenating the data into
+	// an output buffer, it sets pieces[i] to a view of data piece i, for
+	// each of the k data pieces, and returns pieces.
+	//
+	// The data pieces that are among the shares are not copied at all: their
+	// views point into the shares themselves, as corrected. Only missing ones
+	// are rebuilt, into scratch, which must have room for share size bytes
+	// per missing data piece; k times the share size is always enough, and
+	// when every data piece is there, scratch may be empty. The views are
+	// only valid for as long as both the shares and scratch are.
+	//
+	// The shares need not be sorted or in any particular container; they are
+	// placed by share number.
+	template <typename ShareMap>
+	auto DecodeViews(ShareMap& shares, std::span<ByteView> pieces, std::span<uint8_t> scratch) const -> std::span<ByteView> {
+		if (pieces.size() != static_cast<size_t>(k)) {
+			throw std::invalid_argument("pieces must have exactly "s + std::to_string(k) + " entries");
+		}
+
+		Correct(shares);
+
+		const internal::PhaseTimer timer(internal::Stat::RebuildNanos);
+		const auto placed = placeShares(shares);
+		if (placed.count < k) {
+			throw NotEnoughShares();
+		}
+		const size_t share_size = placed.share_size;
+		internal::count_stat(internal::Stat::BytesRebuilt, static_cast<size_t>(k) * share_size);
+
+		// missing data pieces are rebuilt from the highest numbered parity
+		// shares, as RebuildSorted would.
+		std::array<int, byte_max> indexes {};
+		BlockPointers begins {};
+		size_t missing_count = 0;
+		int next_parity = n - 1;
+		for (int i = 0; i < k; i++) {
+			if (placed.present[i]) {
+				indexes[i] = i;
+				pieces[i] = ByteView(placed.data[i], share_size);
+			} else {
+				while (!placed.present[next_parity]) {
+					--next_parity;
+				}
+				indexes[i] = next_parity--;
+				++missing_count;
+			}
+			begins[i] = placed.data[indexes[i]];
+		}
+
+		if (missing_count == 0) {
+			return pieces;
+		}
+		if (scratch.size() < missing_count * share_size) {
+			throw std::invalid_argument("scratch must have at least "s + std::to_string(missing_count * share_size) + " bytes available");
+		}
+
+		// the rows of the decoding matrix for the missing pieces are packed
+		// together, so they are all rebuilt in one pass over the shares.
+		auto& ws = Workspace::ForThisThread();
+		const Workspace::Scope scope(ws);
+		const auto decoding_matrix = decodingMatrix(std::span(indexes.data(), static_cast<size_t>(k)));
+		std::pmr::vector<uint8_t> matrix(&ws);
+		matrix.reserve(missing_count * k);
+		std::array<uint8_t*, byte_max> missing {};
+		size_t m = 0;
+		for (int i = 0; i < k; i++) {
+			if (indexes[i] >= k) {
+				matrix.insert(matrix.end(), &(*decoding_matrix)[i*k], &(*decoding_matrix)[(i+1)*k]);
+				missing[m] = scratch.data() + m*share_size;
+				pieces[i] = ByteView(missing[m], share_size);
+				++m;
+			}
+		}
+		mulMatrix(matrix.data(), missing_count, k, begins.data(), missing.data(), share_size);
+
+		return pieces;
+	}
+
 	// Correct implements the Berlekamp-Welch algorithm for correcting
 	// errors in given FEC encoded data. It will correct the supplied shares,
 	// mutating the underlying byte ranges and reordering the shares
 	template <typename ShareMap>
 	void Correct(ShareMap& shares) const {
+		const internal::PhaseTimer timer(internal::Stat::CorrectNanos);
+		const Workspace::Scope scope(Workspace::ForThisThread());
+		auto [shares_vec, shares_nums, share_size] = collectShares(shares);
+		correct_(shares_vec, shares_nums, share_size, nullptr);
+	}
+
+	// FindBadShares returns the numbers of the shares that are corrupt, in
+	// increasing order. It is meant for the common case where a share is
+	// either entirely good or entirely bad, as with a failing disk or a
+	// misbehaving node: Berlekamp-Welch is only run at a few sample
+	// positions, and the shares it finds bad there are confirmed to be the
+	// only bad ones by checking that the rest are consistent everywhere.
+	//
+	// The shares are not modified, unless that confirmation fails. Then the
+	// errors are not confined to the sampled shares, and FindBadShares falls
+	// back to correcting the shares in place as Correct does, returning
+	// every share that needed correcting.
+	template <typename ShareMap>
+	[[nodiscard]] auto FindBadShares(ShareMap& shares) const -> std::vector<int> {
+		const internal::PhaseTimer timer(internal::Stat::CorrectNanos);
+		const Workspace::Scope scope(Workspace::ForThisThread());
+		auto [shares_vec, shares_nums, share_size] = collectShares(shares);
+		return findBadShares_(shares_vec, shares_nums, share_size, nullptr);
+	}
+
+	// DecodeToDroppingBad is like DecodeTo, but rather than correcting the
+	// shares byte by byte, it uses FindBadShares to identify whole bad shares
+	// and rebuilds from the rest. It returns the bad share numbers.
+	//
+	// If FindBadShares has to fall back to correcting the shares in place,
+	// the bad ones are not dropped, since they have been corrected and there
+	// may not be k shares left without them.
+	template <typename ShareMap>
+	auto DecodeToDroppingBad(ShareMap& shares, const ShareOutputFunc& output) const -> std::vector<int> {
+		bool corrected = false;
+		std::vector<int> bad;
+		{
+			const internal::PhaseTimer timer(internal::Stat::CorrectNanos);
+			const Workspace::Scope scope(Workspace::ForThisThread());
+			auto [shares_vec, shares_nums, share_size] = collectShares(shares);
+			bad = findBadShares_(shares_vec, shares_nums, share_size, &corrected);
+		}
+
+		auto& ws = Workspace::ForThisThread();
+		const Workspace::Scope scope(ws);
+		std::pmr::map<int, ByteView> good(&ws);
+		for (const auto& share : shares) {
+			const int num = share_num(share);
+			if (corrected || !std::binary_search(bad.begin(), bad.end(), num)) {
+				const auto& data = share_data(share);
+				const auto* data_start = std::to_address(std::begin(data));
+				good.try_emplace(num, data_start, static_cast<size_t>(std::to_address(std::end(data)) - data_start));
+			}
+		}
+		RebuildSorted(good, output);
+
+		return bad;
+	}
+
+	// Verify checks whether the given shares are all consistent with each
+	// other, without correcting or modifying anything. It stops at the first
+	// inconsistency found, so it is considerably cheaper than Correct when
+	// only a yes or no answer is needed. With exactly k shares there is no
+	// redundancy to check against, and Verify always returns true.
+	template <typename ShareMap>
+	[[nodiscard]] auto Verify(const ShareMap& shares) const -> bool {
 		if (static_cast<int>(shares.size()) < k) {
 			throw std::invalid_argument("must specify at least the number of required shares");
 		}
 
-		std::vector<uint8_t*> shares_vec(shares.size());
-		std::vector<int> shares_nums(shares.size());
-		shares_vec.resize(0);
-		shares_nums.resize(0);
-		long share_size = 0;
-		for (auto& share : shares) {
-			auto& v = share_data(share);
-			uint8_t* data_start = std::to_address(std::begin(v));
-			uint8_t* data_end = std::to_address(std::end(v));
+		const internal::PhaseTimer timer(internal::Stat::CorrectNanos);
+		auto& ws = Workspace::ForThisThread();
+		const Workspace::Scope scope(ws);
+		std::pmr::vector<const uint8_t*> shares_vec(&ws);
+		std::pmr::vector<int> shares_nums(&ws);
+		shares_vec.reserve(shares.size());
+		shares_nums.reserve(shares.size());
+		size_t share_size = 0;
+		for (const auto& share : shares) {
+			const auto& v = share_data(share);
+			const uint8_t* data_start = std::to_address(std::begin(v));
+			const uint8_t* data_end = std::to_address(std::end(v));
 			share_size = data_end - data_start;
 			shares_vec.push_back(data_start);
 			shares_nums.push_back(share_num(share));
 		}
 
-		correct_(shares_vec, shares_nums, share_size);
+		return syndromeCheck(shares_vec, shares_nums, share_size, nullptr);
 	}
 
 protected:
+	template <int K, int N>
+	friend class FixedFEC;
+	friend class IncrementalDecoder;
+
 	[[nodiscard]] auto berlekampWelch(const std::vector<uint8_t*>& shares_vec, const std::vector<int>& shares_nums, int index) const -> std::vector<uint8_t>;
 
+	// invertMatrix inverts the k by k, row-major matrix in place. It throws
+	// std::domain_error if the matrix is singular.
+	static void invertMatrix(std::span<uint8_t> matrix, int k);
+
 private:
 	class GFMat;
 
 	void initialize();
-	void correct_(std::vector<uint8_t*>& shares_vec, std::vector<int>& shares_nums, long share_size) const;
-	[[nodiscard]] auto syndromeMatrix(const std::vector<int>& shares_nums) const -> GFMat;
+	void initializeCauchy();
+	// collectShares gathers the data pointers and share numbers of shares,
+	// along with their size, for correct_ and findBadShares_. The lists are
+	// allocated from the calling thread's Workspace.
+	template <typename ShareMap>
+	auto collectShares(ShareMap& shares) const -> std::tuple<std::pmr::vector<uint8_t*>, std::pmr::vector<int>, size_t> {
+		if (static_cast<int>(shares.size()) < k) {
+			throw std::invalid_argument("must specify at least the number of required shares");
+		}
+
+		auto& ws = Workspace::ForThisThread();
+		std::pmr::vector<uint8_t*> shares_vec(&ws);
+		std::pmr::vector<int> shares_nums(&ws);
+		shares_vec.reserve(shares.size());
+		shares_nums.reserve(shares.size());
+		size_t share_size = 0;
+		for (auto& share : shares) {
+			auto& v = share_data(share);
+			uint8_t* data_start = std::to_address(std::begin(v));
+			uint8_t* data_end = std::to_address(std::end(v));
+			share_size = data_end - data_start;
+			shares_vec.push_back(data_start);
+			shares_nums.push_back(share_num(share));
+		}
+
+		return {std::move(shares_vec), std::move(shares_nums), share_size};
+	}
+
+	// ShareFlags marks some of a list of shares, by their position in it.
+	using ShareFlags = std::pmr::vector<bool>;
+
+	// correct_ corrects the shares in place. If changed is not null, every
+	// share that needed correcting is marked in it.
+	void correct_(std::span<uint8_t* const> shares_vec, std::span<const int> shares_nums, size_t share_size, ShareFlags* changed) const;
+	// findBadShares_ is FindBadShares. If corrected is not null, it is set to
+	// whether the shares had to be corrected in place.
+	[[nodiscard]] auto findBadShares_(std::span<uint8_t* const> shares_vec, std::span<const int> shares_nums, size_t share_size, bool* corrected) const -> std::vector<int>;
+
+	// berlekampWelch is the above, writing the n values it finds into out.
+	void berlekampWelch(std::span<uint8_t* const> shares_vec, std::span<const int> shares_nums, size_t index, uint8_t* out) const;
+
+	// correctRun tries to correct the dirty byte positions pending[begin:],
+	// supposing that the errors in them are in the same shares as at the
+	// position Berlekamp-Welch last found errors in. It works forward for as
+	// long as that keeps mostly holding, appending any positions where it
+	// doesn't to rejected, and returns where in pending it stopped. rejected
+	// must already have room for all of pending.
+	auto correctRun(
+		std::span<uint8_t* const> shares_vec, std::span<const int> shares_nums,
+		const ShareFlags& bad, std::span<const size_t> pending, size_t begin,
+		std::pmr::vector<size_t>& rejected
+	) const -> size_t;
+	// syndromeMatrix returns the parity-check matrix for the share numbers in
+	// shares_nums, going through the syndrome cache when it is enabled. If it
+	// is not, the matrix is allocated from the calling thread's Workspace.
+	[[nodiscard]] auto syndromeMatrix(std::span<const int> shares_nums) const -> std::shared_ptr<const GFMat>;
+
+	// syndromeCheck applies the syndrome matrix for shares_nums to the shares
+	// and returns whether they are all consistent. If dirty is not null, the
+	// byte positions at which they are not are appended to it in order;
+	// otherwise the check stops at the first inconsistency.
+	[[nodiscard]] auto syndromeCheck(
+		std::span<const uint8_t* const> shares_vec, std::span<const int> shares_nums,
+		size_t share_size, std::pmr::vector<size_t>* dirty
+	) const -> bool;
+
+	// decodingMatrix returns the inverse of the rows of the encoding matrix
+	// for the share numbers in indexes, going through the decode cache when
+	// it is enabled. If it is not, the matrix is allocated from the calling
+	// thread's Workspace.
+	[[nodiscard]] auto decodingMatrix(std::span<const int> indexes) const -> std::shared_ptr<const std::pmr::vector<uint8_t>>;
+
+	// invertShareRows fills out with the inverse of the rows of the encoding
+	// matrix for the k share numbers in nums, so that row i of it gives data
+	// piece i in terms of those shares, in that order.
+	void invertShareRows(std::span<const int> nums, std::span<uint8_t> out) const;
 
-	static void invertMatrix(std::vector<uint8_t>& matrix, int k);
 	static void createInvertedVdm(std::vector<uint8_t>& vdm, int k);
 
 	static void addmul(
 		uint8_t* z_begin, const uint8_t* z_end,
 		const uint8_t* x, uint8_t y
 	);
-#if defined(INFECTIOUS_HAS_VPERM)
-	static auto addmul_vperm(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
-#endif
-#if defined(INFECTIOUS_HAS_SSE2)
-	static auto addmul_sse2(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
-#endif
+
+	using BlockPointers = std::array<const uint8_t*, byte_max>;
+
+	// pickShares chooses which k of the sorted shares to rebuild from: every
+	// data share there is, at the position of its number, and the highest
+	// numbered parity shares in place of the missing ones. It fills in the
+	// number and start of each, and returns the share size along with
+	// whether any data share was missing.
+	template <typename ShareMap>
+	auto pickShares(const ShareMap& shares, std::array<int, byte_max>& indexes, BlockPointers& begins) const -> std::pair<size_t, bool> {
+		auto shares_b_iter = std::begin(shares);
+		auto shares_e_iter = std::rbegin(shares);
+
+		bool missing_primary_share = false;
+		size_t share_size = 0;
+
+		for (int i = 0; i < k; i++) {
+			int share_id = 0;
+			int shares_b_num = share_num(*shares_b_iter);
+			if (shares_b_num == i) {
+				share_id = shares_b_num;
+				auto& data = share_data(*shares_b_iter);
+				begins[i] = std::to_address(std::begin(data));
+				share_size = static_cast<size_t>(std::to_address(std::end(data)) - begins[i]);
+				++shares_b_iter;
+			} else {
+				share_id = share_num(*shares_e_iter);
+				auto& data = share_data(*shares_e_iter);
+				begins[i] = std::to_address(std::begin(data));
+				share_size = static_cast<size_t>(std::to_address(std::end(data)) - begins[i]);
+				++shares_e_iter;
+				missing_primary_share = true;
+			}
+
+			if (share_id < 0 || share_id >= n) {
+				throw std::invalid_argument("invalid share id: "s + std::to_string(share_id));
+			}
+
+			indexes[i] = share_id;
+		}
+		return {share_size, missing_primary_share};
+	}
+
+	// PlacedShares holds a set of shares by share number.
+	struct PlacedShares {
+		std::array<const uint8_t*, byte_max> data {};
+		std::array<bool, byte_max> present {};
+		size_t share_size {0};
+		int count {0};
+	};
+
+	// placeShares puts each of shares in the bucket for its share number, in
+	// one pass and whatever order they come in. If a share number is given
+	// more than once, the first one is kept.
+	template <typename ShareMap>
+	auto placeShares(ShareMap& shares) const -> PlacedShares {
+		PlacedShares placed;
+		for (const auto& share : shares) {
+			const int num = share_num(share);
+			if (num < 0 || num >= n) {
+				throw std::invalid_argument("invalid share id: "s + std::to_string(num));
+			}
+			if (placed.present[num]) {
+				continue;
+			}
+			const auto& data = share_data(share);
+			placed.data[num] = std::to_address(std::begin(data));
+			placed.share_size = static_cast<size_t>(std::to_address(std::end(data)) - placed.data[num]);
+			placed.present[num] = true;
+			++placed.count;
+		}
+		return placed;
+	}
+
+	// split_blocks checks that input divides evenly into k blocks, and returns
+	// a pointer to the start of each block along with the block size.
+	template <typename InputType>
+	auto split_blocks(const InputType& input) const -> std::pair<BlockPointers, size_t> {
+		const size_t size = std::size(input);
+
+		if (size % k != 0) {
+			throw std::invalid_argument("input length must be a multiple of k");
+		}
+
+		const size_t block_size = size / k;
+
+		BlockPointers inputs {};
+		auto ibegin = std::begin(input);
+		for (int i = 0; i < k; i++) {
+			inputs[i] = std::to_address(ibegin) + i*block_size;
+		}
+		return {inputs, block_size};
+	}
+
+	// encode_parity computes size bytes of each parity share k+i from the
+	// k inputs into parity[i], skipping any parity[i] that is nullptr. The
+	// inputs and outputs may point into the middle of their blocks.
+	void encode_parity(const uint8_t* const* inputs, uint8_t* const* parity, size_t size) const;
+
+	// encode_segments produces each non-empty set of segments in outputs.
+	void encode_segments(const uint8_t* const* inputs, std::span<const ShareSegments> outputs, size_t block_size) const;
+
+	// columnChunks returns how many column ranges parallelColumns splits size
+	// bytes into.
+	[[nodiscard]] auto columnChunks(size_t size) const -> size_t;
+
+	// parallelColumns splits [0, size) into cache aligned column ranges and
+	// calls fn(chunk, begin, end) for each through the executor, or just
+	// calls fn(0, 0, size) if there is none.
+	void parallelColumns(size_t size, const std::function<void(size_t chunk, size_t begin, size_t end)>& fn) const;
+
+	// mulMatrix is mul_matrix, spread across the executor.
+	void mulMatrix(
+		const uint8_t* matrix, size_t rows, size_t cols,
+		const uint8_t* const* inputs, uint8_t* const* outputs,
+		size_t size
+	) const;
+
+	// mul_matrix computes outputs = matrix * inputs, where matrix is a row
+	// major rows by cols matrix and each input and output is size bytes. The
+	// outputs are overwritten, not accumulated into. The work is done in
+	// column tiles small enough that the current tile of every input stays
+	// in cache while all of the outputs for it are produced.
+	static void mul_matrix(
+		const uint8_t* matrix, size_t rows, size_t cols,
+		const uint8_t* const* inputs, uint8_t* const* outputs,
+		size_t size
+	);
 
 	int k;
 	int n;
+	Matrix matrix_kind;
 	std::vector<uint8_t> enc_matrix;
 	std::vector<uint8_t> vand_matrix;
+	// eval_powers[num*n + j] is the Berlekamp-Welch evaluation point of
+	// share num raised to the power j.
+	std::vector<uint8_t> eval_powers;
+	// share_weights[num] is what share num is multiplied by to give the
+	// value at its evaluation point of the polynomial Berlekamp-Welch finds.
+	// It is empty when that is always 1, as it is for Vandermonde matrices.
+	std::vector<uint8_t> share_weights;
+	std::shared_ptr<internal::MatrixCache<std::pmr::vector<uint8_t>>> decode_cache;
+	std::shared_ptr<internal::MatrixCache<GFMat>> syndrome_cache;
+	std::shared_ptr<Executor> executor;
+	size_t parallel_chunk {default_parallel_chunk};
 };
 
+// addmul_provider returns the name of the addmul implementation currently
+// in use.
 auto INFECTIOUS_EXPORT addmul_provider() -> std::string;
 
+// addmul_providers returns the names of all addmul implementations that are
+// supported on this CPU, fastest first. They always include "none", the
+// portable implementation, and two more portable implementations that are
+// never used unless asked for: "nibble", which keeps its tables within 8 KiB
+// for CPUs with small L1 caches, and "xor", which uses no tables at all and
+// suits CPUs without a vector shuffle, particularly with a FEC using
+// FEC::Matrix::Cauchy.
+auto INFECTIOUS_EXPORT addmul_providers() -> std::vector<std::string>;
+
+// set_addmul_provider forces the use of a particular addmul implementation,
+// by the name returned from addmul_providers(). This is meant for testing
+// and benchmarking; the default is the fastest supported implementation,
+// which can be restored by passing "auto". Throws std::invalid_argument if
+// the name is unknown or the implementation is not supported on this CPU.
+//
+// The default can also be pinned without any code changes by naming an
+// implementation in the INFECTIOUS_ADDMUL_PROVIDER environment variable,
+// which is consulted when the library is loaded and by "auto". It is
+// ignored if that implementation is unknown or not supported on this CPU,
+// so check addmul_provider() where that matters. Individual CPU features can
+// be hidden from the library with INFECTIOUS_CPUID_DISABLE, a comma
+// separated list of names such as "avx512bw,gfni".
+void INFECTIOUS_EXPORT set_addmul_provider(const std::string& name);
+
 auto INFECTIOUS_EXPORT build_environment() -> const char*;
 
 } // namespace infectious
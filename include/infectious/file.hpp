@@ -0,0 +1,122 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_FILE_HPP
+#define INFECTIOUS_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+
+#include "infectious/build_env.h"
+#include "infectious/fec.hpp"
+
+#if defined(INFECTIOUS_TARGET_OS_HAS_POSIX1)
+
+namespace infectious {
+
+// MapOptions tunes how files are mapped into memory.
+struct MapOptions {
+	// sequential tells the kernel the mapping will be worked through front
+	// to back, so that it reads ahead aggressively and drops pages behind.
+	bool sequential {true};
+	// huge_pages asks for the mapping to be backed by transparent huge
+	// pages, where the system supports that for files. It is only a hint.
+	bool huge_pages {false};
+	// sync makes the files written by EncodeFile and DecodeFile be flushed
+	// to disk before they return, rather than whenever the kernel gets to it.
+	bool sync {false};
+};
+
+// MappedFile is a whole file mapped into memory. It unmaps the file when
+// destroyed. An empty file has no mapping, and a null data().
+//
+// Errors from the system are thrown as std::system_error.
+class INFECTIOUS_EXPORT MappedFile {
+public:
+	enum class Mode {
+		// the mapping may only be read.
+		ReadOnly,
+		// the mapping may be written, but the changes are private to it and
+		// never reach the file.
+		CopyOnWrite,
+		// the mapping may be written, and the changes are written to the file.
+		ReadWrite,
+	};
+
+	// Open maps the whole of the existing file at path.
+	static auto Open(const std::string& path, Mode mode = Mode::ReadOnly, const MapOptions& options = {}) -> MappedFile;
+
+	// Create creates the file at path, or truncates it if it exists, to size
+	// zero bytes, reserving the space for them on disk where the system
+	// allows, and maps it read-write.
+	static auto Create(const std::string& path, size_t size, const MapOptions& options = {}) -> MappedFile;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	auto operator=(const MappedFile&) -> MappedFile& = delete;
+	auto operator=(MappedFile&& other) noexcept -> MappedFile&;
+	~MappedFile();
+
+	[[nodiscard]] auto data() const -> uint8_t* {
+		return addr;
+	}
+
+	[[nodiscard]] auto size() const -> size_t {
+		return length;
+	}
+
+	[[nodiscard]] auto Bytes() const -> std::span<uint8_t> {
+		return {addr, length};
+	}
+
+	// Sync writes any changes to a read-write mapping back to the file, and
+	// waits for them to reach the disk.
+	void Sync() const;
+
+private:
+	MappedFile(uint8_t* addr_, size_t length_)
+		: addr {addr_}
+		, length {length_}
+	{}
+
+	static auto mapFile(int fd, size_t size, Mode mode, const MapOptions& options, const std::string& path) -> MappedFile;
+
+	uint8_t* addr {nullptr};
+	size_t length {0};
+};
+
+// EncodeFile encodes the file at input_path into n share files, share i
+// being written to share_paths[i]. An empty path skips that share. It
+// returns the size of the input, which DecodeFile needs to be given.
+//
+// The input is mapped into memory and the share files are created at their
+// final size and mapped as well, so the data goes from the page cache of
+// one to the page cache of the others without any intermediate buffers or
+// read and write calls. The parity shares are computed straight from the
+// input mapping, in one pass, and in parallel if fec has an executor.
+//
+// This splits the input into k contiguous blocks, as Encode does, with the
+// last of them padded with zero bytes when the input size is not a multiple
+// of k. Each share file is ceil(size / k) bytes.
+auto INFECTIOUS_EXPORT EncodeFile(
+	const FEC& fec, const std::string& input_path, std::span<const std::string> share_paths,
+	const MapOptions& options = {}
+) -> size_t;
+
+// DecodeFile decodes the share files in share_paths, keyed by share number,
+// into a file of size bytes at output_path, where size is what EncodeFile
+// returned. There must be at least k shares. With more than k, errors in
+// them are corrected as by Decode, without changing the share files.
+void INFECTIOUS_EXPORT DecodeFile(
+	const FEC& fec, const std::map<int, std::string>& share_paths, const std::string& output_path, size_t size,
+	const MapOptions& options = {}
+);
+
+} // namespace infectious
+
+#endif // INFECTIOUS_TARGET_OS_HAS_POSIX1
+
+#endif // INFECTIOUS_FILE_HPP
@@ -0,0 +1,183 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_FIXED_FEC_HPP
+#define INFECTIOUS_FIXED_FEC_HPP
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+
+#include "infectious/constexpr_gf.hpp"
+#include "infectious/fec.hpp"
+
+namespace infectious {
+
+namespace internal::constexpr_gf {
+
+// encode_matrix builds the same N x K encoding matrix as FEC(K, N).
+template <int K, int N>
+consteval auto encode_matrix() -> std::array<uint8_t, N * K> {
+	// the inverted Vandermonde matrix, as in FEC::createInvertedVdm.
+	std::array<uint8_t, N * K> temp {};
+	if constexpr (K == 1) {
+		temp[0] = 1;
+	} else {
+		std::array<uint8_t, K> b {};
+		std::array<uint8_t, K> c {};
+
+		for (int i = 1; i < K; i++) {
+			for (int j = K - 1 - (i - 1); j < K - 1; j++) {
+				c[j] ^= mul(tables.exp[i], c[j+1]);
+			}
+			c[K-1] ^= tables.exp[i];
+		}
+
+		for (int row = 0; row < K; row++) {
+			const uint8_t p_row = row == 0 ? 0 : tables.exp[row];
+
+			uint8_t t = 1;
+			b[K-1] = 1;
+			for (int i = K - 2; i >= 0; i--) {
+				b[i] = c[i+1] ^ mul(p_row, b[i+1]);
+				t = b[i] ^ mul(p_row, t);
+			}
+
+			const uint8_t t_inv = inverse(t);
+			for (int col = 0; col < K; col++) {
+				temp[col*K+row] = mul(t_inv, b[col]);
+			}
+		}
+	}
+
+	for (int i = K * K; i < N * K; i++) {
+		temp[i] = tables.exp[((i/K)*(i%K)) % (field_size - 1)];
+	}
+
+	std::array<uint8_t, N * K> enc {};
+	for (int i = 0; i < K; i++) {
+		enc[i*(K+1)] = 1;
+	}
+	for (int row = K * K; row < N * K; row += K) {
+		for (int col = 0; col < K; ++col) {
+			uint8_t acc = 0;
+			for (int i = 0; i < K; ++i) {
+				acc ^= mul(temp[row + i], temp[col + K * i]);
+			}
+			enc[row+col] = acc;
+		}
+	}
+	return enc;
+}
+
+} // namespace internal::constexpr_gf
+
+// FixedFEC is a FEC for a (K, N) fixed at compile time, for deployments that
+// only ever use one or two schemes. Its encoding matrix is computed by the
+// compiler, and all of its inner bookkeeping is over fixed size arrays, so it
+// does no allocation and next to no validation at run time.
+//
+// The pieces it produces are identical to those produced by FEC(K, N), so
+// data encoded with one can be decoded with the other. FixedFEC only
+// encodes; use FEC(K, N) to decode.
+//
+// Very large K may need the compiler's constexpr evaluation limits raised.
+template <int K, int N>
+class FixedFEC {
+	static_assert(1 <= K && K <= N && N <= FEC::byte_max, "requires 1 <= K <= N <= 256");
+
+public:
+	static constexpr int k = K;
+	static constexpr int n = N;
+
+	// Matrix returns the N x K encoding matrix, row major.
+	[[nodiscard]] static constexpr auto Matrix() -> const std::array<uint8_t, N * K>& {
+		return enc_matrix;
+	}
+
+	[[nodiscard]] static constexpr auto Required() -> int {
+		return K;
+	}
+
+	[[nodiscard]] static constexpr auto Total() -> int {
+		return N;
+	}
+
+	// EncodeParity is as FEC::EncodeParity: it writes parity piece K+i of
+	// input to parity[i]. The input must be a multiple of K bytes long, and
+	// each parity buffer must hold at least len(input) / K bytes.
+	static void EncodeParity(ByteView input, std::span<uint8_t* const, N - K> parity) {
+		if (input.size() % K != 0) {
+			throw std::invalid_argument("input length must be a multiple of k");
+		}
+
+		const size_t block_size = input.size() / K;
+		const auto inputs = blocks(input.data(), block_size);
+		const internal::PhaseTimer timer(internal::Stat::EncodeNanos);
+		internal::count_stat(internal::Stat::BytesEncoded, input.size());
+		if constexpr (N > K) {
+			FEC::mul_matrix(&enc_matrix[K*K], N - K, K, inputs.data(), parity.data(), block_size);
+		}
+	}
+
+	// EncodeSingle is as FEC::EncodeSingle: it writes piece num of input to
+	// output, which must hold len(input) / K bytes.
+	static void EncodeSingle(int num, ByteView input, uint8_t* output) {
+		if (num < 0 || num >= N) {
+			throw std::invalid_argument("num must be in [0, n)");
+		}
+		if (input.size() % K != 0) {
+			throw std::invalid_argument("input length must be a multiple of k");
+		}
+
+		const size_t block_size = input.size() / K;
+		const internal::PhaseTimer timer(internal::Stat::EncodeNanos);
+		internal::count_stat(internal::Stat::BytesEncoded, input.size());
+		if (num < K) {
+			std::copy_n(input.data() + num*block_size, block_size, output);
+			return;
+		}
+
+		const auto inputs = blocks(input.data(), block_size);
+		FEC::mul_matrix(&enc_matrix[num*K], 1, K, inputs.data(), &output, block_size);
+	}
+
+	// Encode is as FEC::Encode, calling output N times with the pieces of
+	// input. The parity pieces are all computed up front, in one pass, into
+	// parity_buf, which must hold (N-K) * len(input) / K bytes.
+	static void Encode(ByteView input, std::span<uint8_t> parity_buf, const ShareOutputFunc& output) {
+		const size_t block_size = input.size() / K;
+		if (parity_buf.size() < (N - K) * block_size) {
+			throw std::invalid_argument("parity buffer too small");
+		}
+
+		std::array<uint8_t*, N - K> parity {};
+		for (int i = 0; i < N - K; i++) {
+			parity[i] = parity_buf.data() + i*block_size;
+		}
+		EncodeParity(input, parity);
+
+		for (int i = 0; i < K; i++) {
+			output(i, ByteView(input.data() + i*block_size, block_size));
+		}
+		for (int i = K; i < N; i++) {
+			output(i, ByteView(parity[i - K], block_size));
+		}
+	}
+
+private:
+	static constexpr std::array<uint8_t, N * K> enc_matrix = internal::constexpr_gf::encode_matrix<K, N>();
+
+	static auto blocks(const uint8_t* data, size_t block_size) -> std::array<const uint8_t*, K> {
+		std::array<const uint8_t*, K> inputs {};
+		for (int i = 0; i < K; i++) {
+			inputs[i] = data + i*block_size;
+		}
+		return inputs;
+	}
+};
+
+} // namespace infectious
+
+#endif // INFECTIOUS_FIXED_FEC_HPP
@@ -0,0 +1,136 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_GENERATOR_HPP
+#define INFECTIOUS_GENERATOR_HPP
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace infectious {
+
+// Generator is a lazily evaluated sequence of T produced by a coroutine
+// with co_yield, in the manner of C++23's std::generator. The coroutine
+// only runs as far as the next value each time the sequence is advanced,
+// so nothing is computed ahead of what the consumer has asked for.
+//
+// A yielded value is only valid until the Generator is advanced again. The
+// coroutine may not co_await anything; it is meant to be iterated from
+// within whatever asynchronous code the caller has, which can then await
+// between values as it likes.
+template <typename T>
+class Generator {
+public:
+	struct promise_type {
+		const T* current {nullptr};
+		std::exception_ptr exception;
+
+		auto get_return_object() -> Generator {
+			return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		static auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+		static auto final_suspend() noexcept -> std::suspend_always { return {}; }
+		auto yield_value(const T& value) noexcept -> std::suspend_always {
+			current = std::addressof(value);
+			return {};
+		}
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept {
+			exception = std::current_exception();
+		}
+
+		template <typename U>
+		auto await_transform(U&& value) -> std::suspend_never = delete;
+	};
+
+	class iterator {
+	public:
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() = default;
+
+		auto operator*() const -> const T& {
+			return *coroutine.promise().current;
+		}
+		auto operator->() const -> const T* {
+			return coroutine.promise().current;
+		}
+		auto operator++() -> iterator& {
+			advance(coroutine);
+			return *this;
+		}
+		void operator++(int) {
+			++*this;
+		}
+		friend auto operator==(const iterator& it, std::default_sentinel_t /*end*/) -> bool {
+			return !it.coroutine || it.coroutine.done();
+		}
+
+	private:
+		friend class Generator;
+
+		explicit iterator(std::coroutine_handle<promise_type> coroutine_)
+			: coroutine {coroutine_}
+		{}
+
+		std::coroutine_handle<promise_type> coroutine;
+	};
+
+	Generator(const Generator&) = delete;
+	auto operator=(const Generator&) -> Generator& = delete;
+	Generator(Generator&& other) noexcept
+		: coroutine {std::exchange(other.coroutine, nullptr)}
+	{}
+	auto operator=(Generator&& other) noexcept -> Generator& {
+		if (this != &other) {
+			if (coroutine) {
+				coroutine.destroy();
+			}
+			coroutine = std::exchange(other.coroutine, nullptr);
+		}
+		return *this;
+	}
+	~Generator() {
+		if (coroutine) {
+			coroutine.destroy();
+		}
+	}
+
+	// begin runs the coroutine to its first value. A Generator can only be
+	// iterated once.
+	auto begin() -> iterator {
+		advance(coroutine);
+		return iterator(coroutine);
+	}
+
+	static auto end() noexcept -> std::default_sentinel_t {
+		return std::default_sentinel;
+	}
+
+private:
+	explicit Generator(std::coroutine_handle<promise_type> coroutine_)
+		: coroutine {coroutine_}
+	{}
+
+	// advance resumes the coroutine to its next value, or its end, passing
+	// on anything it throws.
+	static void advance(std::coroutine_handle<promise_type> coroutine) {
+		if (!coroutine || coroutine.done()) {
+			return;
+		}
+		coroutine.resume();
+		if (auto exception = std::exchange(coroutine.promise().exception, nullptr)) {
+			std::rethrow_exception(exception);
+		}
+	}
+
+	std::coroutine_handle<promise_type> coroutine;
+};
+
+} // namespace infectious
+
+#endif // INFECTIOUS_GENERATOR_HPP
@@ -0,0 +1,97 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_INCREMENTAL_HPP
+#define INFECTIOUS_INCREMENTAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "infectious/build_env.h"
+#include "infectious/fec.hpp"
+
+namespace infectious {
+
+// IncrementalDecoder decodes shares as they arrive, rather than waiting for
+// all of them to be in hand as Decode does. It is meant for fetching shares
+// from many places at once and keeping whichever k arrive first: most of
+// the decoding work is done while the rest are still arriving, so little
+// is left to do once the last one needed has.
+//
+// Decoding is a linear map applied to each byte position separately, so it
+// is done a byte range at a time, as chunks come in, rather than a share at
+// a time. Once k shares have reached some byte, everything up to it is
+// decoded from k of those shares, data shares first, with the rows of the
+// decoding matrix for them, which only changes when they do. A data piece
+// whose share is among them needs no work at all, since it is that share;
+// the others are decoded straight into the space kept for their shares,
+// which the shares themselves overwrite if they arrive later. Each share
+// is kept once, and when the k-th one completes at most its last chunk is
+// left to decode.
+class INFECTIOUS_EXPORT IncrementalDecoder {
+public:
+	// This constructor creates an IncrementalDecoder for fec, which is
+	// copied, for shares of share_size bytes each.
+	IncrementalDecoder(const FEC& fec_, size_t share_size_);
+
+	// Write adds data to share num. A share may be given in several chunks,
+	// which must come in order, and is decoded with as soon as k shares
+	// have reached the same bytes. Every share is kept, for FinishCorrected
+	// to check against.
+	void Write(int num, ByteView data);
+
+	// Ready reports whether k shares are complete, so that Finish can be
+	// called.
+	[[nodiscard]] auto Ready() const -> bool {
+		return complete >= fec.Required();
+	}
+
+	// Complete returns the number of shares that are complete.
+	[[nodiscard]] auto Complete() const -> int {
+		return complete;
+	}
+
+	// Decoded returns the number of leading bytes of every data piece that
+	// have been decoded so far, which is how far the k-th furthest share
+	// has got. It is share_size once the decoder is Ready.
+	[[nodiscard]] auto Decoded() const -> size_t {
+		return decoded;
+	}
+
+	// Finish calls output with each of the k data pieces, in order, without
+	// checking them for errors. A data piece is its own share as far as
+	// that has arrived, and was decoded from k others beyond that. It
+	// throws NotEnoughShares if it is not Ready. The byte ranges passed to
+	// output remain valid until this decoder is written to again or
+	// destroyed.
+	void Finish(const ShareOutputFunc& output) const;
+
+	// FinishCorrected is like Finish, but first checks every complete share
+	// against the others, as Verify does. If they are all consistent, that
+	// costs no more than the check. Otherwise the complete shares are
+	// corrected, as by Correct, and the data rebuilt from them, so this
+	// throws TooManyErrors when there are too many errors to correct.
+	void FinishCorrected(const ShareOutputFunc& output);
+
+private:
+	// decode decodes every data piece from the decoded bytes up to end.
+	void decode(size_t end);
+
+	FEC fec;
+	size_t share_size;
+	// shares holds share_size bytes for each share that has been written
+	// to or decoded into, and written how many of them came from Write.
+	std::vector<std::vector<uint8_t>> shares;
+	std::vector<size_t> written;
+	int complete {0};
+	size_t decoded {0};
+	// picked is the k shares the last range was decoded from, and inverse
+	// the decoding matrix for them.
+	std::vector<int> picked;
+	std::vector<uint8_t> inverse;
+};
+
+} // namespace infectious
+
+#endif // INFECTIOUS_INCREMENTAL_HPP
@@ -0,0 +1,129 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_STATS_HPP
+#define INFECTIOUS_STATS_HPP
+
+#include <chrono>
+#include <cstdint>
+
+#include "infectious/build_env.h"
+
+namespace infectious {
+
+// Stats is a snapshot of the process-wide counters kept on the work done by
+// every FEC, for export to a monitoring system. All of the counters only
+// ever go up, apart from ResetStats.
+//
+// The counters are only kept when the library is built with
+// INFECTIOUS_ENABLE_STATS (the CMake option of the same name); otherwise
+// GetStats always returns all zeroes, and counting costs nothing at all.
+struct Stats {
+	// bytes of input data encoded, by any of the Encode calls.
+	uint64_t bytes_encoded;
+	// bytes of data pieces produced by the Rebuild calls, whether they had to
+	// be computed or were passed straight through.
+	uint64_t bytes_rebuilt;
+	// byte positions that were found inconsistent across the shares and
+	// corrected, by Correct or by FindBadShares falling back to it.
+	uint64_t bytes_corrected;
+
+	// decoding and parity-check matrices computed by inverting a matrix.
+	uint64_t matrix_inversions;
+	// lookups answered from the decode and syndrome caches, when enabled.
+	uint64_t decode_cache_hits;
+	uint64_t syndrome_cache_hits;
+
+	// syndrome checks that found the shares consistent, or not.
+	uint64_t syndrome_clean;
+	uint64_t syndrome_dirty;
+	// positions Berlekamp-Welch was run at to correct errors.
+	uint64_t berlekamp_welch_runs;
+
+	// wall time spent in each phase, summed over all threads. Work that is
+	// spread across an executor is counted once, as the time the calling
+	// thread spent waiting for it.
+	std::chrono::nanoseconds encode_time;
+	std::chrono::nanoseconds rebuild_time;
+	// Correct, FindBadShares and Verify.
+	std::chrono::nanoseconds correct_time;
+};
+
+// stats_enabled tells whether this build keeps the Stats counters.
+#if defined(INFECTIOUS_ENABLE_STATS)
+inline constexpr bool stats_enabled = true;
+#else
+inline constexpr bool stats_enabled = false;
+#endif
+
+// GetStats adds up the counters of every thread. It takes no locks, and
+// never holds up threads that are counting; a snapshot taken while work is
+// going on may include some of the counts of an operation but not others.
+auto INFECTIOUS_EXPORT GetStats() -> Stats;
+
+// ResetStats sets all of the counters back to zero. Counts made by other
+// threads while it runs may or may not survive it.
+void INFECTIOUS_EXPORT ResetStats();
+
+namespace internal {
+
+// Stat names each of the counters behind Stats.
+enum class Stat : unsigned {
+	BytesEncoded,
+	BytesRebuilt,
+	BytesCorrected,
+	MatrixInversions,
+	DecodeCacheHits,
+	SyndromeCacheHits,
+	SyndromeClean,
+	SyndromeDirty,
+	BerlekampWelchRuns,
+	EncodeNanos,
+	RebuildNanos,
+	CorrectNanos,
+	Count,
+};
+
+#if defined(INFECTIOUS_ENABLE_STATS)
+
+// count_stat adds amount to the calling thread's copy of stat.
+void INFECTIOUS_EXPORT count_stat(Stat stat, uint64_t amount) noexcept;
+
+// PhaseTimer adds the time from its construction to its destruction to one
+// of the time counters.
+class PhaseTimer {
+public:
+	explicit PhaseTimer(Stat stat_)
+		: stat {stat_}
+		, start {std::chrono::steady_clock::now()}
+	{}
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer(PhaseTimer&&) = delete;
+	auto operator=(const PhaseTimer&) -> PhaseTimer& = delete;
+	auto operator=(PhaseTimer&&) -> PhaseTimer& = delete;
+	~PhaseTimer() {
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		count_stat(stat, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+	}
+
+private:
+	const Stat stat;
+	const std::chrono::steady_clock::time_point start;
+};
+
+#else
+
+inline void count_stat(Stat /*stat*/, uint64_t /*amount*/) noexcept {}
+
+class PhaseTimer {
+public:
+	explicit PhaseTimer(Stat /*stat*/) {}
+};
+
+#endif
+
+} // namespace internal
+
+} // namespace infectious
+
+#endif // INFECTIOUS_STATS_HPP
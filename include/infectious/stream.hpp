@@ -0,0 +1,149 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_STREAM_HPP
+#define INFECTIOUS_STREAM_HPP
+
+#include <array>
+#include <functional>
+#include <map>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "infectious/build_env.h"
+#include "infectious/fec.hpp"
+#include "infectious/generator.hpp"
+
+namespace infectious {
+
+using DataOutputFunc = std::function<void(ByteView data)>;
+
+// ShareChunk is the piece of one stripe that belongs to share num.
+struct ShareChunk {
+	int num;
+	ByteView data;
+};
+
+// StreamEncoder encodes a stream of data of any length, given to it in
+// chunks of any size, while only holding on to one stripe of it at a time.
+//
+// The data is split into stripes of k*stripe_size bytes, and each stripe is
+// encoded independently, as by Encode, into n pieces of stripe_size bytes.
+// Share i of the stream is then piece i of every stripe, in order. This is
+// the same layout as the erasure coded streams in Storj's eestream, and is
+// NOT the same as encoding the whole stream at once with FEC::Encode, which
+// splits its input into k contiguous blocks instead; use StreamDecoder (or
+// decode each stripe separately) to get the data back.
+class INFECTIOUS_EXPORT StreamEncoder {
+public:
+	// This constructor creates a StreamEncoder for fec, which is copied, with
+	// pieces of stripe_size bytes.
+	StreamEncoder(const FEC& fec_, size_t stripe_size_);
+
+	// Write adds data to the stream. Each time a stripe fills up, output is
+	// called n times with the pieces of it, as with Encode. The byte ranges
+	// passed to output may be reused when output returns.
+	void Write(ByteView data, const ShareOutputFunc& output);
+
+	// Finish encodes whatever is left of the stream as a final, shorter
+	// stripe, after padding it with zero bytes to a multiple of k. It returns
+	// the number of padding bytes added, which it is up to the caller to
+	// account for when decoding.
+	auto Finish(const ShareOutputFunc& output) -> size_t;
+
+	// Chunks is like Write, but rather than calling an output function it
+	// yields the pieces of each stripe that fills up, in stripe order and
+	// then share number order. A stripe is only encoded once the pieces
+	// before it have been taken, so a consumer that sends each piece before
+	// asking for the next one holds back the encoding, and through it the
+	// reading of more input, as far as its slowest destination.
+	//
+	// A piece is only valid until the generator is advanced past the last
+	// piece of its stripe, share n-1. data must stay valid until the
+	// generator is done, and the generator must be run to its end before
+	// this encoder is used again.
+	auto Chunks(ByteView data) -> Generator<ShareChunk>;
+
+	// FinishChunks is like Finish, but returns the pieces of the final
+	// stripe as a generator, together with the number of padding bytes.
+	auto FinishChunks() -> std::pair<Generator<ShareChunk>, size_t>;
+
+	// Buffers returns the buffers this encoder keeps pieces in: every piece
+	// that is not part of the data given to Chunks is in one of them. They
+	// stay put for the life of the encoder, so they can be registered for
+	// I/O once up front.
+	[[nodiscard]] auto Buffers() const -> std::array<ByteView, 2> {
+		return {ByteView(stripe.data(), stripe.size()), ByteView(parity.data(), parity.size())};
+	}
+
+	// StripeSize returns the size of the pieces of a full stripe.
+	[[nodiscard]] auto StripeSize() const -> size_t {
+		return stripe_size;
+	}
+
+private:
+	void encodeStripe(const uint8_t* data, size_t piece_size, const ShareOutputFunc& output);
+	auto stripeChunks(const uint8_t* data, size_t piece_size) -> Generator<ShareChunk>;
+	auto padFinalStripe() -> std::pair<size_t, size_t>;
+
+	FEC fec;
+	size_t stripe_size;
+	std::vector<uint8_t> stripe;
+	size_t buffered {0};
+	std::vector<uint8_t> parity;
+	std::vector<uint8_t*> parity_ptrs;
+};
+
+// StreamDecoder decodes a stream of shares produced by StreamEncoder, given
+// to it in chunks of any size. It only holds on to the data of a share until
+// the stripes it is part of can be decoded, so as long as the shares are
+// given at about the same pace it holds about one stripe of each.
+//
+// The set of shares that will be given is fixed up front. There must be at
+// least k of them; with more than k, errors in them are corrected as by
+// Decode. Each stripe is decoded as soon as every share has its piece of it.
+class INFECTIOUS_EXPORT StreamDecoder {
+public:
+	// This constructor creates a StreamDecoder for fec, which is copied, for
+	// shares encoded with pieces of stripe_size bytes, that will be given the
+	// shares numbered share_nums.
+	//
+	// Unless fec already has them, one entry decode and syndrome caches are
+	// enabled on the copy, as every stripe needs the same matrices.
+	StreamDecoder(const FEC& fec_, size_t stripe_size_, std::span<const int> share_nums);
+
+	// Write adds data to share num. Each time a stripe is complete, output is
+	// called with the k*stripe_size bytes of data that it decodes to. The
+	// byte range passed to output may be reused when output returns.
+	void Write(int num, ByteView data, const DataOutputFunc& output);
+
+	// Finish decodes the final stripe, which may be shorter than the rest.
+	// Every share must have been given the same amount of data.
+	void Finish(const DataOutputFunc& output);
+
+private:
+	// ShareBuffer holds the data given for one share that has not been
+	// decoded yet, which is data from start on. Decoding a stripe just moves
+	// start along; the decoded bytes are only dropped once they make up half
+	// of data, so that each byte is moved a bounded number of times however
+	// far ahead of the others a share gets.
+	struct ShareBuffer {
+		std::vector<uint8_t> data;
+		size_t start {0};
+
+		[[nodiscard]] auto size() const -> size_t { return data.size() - start; }
+		void consume(size_t len);
+	};
+
+	void decodeStripe(size_t piece_size, const DataOutputFunc& output);
+
+	FEC fec;
+	size_t stripe_size;
+	std::map<int, ShareBuffer> pieces;
+	std::vector<uint8_t> stripe;
+};
+
+} // namespace infectious
+
+#endif // INFECTIOUS_STREAM_HPP
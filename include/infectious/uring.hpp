@@ -0,0 +1,68 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_URING_HPP
+#define INFECTIOUS_URING_HPP
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "infectious/build_env.h"
+#include "infectious/fec.hpp"
+#include "infectious/generator.hpp"
+#include "infectious/stream.hpp"
+
+#if defined(INFECTIOUS_TARGET_OS_HAS_IO_URING)
+
+namespace infectious {
+
+// UringShareWriter writes the pieces yielded by StreamEncoder::Chunks to one
+// file descriptor per share, through an io_uring of its own. All the pieces
+// of a stripe are submitted together and written straight from where the
+// encoder left them, and the next stripe is only asked for once they have
+// all been written, so a slow destination holds back the encoding.
+//
+// Pieces in buffers given to RegisterBuffers are written with fixed buffer
+// writes, which save the kernel from mapping the pages for each one; others
+// are written as they are. Writes go to the current position of each file
+// descriptor, which is advanced as usual.
+//
+// Errors from the system are thrown as std::system_error. A UringShareWriter
+// is not safe for use from more than one thread at a time.
+class INFECTIOUS_EXPORT UringShareWriter {
+public:
+	// fds holds the file descriptor for each of the fec.Total() share
+	// numbers, in order; a share whose file descriptor is -1 is skipped.
+	// The file descriptors are not owned by the writer, and must stay open
+	// for its lifetime. Chunks written must come from encoders for a FEC of
+	// the same size.
+	UringShareWriter(const FEC& fec, std::span<const int> fds);
+	~UringShareWriter();
+
+	UringShareWriter(const UringShareWriter&) = delete;
+	auto operator=(const UringShareWriter&) -> UringShareWriter& = delete;
+	UringShareWriter(UringShareWriter&&) noexcept;
+	auto operator=(UringShareWriter&&) noexcept -> UringShareWriter&;
+
+	// RegisterBuffers registers the encoder's buffers (see
+	// StreamEncoder::Buffers) with the kernel, in place of any registered
+	// before. The encoder must outlive the writer, or a later call here.
+	void RegisterBuffers(const StreamEncoder& encoder);
+
+	// Write writes every piece of chunks to the file descriptor for its
+	// share, returning once they have all been written. If any write fails,
+	// the rest of the stripe is still waited for before the error is thrown.
+	void Write(Generator<ShareChunk> chunks);
+
+private:
+	struct Ring;
+
+	std::unique_ptr<Ring> ring;
+};
+
+} // namespace infectious
+
+#endif // INFECTIOUS_TARGET_OS_HAS_IO_URING
+
+#endif // INFECTIOUS_URING_HPP
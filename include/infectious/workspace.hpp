@@ -0,0 +1,118 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_WORKSPACE_HPP
+#define INFECTIOUS_WORKSPACE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "infectious/build_env.h"
+
+namespace infectious {
+
+// Workspace is a bump allocator for the scratch memory FEC operations need,
+// such as pointer tables, intermediate buffers and matrices. Every FEC
+// operation opens a Scope on the calling thread's Workspace, allocates from
+// it freely, and releases everything at once when the Scope closes.
+//
+// A Workspace holds on to up to max_retained bytes of its memory once it
+// has it, so after the first few operations on a thread have warmed it up,
+// later operations of the same or smaller size do no heap allocation at
+// all. That keeps malloc out of the steady state, where it would otherwise
+// contend between threads. Operations that need more than that at once get
+// it, but what is over the cap is given back once they are done, since for
+// those the cost of malloc hardly matters next to the work done with the
+// memory. Release gives back the rest, for threads that are done with FEC
+// work for a while.
+//
+// Workspace is a std::pmr::memory_resource, so the standard pmr containers
+// can be used with it. Deallocating does nothing; memory is only reclaimed
+// when the innermost open Scope closes, even if it was allocated by a
+// container created outside of it. Nothing allocated from a Workspace may be
+// used after that.
+class INFECTIOUS_EXPORT Workspace : public std::pmr::memory_resource {
+public:
+	Workspace() = default;
+	Workspace(const Workspace&) = delete;
+	Workspace(Workspace&&) = delete;
+	auto operator=(const Workspace&) -> Workspace& = delete;
+	auto operator=(Workspace&&) -> Workspace& = delete;
+	~Workspace() override = default;
+
+	// max_retained is the most memory a Workspace holds on to between
+	// operations. Every thread that does FEC work has a Workspace, so this
+	// is per thread.
+	static constexpr size_t max_retained = 16UL * 1024UL * 1024UL;
+
+	// ForThisThread returns the calling thread's Workspace.
+	static auto ForThisThread() -> Workspace&;
+
+	// Scope marks the current high water mark of a Workspace, and on closing
+	// releases everything allocated from it since. Scopes nest, and must be
+	// closed in the reverse order they were opened.
+	class INFECTIOUS_EXPORT Scope {
+	public:
+		explicit Scope(Workspace& ws_);
+		Scope(const Scope&) = delete;
+		Scope(Scope&&) = delete;
+		auto operator=(const Scope&) -> Scope& = delete;
+		auto operator=(Scope&&) -> Scope& = delete;
+		~Scope();
+
+	private:
+		Workspace& ws;
+		size_t chunk;
+		size_t offset;
+		size_t large;
+	};
+
+	// Allocate returns room for count Ts, which are left uninitialized. It is
+	// a cheaper way than a std::pmr::vector to get a plain buffer.
+	template <typename T>
+	[[nodiscard]] auto Allocate(size_t count) -> std::span<T> {
+		static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>);
+		auto* p = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+		std::uninitialized_default_construct_n(p, count);
+		return std::span<T>(p, count);
+	}
+
+	// Capacity returns the number of bytes this Workspace is holding on to.
+	[[nodiscard]] auto Capacity() const -> size_t;
+
+	// Release gives back all the memory this Workspace is holding on to. It
+	// throws std::logic_error if a Scope is open on it.
+	void Release();
+
+private:
+	auto do_allocate(size_t bytes, size_t alignment) -> void* override;
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+	[[nodiscard]] auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override;
+
+	struct Chunk {
+		std::unique_ptr<std::byte[]> data; // NOLINT(cppcoreguidelines-avoid-c-arrays,modernize-avoid-c-arrays)
+		size_t size;
+	};
+
+	// trim is called once everything has been released, to bring what is
+	// held on to down to max_retained.
+	void trim();
+
+	// chunks[current] is being allocated from, at offset. Chunks after it
+	// are free for reuse.
+	std::vector<Chunk> chunks;
+	// allocations of more than max_retained get a chunk each, which is
+	// freed as soon as the Scope it was allocated in closes.
+	std::vector<Chunk> large_chunks;
+	size_t current {0};
+	size_t offset {0};
+	size_t depth {0};
+};
+
+} // namespace infectious
+
+#endif // INFECTIOUS_WORKSPACE_HPP
@@ -32,9 +32,16 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+
 #include "infectious/fec.hpp"
 #include "tables.hpp"
 #include "cpuid.hpp"
+#include "addmul.hpp"
 
 namespace infectious {
 
@@ -42,45 +49,11 @@ namespace infectious {
 // in context.
 // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
 
-//
-// addmul() computes z[] = z[] + x[] * y
-//
-void FEC::addmul(
-	uint8_t* z_begin, const uint8_t* z_end,
-	const uint8_t* x, uint8_t y
-) {
-	if (y == 0) {
-		return;
-	}
+namespace internal {
 
-	long size = z_end - z_begin;
-	auto* z = z_begin;
+auto addmul_scalar(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
 	const auto& gf_mul_y = gf_mul_table[y];
-
-	// first align z to 16 bytes
-	while (size > 0 && (reinterpret_cast<uintptr_t>(z) % 16) != 0) {
-		z[0] ^= gf_mul_y[x[0]];
-		++z;
-		++x;
-		size--;
-	}
-
-#if defined(INFECTIOUS_HAS_VPERM)
-	if (size >= 16 && CPUID::has_vperm()) {
-		const size_t consumed = addmul_vperm(z, x, y, static_cast<int>(size));
-		z += consumed;
-		x += consumed;
-		size -= static_cast<long>(consumed);
-	}
-#endif
-#if defined(INFECTIOUS_HAS_SSE2)
-	if (size >= 64 && CPUID::has_sse2()) {
-		const size_t consumed = addmul_sse2(z, x, y, static_cast<int>(size));
-		z += consumed;
-		x += consumed;
-		size -= consumed;
-	}
-#endif
+	const size_t orig_size = size;
 
 	while (size >= 16) {
 		z[0] ^= gf_mul_y[x[0]];
@@ -106,29 +79,273 @@ void FEC::addmul(
 	}
 
 	// Clean up the trailing pieces
-	for (long i = 0; i < size; ++i) {
+	for (size_t i = 0; i < size; ++i) {
 		z[i] ^= gf_mul_y[x[i]];
 	}
+
+	return orig_size;
 }
 
-auto addmul_provider() -> std::string {
+auto addmul_dot_scalar(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	std::fill_n(z + offset, size, uint8_t {0});
+	for (size_t c = 0; c < count; ++c) {
+		addmul_scalar(z + offset, xs[c] + offset, ys[c], size);
+	}
+	return size;
+}
+
+namespace {
+
+// chain runs each kernel in turn on whatever the previous ones left over,
+// so that a wide kernel can hand its tail to a narrower one. Every kernel
+// returns 0 when given less than its own width.
+template <addmul_kernel... Kernels>
+auto chain(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+	size_t done = 0;
+	((done += Kernels(z + done, x + done, y, size - done)), ...);
+	return done;
+}
+
+// dot_with builds a dot product kernel out of an addmul kernel, for the
+// providers that have no register-accumulating version.
+template <addmul_kernel Kernel>
+auto dot_with(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	std::fill_n(z + offset, size, uint8_t {0});
+	for (size_t c = 0; c < count; ++c) {
+		if (ys[c] == 0) {
+			continue;
+		}
+		const size_t consumed = Kernel(z + offset, xs[c] + offset, ys[c], size);
+		if (consumed != size) {
+			addmul_scalar(z + offset + consumed, xs[c] + offset + consumed, ys[c], size - consumed);
+		}
+	}
+	return size;
+}
+
+// dot_chain runs a register-accumulating dot kernel over as much as it can
+// take and finishes the tail with an addmul kernel.
+template <addmul_dot_kernel Dot, addmul_kernel Kernel>
+auto dot_chain(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	const size_t done = Dot(z, xs, ys, count, offset, size);
+	if (done == size) {
+		return done;
+	}
+	return done + dot_with<Kernel>(z, xs, ys, count, offset + done, size - done);
+}
+
+auto always() -> bool {
+	return true;
+}
+
+// Each provider's check covers every kernel it can run, tails included, so
+// that a feature masked off with INFECTIOUS_CPUID_DISABLE is never used.
+const AddmulProvider providers[] = {
+#if defined(INFECTIOUS_HAS_GFNI)
+	{"gfni-avx512", [] { return CPUID::has_gfni() && CPUID::has_avx512bw() && CPUID::has_avx2(); }, chain<addmul_gfni_avx512, addmul_gfni>,
+		dot_chain<addmul_dot_gfni_avx512, chain<addmul_gfni_avx2, addmul_gfni>>},
+#endif
+#if defined(INFECTIOUS_HAS_AVX512BW)
+	{"avx512bw", [] { return CPUID::has_avx512bw() && CPUID::has_avx2() && CPUID::has_vperm(); }, chain<addmul_avx512bw, addmul_avx2, addmul_vperm>,
+		dot_chain<addmul_dot_avx512bw, chain<addmul_avx2, addmul_vperm>>},
+#endif
+#if defined(INFECTIOUS_HAS_GFNI)
+	{"gfni-avx2", [] { return CPUID::has_gfni() && CPUID::has_avx2(); }, chain<addmul_gfni_avx2, addmul_gfni>,
+		dot_chain<addmul_dot_gfni_avx2, addmul_gfni>},
+#endif
+#if defined(INFECTIOUS_HAS_AVX2)
+	{"avx2", [] { return CPUID::has_avx2() && CPUID::has_vperm(); }, chain<addmul_avx2, addmul_vperm>,
+		dot_chain<addmul_dot_avx2, addmul_vperm>},
+#endif
+#if defined(INFECTIOUS_HAS_GFNI)
+	{"gfni", CPUID::has_gfni, addmul_gfni, dot_with<addmul_gfni>},
+#endif
 #if defined(INFECTIOUS_HAS_VPERM)
-	if (CPUID::has_vperm()) {
 #if defined(INFECTIOUS_TARGET_CPU_IS_X86_FAMILY)
-		return "ssse3";
+	{"ssse3", CPUID::has_vperm, addmul_vperm, dot_chain<addmul_dot_vperm, addmul_vperm>},
 #elif defined(INFECTIOUS_TARGET_CPU_IS_ARM_FAMILY)
-		return "neon";
+	{"neon", CPUID::has_vperm, addmul_vperm, dot_chain<addmul_dot_vperm, addmul_vperm>},
 #else
-		return "vperm/unknown";
+	{"vperm/unknown", CPUID::has_vperm, addmul_vperm, dot_chain<addmul_dot_vperm, addmul_vperm>},
 #endif
-	}
 #endif
 #if defined(INFECTIOUS_HAS_SSE2)
-	if (CPUID::has_sse2()) {
-		return "sse2";
-	}
+	{"sse2", CPUID::has_sse2, addmul_sse2, dot_with<addmul_sse2>},
 #endif
-	return "none";
+	{"none", always, addmul_scalar, addmul_dot_scalar},
+	// only chosen by name: on CPUs with L1 caches big enough for the whole
+	// of gf_mul_table it is slower than "none".
+	{"nibble", always, addmul_nibble, dot_chain<addmul_dot_nibble, addmul_nibble>},
+	// only chosen by name: where there is a vector shuffle for the table
+	// lookups, the providers using it are faster.
+	{"xor", always, addmul_xor, addmul_dot_xor, mul_matrix_xor},
+};
+
+auto best_provider() -> const AddmulProvider* {
+	// this never gets past "none", which is always supported.
+	for (const auto& provider : providers) {
+		if (provider.supported()) {
+			return &provider;
+		}
+	}
+	return &providers[std::size(providers) - 1];
+}
+
+// default_provider is the provider named by INFECTIOUS_ADDMUL_PROVIDER, if
+// that is set to one that is supported, and otherwise the best one.
+auto default_provider() -> const AddmulProvider* {
+	// NOLINTNEXTLINE(concurrency-mt-unsafe)
+	if (const char* pinned = std::getenv("INFECTIOUS_ADDMUL_PROVIDER")) {
+		for (const auto& provider : providers) {
+			if (std::string_view(pinned) == provider.name && provider.supported()) {
+				return &provider;
+			}
+		}
+	}
+	return best_provider();
+}
+
+auto resolve_and_run(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto resolve_and_run_dot(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t;
+
+// The active provider and its kernel are resolved on first use, in the
+// manner of an ifunc: the kernel pointer starts out pointing at a resolver
+// which replaces it with the default kernel. Both are constant initialized,
+// so addmul may safely be called during static initialization of other
+// translation units.
+//
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+std::atomic<addmul_kernel> active_kernel {resolve_and_run};
+std::atomic<addmul_dot_kernel> active_dot {resolve_and_run_dot};
+std::atomic<mul_matrix_kernel> active_matrix {nullptr};
+std::atomic<const AddmulProvider*> active_provider {nullptr};
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+void activate(const AddmulProvider* provider) {
+	active_provider.store(provider, std::memory_order_relaxed);
+	active_kernel.store(provider->kernel, std::memory_order_relaxed);
+	active_dot.store(provider->dot, std::memory_order_relaxed);
+	active_matrix.store(provider->matrix, std::memory_order_relaxed);
+}
+
+auto current_provider() -> const AddmulProvider* {
+	const auto* provider = active_provider.load(std::memory_order_relaxed);
+	if (provider == nullptr) {
+		provider = default_provider();
+		activate(provider);
+	}
+	return provider;
+}
+
+// resolve the provider, and with it probe the CPU, as the library is loaded.
+// That is still single threaded, which the probes need on some systems, and
+// keeps their cost out of whichever call happens to come first.
+[[maybe_unused]] const AddmulProvider* const load_time_provider = current_provider();
+
+auto resolve_and_run(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+	return current_provider()->kernel(z, x, y, size);
+}
+
+auto resolve_and_run_dot(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	return current_provider()->dot(z, xs, ys, count, offset, size);
+}
+
+// The column tile for mul_matrix is sized so that one tile of every input
+// and every output fits in a typical L2 cache together, while staying big
+// enough to amortize the per-tile coefficient setup.
+constexpr size_t tile_budget = 256 * 1024;
+constexpr size_t tile_min = 4 * 1024;
+constexpr size_t tile_max = 64 * 1024;
+constexpr size_t tile_align = 64;
+
+auto tile_size(size_t rows, size_t cols) -> size_t {
+	const size_t tile = std::clamp(tile_budget / (rows + cols), tile_min, tile_max);
+	return tile - tile % tile_align;
+}
+
+} // namespace
+
+auto addmul_provider_table() -> std::span<const AddmulProvider> {
+	return providers;
+}
+
+} // namespace internal
+
+//
+// addmul() computes z[] = z[] + x[] * y
+//
+void FEC::addmul(
+	uint8_t* z_begin, const uint8_t* z_end,
+	const uint8_t* x, uint8_t y
+) {
+	if (y == 0) {
+		return;
+	}
+
+	const auto size = static_cast<size_t>(z_end - z_begin);
+	const size_t consumed = internal::active_kernel.load(std::memory_order_relaxed)(z_begin, x, y, size);
+	if (consumed != size) {
+		internal::addmul_scalar(z_begin + consumed, x + consumed, y, size - consumed);
+	}
+}
+
+void FEC::mul_matrix(
+	const uint8_t* matrix, size_t rows, size_t cols,
+	const uint8_t* const* inputs, uint8_t* const* outputs,
+	size_t size
+) {
+	const auto dot = internal::active_dot.load(std::memory_order_relaxed);
+	const size_t tile = internal::tile_size(rows, cols);
+
+	size_t start = 0;
+	if (const auto whole = internal::active_matrix.load(std::memory_order_relaxed)) {
+		start = whole(matrix, rows, cols, inputs, outputs, size);
+	}
+
+	for (size_t offset = start; offset < size; offset += tile) {
+		const size_t len = std::min(tile, size - offset);
+
+		for (size_t row = 0; row < rows; ++row) {
+			const uint8_t* coefs = matrix + row*cols;
+			const size_t done = dot(outputs[row], inputs, coefs, cols, offset, len);
+			if (done != len) {
+				internal::addmul_dot_scalar(outputs[row], inputs, coefs, cols, offset + done, len - done);
+			}
+		}
+	}
+}
+
+auto addmul_provider() -> std::string {
+	return internal::current_provider()->name;
+}
+
+auto addmul_providers() -> std::vector<std::string> {
+	std::vector<std::string> names;
+	for (const auto& provider : internal::addmul_provider_table()) {
+		if (provider.supported()) {
+			names.emplace_back(provider.name);
+		}
+	}
+	return names;
+}
+
+void set_addmul_provider(const std::string& name) {
+	if (name.empty() || name == "auto") {
+		internal::activate(internal::default_provider());
+		return;
+	}
+
+	for (const auto& provider : internal::addmul_provider_table()) {
+		if (name == provider.name) {
+			if (!provider.supported()) {
+				throw std::invalid_argument("addmul provider not supported on this cpu: "s + name);
+			}
+			internal::activate(&provider);
+			return;
+		}
+	}
+
+	throw std::invalid_argument("unknown addmul provider: "s + name);
 }
 
 // NOLINTEND(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
@@ -0,0 +1,104 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+//
+// Declarations for the hardware-specific addmul kernels and the dispatch
+// table that chooses between them.
+
+#ifndef INFECTIOUS_ADDMUL_HPP
+#define INFECTIOUS_ADDMUL_HPP
+
+#include <cinttypes>
+#include <cstddef>
+#include <span>
+
+#include "infectious/build_env.h"
+
+namespace infectious::internal {
+
+// An addmul kernel computes z[i] ^= x[i] * y for as much of the input as it
+// can handle efficiently, and returns the number of bytes it consumed. Any
+// remaining tail is finished with the portable table lookup loop. Kernels
+// must accept unaligned z and x.
+using addmul_kernel = auto (*)(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+
+// A dot product kernel overwrites z[offset+i] with the sum over c < count
+// of xs[c][offset+i] * ys[c], keeping the running sum in registers so that
+// z is written only once for every dot_group inputs. Like addmul kernels it
+// returns the number of bytes (starting at offset) it handled, and the
+// caller finishes the tail.
+using addmul_dot_kernel = auto (*)(
+	uint8_t* z, const uint8_t* const* xs, const uint8_t* ys,
+	size_t count, size_t offset, size_t size) -> size_t;
+
+// The number of inputs a vector dot product kernel sets up the tables for
+// at once, ahead of its loop over the blocks of the input.
+constexpr size_t dot_group = 8;
+
+// portable implementations; always consume the whole input.
+auto addmul_scalar(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto addmul_dot_scalar(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t;
+
+// portable implementations using the nibble-split tables, which are kinder
+// to the L1 cache; the addmul kernel consumes the whole input, and the dot
+// kernel whole words of it.
+auto addmul_nibble(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto addmul_dot_nibble(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t;
+
+// A matrix kernel does the whole of mul_matrix at once, for as many bytes
+// from the start as it can, and returns how many that was. Providers that
+// have no use for one leave it null.
+using mul_matrix_kernel = auto (*)(
+	const uint8_t* matrix, size_t rows, size_t cols,
+	const uint8_t* const* inputs, uint8_t* const* outputs,
+	size_t size) -> size_t;
+
+// portable implementations using only XOR, on bit planes; all of them
+// consume whole 64 byte blocks.
+auto addmul_xor(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto addmul_dot_xor(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t;
+auto mul_matrix_xor(
+	const uint8_t* matrix, size_t rows, size_t cols,
+	const uint8_t* const* inputs, uint8_t* const* outputs,
+	size_t size) -> size_t;
+
+#if defined(INFECTIOUS_HAS_VPERM)
+auto addmul_vperm(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto addmul_dot_vperm(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t;
+#endif
+#if defined(INFECTIOUS_HAS_AVX2)
+auto addmul_avx2(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto addmul_dot_avx2(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t;
+#endif
+#if defined(INFECTIOUS_HAS_AVX512BW)
+auto addmul_avx512bw(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto addmul_dot_avx512bw(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t;
+#endif
+#if defined(INFECTIOUS_HAS_GFNI)
+auto addmul_gfni(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto addmul_gfni_avx2(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto addmul_gfni_avx512(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+auto addmul_dot_gfni_avx2(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t;
+auto addmul_dot_gfni_avx512(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t;
+#endif
+#if defined(INFECTIOUS_HAS_SSE2)
+auto addmul_sse2(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t;
+#endif
+
+// AddmulProvider is one entry of the dispatch table.
+struct AddmulProvider {
+	const char* name;
+	auto (*supported)() -> bool;
+	addmul_kernel kernel;
+	addmul_dot_kernel dot;
+	mul_matrix_kernel matrix {nullptr};
+};
+
+// All providers compiled into this build, fastest first. The portable
+// "none" provider is always there, and comes after every hardware specific
+// one; only alternative portable providers, which are never chosen by
+// default, come after it.
+auto addmul_provider_table() -> std::span<const AddmulProvider>;
+
+} // namespace infectious::internal
+
+#endif // INFECTIOUS_ADDMUL_HPP
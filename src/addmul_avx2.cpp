@@ -0,0 +1,140 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+//
+// Hardware-optimized vector add-multiply for processors with AVX2.
+//
+// This is the same split-table (nibble shuffle) technique as the SSSE3
+// kernel in addmul_vperm.cpp, widened to 32-byte registers.
+
+#include "addmul.hpp"
+
+#if defined(INFECTIOUS_HAS_AVX2)
+
+#include <algorithm>
+#include <immintrin.h>
+
+#include "vperm_tables.hpp"
+
+namespace infectious::internal {
+
+// NOLINTBEGIN(portability-simd-intrinsics,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+namespace {
+
+INFECTIOUS_FUNC_ISA("avx2")
+inline auto mul_avx2(__m256i x, __m256i t_lo, __m256i t_hi, __m256i mask) -> __m256i {
+	const __m256i x_lo = _mm256_and_si256(x, mask);
+	const __m256i x_hi = _mm256_and_si256(_mm256_srli_epi64(x, 4), mask);
+	return _mm256_xor_si256(_mm256_shuffle_epi8(t_lo, x_lo), _mm256_shuffle_epi8(t_hi, x_hi));
+}
+
+} // namespace
+
+INFECTIOUS_FUNC_ISA("avx2")
+auto addmul_avx2(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+	const __m256i mask = _mm256_set1_epi8(0x0F);
+
+	// fetch the lookup tables for the given y, and duplicate them into both
+	// 128-bit lanes (vpshufb works within each lane).
+	const __m256i t_lo = _mm256_broadcastsi128_si256(
+		_mm_load_si128(reinterpret_cast<const __m128i*>(&GFTBL[32*y])));
+	const __m256i t_hi = _mm256_broadcastsi128_si256(
+		_mm_load_si128(reinterpret_cast<const __m128i*>(&GFTBL[32*y + 16])));
+
+	const size_t orig_size = size;
+
+	// unrolled out to cache line size
+	while (size >= 64) {
+		const __m256i x_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x));
+		const __m256i x_2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + 32));
+		__m256i z_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z));
+		__m256i z_2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z + 32));
+
+		z_1 = _mm256_xor_si256(z_1, mul_avx2(x_1, t_lo, t_hi, mask));
+		z_2 = _mm256_xor_si256(z_2, mul_avx2(x_2, t_lo, t_hi, mask));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z), z_1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z + 32), z_2);
+
+		x += 64;
+		z += 64;
+		size -= 64;
+	}
+
+	if (size >= 32) {
+		const __m256i x_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x));
+		__m256i z_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z));
+		z_1 = _mm256_xor_si256(z_1, mul_avx2(x_1, t_lo, t_hi, mask));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z), z_1);
+
+		x += 32;
+		z += 32;
+		size -= 32;
+	}
+
+	return orig_size - size;
+}
+
+INFECTIOUS_FUNC_ISA("avx2")
+auto addmul_dot_avx2(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	const __m256i mask = _mm256_set1_epi8(0x0F);
+	const size_t end = size - size % 32;
+
+	// the inputs go a group at a time, with the tables for the whole group
+	// broadcast once rather than for every block. Each group after the first
+	// adds to what the ones before it left in z.
+	for (size_t first = 0; first == 0 || first < count; first += dot_group) {
+		const size_t group = std::min(count - first, dot_group);
+		const uint8_t* const* group_xs = xs + first;
+
+		__m256i t_lo[dot_group];
+		__m256i t_hi[dot_group];
+		for (size_t c = 0; c < group; ++c) {
+			t_lo[c] = _mm256_broadcastsi128_si256(
+				_mm_load_si128(reinterpret_cast<const __m128i*>(&GFTBL[32*ys[first + c]])));
+			t_hi[c] = _mm256_broadcastsi128_si256(
+				_mm_load_si128(reinterpret_cast<const __m128i*>(&GFTBL[32*ys[first + c] + 16])));
+		}
+
+		size_t done = 0;
+
+		while (end - done >= 64) {
+			uint8_t* out = z + offset + done;
+			__m256i acc_1 = first == 0 ? _mm256_setzero_si256() : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out));
+			__m256i acc_2 = first == 0 ? _mm256_setzero_si256() : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + 32));
+
+			for (size_t c = 0; c < group; ++c) {
+				const uint8_t* x = group_xs[c] + offset + done;
+
+				const __m256i x_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x));
+				const __m256i x_2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + 32));
+				acc_1 = _mm256_xor_si256(acc_1, mul_avx2(x_1, t_lo[c], t_hi[c], mask));
+				acc_2 = _mm256_xor_si256(acc_2, mul_avx2(x_2, t_lo[c], t_hi[c], mask));
+			}
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), acc_1);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), acc_2);
+			done += 64;
+		}
+
+		if (end - done >= 32) {
+			uint8_t* out = z + offset + done;
+			__m256i acc_1 = first == 0 ? _mm256_setzero_si256() : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out));
+
+			for (size_t c = 0; c < group; ++c) {
+				const __m256i x_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group_xs[c] + offset + done));
+				acc_1 = _mm256_xor_si256(acc_1, mul_avx2(x_1, t_lo[c], t_hi[c], mask));
+			}
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), acc_1);
+		}
+	}
+
+	return end;
+}
+
+// NOLINTEND(portability-simd-intrinsics,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+} // namespace infectious::internal
+
+#endif // defined(INFECTIOUS_HAS_AVX2)
@@ -0,0 +1,147 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+//
+// Hardware-optimized vector add-multiply for processors with AVX-512BW.
+//
+// This is the same split-table (nibble shuffle) technique as the SSSE3
+// kernel in addmul_vperm.cpp, widened to 64-byte registers.
+
+#include "addmul.hpp"
+
+#if defined(INFECTIOUS_HAS_AVX512BW)
+
+// GCC 12 warns about the deliberately undefined vectors that some of the
+// AVX-512 intrinsics start from, once they are inlined with optimization on.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <algorithm>
+
+#include "vperm_tables.hpp"
+
+namespace infectious::internal {
+
+// NOLINTBEGIN(portability-simd-intrinsics,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+namespace {
+
+INFECTIOUS_FUNC_ISA("avx512f,avx512bw")
+inline auto mul_avx512(__m512i x, __m512i t_lo, __m512i t_hi, __m512i mask) -> __m512i {
+	const __m512i x_lo = _mm512_and_si512(x, mask);
+	const __m512i x_hi = _mm512_and_si512(_mm512_srli_epi64(x, 4), mask);
+	return _mm512_xor_si512(_mm512_shuffle_epi8(t_lo, x_lo), _mm512_shuffle_epi8(t_hi, x_hi));
+}
+
+} // namespace
+
+INFECTIOUS_FUNC_ISA("avx512f,avx512bw")
+auto addmul_avx512bw(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+	const __m512i mask = _mm512_set1_epi8(0x0F);
+
+	// fetch the lookup tables for the given y, and duplicate them into all
+	// four 128-bit lanes (vpshufb works within each lane).
+	const __m512i t_lo = _mm512_broadcast_i32x4(
+		_mm_load_si128(reinterpret_cast<const __m128i*>(&GFTBL[32*y])));
+	const __m512i t_hi = _mm512_broadcast_i32x4(
+		_mm_load_si128(reinterpret_cast<const __m128i*>(&GFTBL[32*y + 16])));
+
+	const size_t orig_size = size;
+
+	// two cache lines per iteration
+	while (size >= 128) {
+		const __m512i x_1 = _mm512_loadu_si512(x);
+		const __m512i x_2 = _mm512_loadu_si512(x + 64);
+		__m512i z_1 = _mm512_loadu_si512(z);
+		__m512i z_2 = _mm512_loadu_si512(z + 64);
+
+		z_1 = _mm512_xor_si512(z_1, mul_avx512(x_1, t_lo, t_hi, mask));
+		z_2 = _mm512_xor_si512(z_2, mul_avx512(x_2, t_lo, t_hi, mask));
+
+		_mm512_storeu_si512(z, z_1);
+		_mm512_storeu_si512(z + 64, z_2);
+
+		x += 128;
+		z += 128;
+		size -= 128;
+	}
+
+	if (size >= 64) {
+		const __m512i x_1 = _mm512_loadu_si512(x);
+		__m512i z_1 = _mm512_loadu_si512(z);
+		z_1 = _mm512_xor_si512(z_1, mul_avx512(x_1, t_lo, t_hi, mask));
+		_mm512_storeu_si512(z, z_1);
+
+		x += 64;
+		z += 64;
+		size -= 64;
+	}
+
+	return orig_size - size;
+}
+
+INFECTIOUS_FUNC_ISA("avx512f,avx512bw")
+auto addmul_dot_avx512bw(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	const __m512i mask = _mm512_set1_epi8(0x0F);
+	const size_t end = size - size % 64;
+
+	// as in addmul_dot_avx2, the tables are broadcast once per group of
+	// inputs, and every group after the first adds to z.
+	for (size_t first = 0; first == 0 || first < count; first += dot_group) {
+		const size_t group = std::min(count - first, dot_group);
+		const uint8_t* const* group_xs = xs + first;
+
+		__m512i t_lo[dot_group];
+		__m512i t_hi[dot_group];
+		for (size_t c = 0; c < group; ++c) {
+			t_lo[c] = _mm512_broadcast_i32x4(
+				_mm_load_si128(reinterpret_cast<const __m128i*>(&GFTBL[32*ys[first + c]])));
+			t_hi[c] = _mm512_broadcast_i32x4(
+				_mm_load_si128(reinterpret_cast<const __m128i*>(&GFTBL[32*ys[first + c] + 16])));
+		}
+
+		size_t done = 0;
+
+		while (end - done >= 128) {
+			uint8_t* out = z + offset + done;
+			__m512i acc_1 = first == 0 ? _mm512_setzero_si512() : _mm512_loadu_si512(out);
+			__m512i acc_2 = first == 0 ? _mm512_setzero_si512() : _mm512_loadu_si512(out + 64);
+
+			for (size_t c = 0; c < group; ++c) {
+				const uint8_t* x = group_xs[c] + offset + done;
+
+				acc_1 = _mm512_xor_si512(acc_1, mul_avx512(_mm512_loadu_si512(x), t_lo[c], t_hi[c], mask));
+				acc_2 = _mm512_xor_si512(acc_2, mul_avx512(_mm512_loadu_si512(x + 64), t_lo[c], t_hi[c], mask));
+			}
+
+			_mm512_storeu_si512(out, acc_1);
+			_mm512_storeu_si512(out + 64, acc_2);
+			done += 128;
+		}
+
+		if (end - done >= 64) {
+			uint8_t* out = z + offset + done;
+			__m512i acc_1 = first == 0 ? _mm512_setzero_si512() : _mm512_loadu_si512(out);
+
+			for (size_t c = 0; c < group; ++c) {
+				acc_1 = _mm512_xor_si512(acc_1, mul_avx512(_mm512_loadu_si512(group_xs[c] + offset + done), t_lo[c], t_hi[c], mask));
+			}
+
+			_mm512_storeu_si512(out, acc_1);
+		}
+	}
+
+	return end;
+}
+
+// NOLINTEND(portability-simd-intrinsics,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+} // namespace infectious::internal
+
+#endif // defined(INFECTIOUS_HAS_AVX512BW)
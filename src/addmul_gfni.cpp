@@ -0,0 +1,273 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+//
+// Hardware-optimized vector add-multiply for processors with the Galois
+// Field New Instructions (GFNI).
+//
+// GF2P8MULB multiplies modulo the AES polynomial (0x11B), which is not the
+// polynomial this library uses (0x11D), so it is of no use to us. Instead we
+// rely on the fact that multiplication by a constant y is a linear map over
+// GF(2)^8 for any polynomial, and express it as an 8x8 bit matrix for
+// GF2P8AFFINEQB. That multiplies every byte of a vector by y in a single
+// instruction, with no nibble splitting or table lookups in the loop.
+
+#include "addmul.hpp"
+
+#if defined(INFECTIOUS_HAS_GFNI)
+
+#include <algorithm>
+#include <array>
+#include <immintrin.h>
+
+#include "infectious/constexpr_gf.hpp"
+
+namespace infectious::internal {
+
+// NOLINTBEGIN(portability-simd-intrinsics,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+namespace {
+
+// Builds the GF2P8AFFINEQB operand for multiplication by y.
+//
+// For each input byte x, GF2P8AFFINEQB sets bit i of the result to the
+// parity of (A.byte[7-i] & x). Bit j of x contributes y*(2^j) to the
+// product, so bit j of row i must be bit i of y*(1<<j).
+constexpr auto gfni_matrix(uint8_t y) -> uint64_t {
+	uint64_t matrix = 0;
+	for (int j = 0; j < 8; j++) {
+		const uint8_t column = constexpr_gf::mul(y, static_cast<uint8_t>(1U << j));
+		for (int i = 0; i < 8; i++) {
+			if (((column >> i) & 1U) != 0) {
+				matrix |= 1ULL << (8*(7-i) + j);
+			}
+		}
+	}
+	return matrix;
+}
+
+constexpr auto make_gfni_matrices() -> std::array<uint64_t, 256> {
+	std::array<uint64_t, 256> matrices {};
+	for (int y = 0; y < 256; y++) {
+		matrices[y] = gfni_matrix(static_cast<uint8_t>(y));
+	}
+	return matrices;
+}
+
+// built at compile time, so the kernels are ready for use during the static
+// initialization of other translation units, as addmul promises.
+constexpr auto gfni_matrices = make_gfni_matrices();
+static_assert(gfni_matrices[1] == 0x0102040810204080ULL, "multiplying by one is the identity matrix");
+
+} // namespace
+
+INFECTIOUS_FUNC_ISA("sse2,gfni")
+auto addmul_gfni(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+	const __m128i matrix = _mm_set1_epi64x(static_cast<long long>(gfni_matrices[y]));
+
+	const size_t orig_size = size;
+
+	// unrolled out to cache line size
+	while (size >= 64) {
+		const __m128i x_1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x));
+		const __m128i x_2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + 16));
+		const __m128i x_3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + 32));
+		const __m128i x_4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + 48));
+		__m128i z_1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(z));
+		__m128i z_2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(z + 16));
+		__m128i z_3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(z + 32));
+		__m128i z_4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(z + 48));
+
+		z_1 = _mm_xor_si128(z_1, _mm_gf2p8affine_epi64_epi8(x_1, matrix, 0));
+		z_2 = _mm_xor_si128(z_2, _mm_gf2p8affine_epi64_epi8(x_2, matrix, 0));
+		z_3 = _mm_xor_si128(z_3, _mm_gf2p8affine_epi64_epi8(x_3, matrix, 0));
+		z_4 = _mm_xor_si128(z_4, _mm_gf2p8affine_epi64_epi8(x_4, matrix, 0));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(z), z_1);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(z + 16), z_2);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(z + 32), z_3);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(z + 48), z_4);
+
+		x += 64;
+		z += 64;
+		size -= 64;
+	}
+
+	while (size >= 16) {
+		const __m128i x_1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x));
+		__m128i z_1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(z));
+		z_1 = _mm_xor_si128(z_1, _mm_gf2p8affine_epi64_epi8(x_1, matrix, 0));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(z), z_1);
+
+		x += 16;
+		z += 16;
+		size -= 16;
+	}
+
+	return orig_size - size;
+}
+
+INFECTIOUS_FUNC_ISA("avx2,gfni")
+auto addmul_gfni_avx2(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+	const __m256i matrix = _mm256_set1_epi64x(static_cast<long long>(gfni_matrices[y]));
+
+	const size_t orig_size = size;
+
+	while (size >= 64) {
+		const __m256i x_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x));
+		const __m256i x_2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + 32));
+		__m256i z_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z));
+		__m256i z_2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z + 32));
+
+		z_1 = _mm256_xor_si256(z_1, _mm256_gf2p8affine_epi64_epi8(x_1, matrix, 0));
+		z_2 = _mm256_xor_si256(z_2, _mm256_gf2p8affine_epi64_epi8(x_2, matrix, 0));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z), z_1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z + 32), z_2);
+
+		x += 64;
+		z += 64;
+		size -= 64;
+	}
+
+	if (size >= 32) {
+		const __m256i x_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x));
+		__m256i z_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(z));
+		z_1 = _mm256_xor_si256(z_1, _mm256_gf2p8affine_epi64_epi8(x_1, matrix, 0));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(z), z_1);
+
+		x += 32;
+		z += 32;
+		size -= 32;
+	}
+
+	return orig_size - size;
+}
+
+INFECTIOUS_FUNC_ISA("avx512f,avx512bw,gfni")
+auto addmul_gfni_avx512(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+	const __m512i matrix = _mm512_set1_epi64(static_cast<long long>(gfni_matrices[y]));
+
+	const size_t orig_size = size;
+
+	// two cache lines per iteration
+	while (size >= 128) {
+		const __m512i x_1 = _mm512_loadu_si512(x);
+		const __m512i x_2 = _mm512_loadu_si512(x + 64);
+		__m512i z_1 = _mm512_loadu_si512(z);
+		__m512i z_2 = _mm512_loadu_si512(z + 64);
+
+		z_1 = _mm512_xor_si512(z_1, _mm512_gf2p8affine_epi64_epi8(x_1, matrix, 0));
+		z_2 = _mm512_xor_si512(z_2, _mm512_gf2p8affine_epi64_epi8(x_2, matrix, 0));
+
+		_mm512_storeu_si512(z, z_1);
+		_mm512_storeu_si512(z + 64, z_2);
+
+		x += 128;
+		z += 128;
+		size -= 128;
+	}
+
+	if (size >= 64) {
+		const __m512i x_1 = _mm512_loadu_si512(x);
+		__m512i z_1 = _mm512_loadu_si512(z);
+		z_1 = _mm512_xor_si512(z_1, _mm512_gf2p8affine_epi64_epi8(x_1, matrix, 0));
+		_mm512_storeu_si512(z, z_1);
+
+		x += 64;
+		z += 64;
+		size -= 64;
+	}
+
+	return orig_size - size;
+}
+
+INFECTIOUS_FUNC_ISA("avx2,gfni")
+auto addmul_dot_gfni_avx2(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	const size_t end = size - size % 64;
+
+	// the inputs go a group at a time, with the matrices for the whole group
+	// broadcast once rather than for every block. Each group after the first
+	// adds to what the ones before it left in z.
+	for (size_t first = 0; first == 0 || first < count; first += dot_group) {
+		const size_t group = std::min(count - first, dot_group);
+		const uint8_t* const* group_xs = xs + first;
+
+		__m256i matrices[dot_group];
+		for (size_t c = 0; c < group; ++c) {
+			matrices[c] = _mm256_set1_epi64x(static_cast<long long>(gfni_matrices[ys[first + c]]));
+		}
+
+		for (size_t done = 0; done < end; done += 64) {
+			uint8_t* out = z + offset + done;
+			__m256i acc_1 = first == 0 ? _mm256_setzero_si256() : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out));
+			__m256i acc_2 = first == 0 ? _mm256_setzero_si256() : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + 32));
+
+			for (size_t c = 0; c < group; ++c) {
+				const uint8_t* x = group_xs[c] + offset + done;
+
+				const __m256i x_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x));
+				const __m256i x_2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + 32));
+				acc_1 = _mm256_xor_si256(acc_1, _mm256_gf2p8affine_epi64_epi8(x_1, matrices[c], 0));
+				acc_2 = _mm256_xor_si256(acc_2, _mm256_gf2p8affine_epi64_epi8(x_2, matrices[c], 0));
+			}
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), acc_1);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), acc_2);
+		}
+	}
+
+	return end;
+}
+
+INFECTIOUS_FUNC_ISA("avx512f,avx512bw,gfni")
+auto addmul_dot_gfni_avx512(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	const size_t end = size - size % 64;
+
+	for (size_t first = 0; first == 0 || first < count; first += dot_group) {
+		const size_t group = std::min(count - first, dot_group);
+		const uint8_t* const* group_xs = xs + first;
+
+		__m512i matrices[dot_group];
+		for (size_t c = 0; c < group; ++c) {
+			matrices[c] = _mm512_set1_epi64(static_cast<long long>(gfni_matrices[ys[first + c]]));
+		}
+
+		size_t done = 0;
+
+		while (end - done >= 128) {
+			uint8_t* out = z + offset + done;
+			__m512i acc_1 = first == 0 ? _mm512_setzero_si512() : _mm512_loadu_si512(out);
+			__m512i acc_2 = first == 0 ? _mm512_setzero_si512() : _mm512_loadu_si512(out + 64);
+
+			for (size_t c = 0; c < group; ++c) {
+				const uint8_t* x = group_xs[c] + offset + done;
+
+				acc_1 = _mm512_xor_si512(acc_1, _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x), matrices[c], 0));
+				acc_2 = _mm512_xor_si512(acc_2, _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x + 64), matrices[c], 0));
+			}
+
+			_mm512_storeu_si512(out, acc_1);
+			_mm512_storeu_si512(out + 64, acc_2);
+			done += 128;
+		}
+
+		if (end - done >= 64) {
+			uint8_t* out = z + offset + done;
+			__m512i acc_1 = first == 0 ? _mm512_setzero_si512() : _mm512_loadu_si512(out);
+
+			for (size_t c = 0; c < group; ++c) {
+				acc_1 = _mm512_xor_si512(acc_1, _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(group_xs[c] + offset + done), matrices[c], 0));
+			}
+
+			_mm512_storeu_si512(out, acc_1);
+		}
+	}
+
+	return end;
+}
+
+// NOLINTEND(portability-simd-intrinsics,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+} // namespace infectious::internal
+
+#endif // defined(INFECTIOUS_HAS_GFNI)
@@ -0,0 +1,97 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+//
+// Vector add-multiply with no hardware acceleration, using the nibble-split
+// tables of the vector permutation kernels.
+//
+// The portable kernel in addmul.cpp looks every byte up in the 64 KiB
+// gf_mul_table, which is more than a typical L1 cache holds once more than
+// a few multipliers are in play, and so competes with the data for it.
+// Splitting each byte into its two nibbles instead needs only 32 bytes of
+// table per multiplier, 8 KiB for all of them, at the cost of a second
+// lookup per byte. Longer runs expand those into a 256 byte row of
+// products first, and the dot product handles a 64-bit word at a time, so
+// that z is only stored once per eight bytes.
+
+#include <array>
+#include <cstring>
+
+#include "addmul.hpp"
+#include "vperm_tables.hpp"
+
+namespace infectious::internal {
+
+// we go without bounds checking on accesses to the tables.
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index,cppcoreguidelines-pro-bounds-pointer-arithmetic,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+namespace {
+
+// runs of at least this many bytes are done with an expanded row.
+constexpr size_t expand_threshold = 512;
+
+// mul_word multiplies each of the eight bytes of x by the multiplier whose
+// low and high nibble tables are t_lo and t_hi.
+inline auto mul_word(const uint8_t* t_lo, const uint8_t* t_hi, uint64_t x) -> uint64_t {
+	uint64_t out = 0;
+	for (int b = 0; b < 64; b += 8) {
+		const auto v = static_cast<uint8_t>(x >> b);
+		out |= static_cast<uint64_t>(t_lo[v & 0x0F] ^ t_hi[v >> 4]) << b;
+	}
+	return out;
+}
+
+inline auto load_word(const uint8_t* p) -> uint64_t {
+	uint64_t w = 0;
+	std::memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+inline void store_word(uint8_t* p, uint64_t w) {
+	std::memcpy(p, &w, sizeof(w));
+}
+
+} // namespace
+
+auto addmul_nibble(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+	const uint8_t* t_lo = &GFTBL[32*y];
+	const uint8_t* t_hi = t_lo + 16;
+
+	// for long enough runs, expanding the nibble tables into a full row of
+	// products on the stack pays for itself, leaving one lookup per byte into
+	// 256 bytes that are certain to be in L1.
+	if (size >= expand_threshold) {
+		std::array<uint8_t, 256> row {};
+		for (size_t v = 0; v < row.size(); ++v) {
+			row[v] = t_lo[v & 0x0F] ^ t_hi[v >> 4];
+		}
+		for (size_t i = 0; i < size; ++i) {
+			z[i] ^= row[x[i]];
+		}
+		return size;
+	}
+
+	for (size_t i = 0; i < size; ++i) {
+		z[i] ^= t_lo[x[i] & 0x0F] ^ t_hi[x[i] >> 4];
+	}
+	return size;
+}
+
+auto addmul_dot_nibble(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	size_t done = 0;
+
+	while (size - done >= 8) {
+		uint64_t acc = 0;
+		for (size_t c = 0; c < count; ++c) {
+			const uint8_t* t_lo = &GFTBL[32*ys[c]];
+			acc ^= mul_word(t_lo, t_lo + 16, load_word(xs[c] + offset + done));
+		}
+		store_word(z + offset + done, acc);
+		done += 8;
+	}
+
+	return done;
+}
+
+// NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index,cppcoreguidelines-pro-bounds-pointer-arithmetic,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+} // namespace infectious::internal
@@ -9,14 +9,15 @@
 //
 // Botan is released under the Simplified BSD License (see LICENSE).
 
-#include "infectious/fec.hpp"
-#include "simd_32.hpp"
+#include "addmul.hpp"
 
 #if defined(INFECTIOUS_HAS_SSE2)
 
 #include <immintrin.h>
 
-namespace infectious {
+#include "simd_32.hpp"
+
+namespace infectious::internal {
 
 // NOLINTBEGIN(portability-simd-intrinsics)
 
@@ -33,7 +34,7 @@ inline auto high_bit_set_u8(SIMD_4x32 v) -> SIMD_4x32 {
 } // namespace
 
 INFECTIOUS_FUNC_ISA("sse2")
-auto FEC::addmul_sse2(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+auto addmul_sse2(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
 	const SIMD_4x32 polynomial = SIMD_4x32::splat_u8(0x1D);
 
 	const size_t orig_size = size;
@@ -100,7 +101,7 @@ auto FEC::addmul_sse2(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> s
 	return orig_size - size;
 }
 
-} // namespace infectious
+} // namespace infectious::internal
 
 // NOLINTEND(portability-simd-intrinsics)
 
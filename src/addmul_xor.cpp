@@ -0,0 +1,199 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+//
+// Matrix multiplication using nothing but XOR, for CPUs without a vector
+// shuffle to do table lookups with.
+//
+// Multiplying by a constant y is linear over the bits of a byte, so it can
+// be written as an 8x8 binary matrix: bit r of y*x is the XOR of the bits b
+// of x for which row r of the matrix has a one. Splitting each 64 bytes of
+// a share into eight 64-bit planes, one for each bit position, turns that
+// into an XOR of whole planes, with no lookups at all, in the manner of the
+// bitmatrix codes of Jerasure. The shares themselves keep the same layout
+// as for any other provider: the planes exist only while multiplying.
+//
+// The cost of the planes is amortized in mul_matrix_xor by splitting each
+// input once for all of the outputs. What is left is one XOR of a plane per
+// one in the binary form of the matrix, which Cauchy matrices are built to
+// keep low.
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#include "addmul.hpp"
+#include "infectious/constexpr_gf.hpp"
+
+namespace infectious::internal {
+
+// we go without bounds checking on accesses to the planes.
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index,cppcoreguidelines-pro-bounds-pointer-arithmetic,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+namespace {
+
+constexpr size_t block = 64;
+constexpr size_t planes = 8;
+constexpr uint64_t low_bits = 0x0101010101010101ULL;
+
+// the planes for a mul_matrix_xor pass are kept within this many words.
+constexpr size_t plane_budget = 4096;
+
+// bit_rows[y][r] has bit b set if bit r of y*x depends on bit b of x.
+constexpr auto make_bit_rows() -> std::array<std::array<uint8_t, planes>, 256> {
+	std::array<std::array<uint8_t, planes>, 256> rows {};
+	for (size_t y = 0; y < rows.size(); ++y) {
+		for (size_t b = 0; b < planes; ++b) {
+			const uint8_t column = constexpr_gf::mul(static_cast<uint8_t>(y), static_cast<uint8_t>(1U << b));
+			for (size_t r = 0; r < planes; ++r) {
+				rows[y][r] |= static_cast<uint8_t>(((column >> r) & 1U) << b);
+			}
+		}
+	}
+	return rows;
+}
+
+constexpr auto bit_rows = make_bit_rows();
+
+inline auto load_word(const uint8_t* p) -> uint64_t {
+	uint64_t w = 0;
+	std::memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+inline void store_word(uint8_t* p, uint64_t w) {
+	std::memcpy(p, &w, sizeof(w));
+}
+
+// to_planes splits the 64 bytes at p into planes out[0], out[stride], ...,
+// out[7*stride], where bit 8t+i of plane b is bit b of byte 8i+t.
+inline void to_planes(const uint8_t* p, uint64_t* out, size_t stride) {
+	std::array<uint64_t, planes> words {};
+	for (size_t i = 0; i < planes; ++i) {
+		words[i] = load_word(p + 8*i);
+	}
+	for (size_t b = 0; b < planes; ++b) {
+		uint64_t plane = 0;
+		for (size_t i = 0; i < planes; ++i) {
+			plane |= ((words[i] >> b) & low_bits) << i;
+		}
+		out[b*stride] = plane;
+	}
+}
+
+// from_planes is the inverse of to_planes, returning the bytes in words.
+inline auto from_planes(const uint64_t* in, size_t stride) -> std::array<uint64_t, planes> {
+	std::array<uint64_t, planes> words {};
+	for (size_t i = 0; i < planes; ++i) {
+		uint64_t w = 0;
+		for (size_t b = 0; b < planes; ++b) {
+			w |= ((in[b*stride] >> i) & low_bits) << b;
+		}
+		words[i] = w;
+	}
+	return words;
+}
+
+// mul_planes adds y times the planes x into the planes z. Each plane is
+// the first len words of stride.
+inline void mul_planes(uint64_t* z, const uint64_t* x, uint8_t y, size_t stride, size_t len) {
+	const auto& rows = bit_rows[y];
+	for (size_t r = 0; r < planes; ++r) {
+		for (unsigned mask = rows[r]; mask != 0; mask &= mask - 1) {
+			const uint64_t* src = x + static_cast<size_t>(std::countr_zero(mask))*stride;
+			uint64_t* dst = z + r*stride;
+			for (size_t w = 0; w < len; ++w) {
+				dst[w] ^= src[w];
+			}
+		}
+	}
+}
+
+} // namespace
+
+auto addmul_xor(uint8_t* z, const uint8_t* x, uint8_t y, size_t size) -> size_t {
+	size_t done = 0;
+	for (; size - done >= block; done += block) {
+		std::array<uint64_t, planes> in {};
+		std::array<uint64_t, planes> out {};
+		to_planes(x + done, in.data(), 1);
+		mul_planes(out.data(), in.data(), y, 1, 1);
+		const auto words = from_planes(out.data(), 1);
+		for (size_t i = 0; i < planes; ++i) {
+			store_word(z + done + 8*i, load_word(z + done + 8*i) ^ words[i]);
+		}
+	}
+	return done;
+}
+
+auto addmul_dot_xor(uint8_t* z, const uint8_t* const* xs, const uint8_t* ys, size_t count, size_t offset, size_t size) -> size_t {
+	size_t done = 0;
+	for (; size - done >= block; done += block) {
+		std::array<uint64_t, planes> acc {};
+		for (size_t c = 0; c < count; ++c) {
+			if (ys[c] == 0) {
+				continue;
+			}
+			std::array<uint64_t, planes> in {};
+			to_planes(xs[c] + offset + done, in.data(), 1);
+			mul_planes(acc.data(), in.data(), ys[c], 1, 1);
+		}
+		const auto words = from_planes(acc.data(), 1);
+		for (size_t i = 0; i < planes; ++i) {
+			store_word(z + offset + done + 8*i, words[i]);
+		}
+	}
+	return done;
+}
+
+auto mul_matrix_xor(
+	const uint8_t* matrix, size_t rows, size_t cols,
+	const uint8_t* const* inputs, uint8_t* const* outputs,
+	size_t size
+) -> size_t {
+	// the planes of every input for a run of blocks, followed by those of
+	// the output being worked on; each plane is width words, one per block.
+	if (planes * (cols + 1) > plane_budget) {
+		return 0;
+	}
+	std::array<uint64_t, plane_budget> buffer; // NOLINT(cppcoreguidelines-pro-type-member-init)
+	const size_t width = plane_budget / (planes * (cols + 1));
+	uint64_t* const out = buffer.data() + cols*planes*width;
+
+	size_t done = 0;
+	while (size - done >= block) {
+		const size_t blocks = std::min(width, (size - done) / block);
+
+		for (size_t c = 0; c < cols; ++c) {
+			uint64_t* in = buffer.data() + c*planes*width;
+			for (size_t w = 0; w < blocks; ++w) {
+				to_planes(inputs[c] + done + w*block, in + w, width);
+			}
+		}
+
+		for (size_t row = 0; row < rows; ++row) {
+			for (size_t r = 0; r < planes; ++r) {
+				std::fill_n(out + r*width, blocks, uint64_t {0});
+			}
+			for (size_t c = 0; c < cols; ++c) {
+				const uint8_t y = matrix[row*cols + c];
+				if (y != 0) {
+					mul_planes(out, buffer.data() + c*planes*width, y, width, blocks);
+				}
+			}
+			for (size_t w = 0; w < blocks; ++w) {
+				const auto words = from_planes(out + w, width);
+				for (size_t i = 0; i < planes; ++i) {
+					store_word(outputs[row] + done + w*block + 8*i, words[i]);
+				}
+			}
+		}
+
+		done += blocks*block;
+	}
+	return done;
+}
+
+// NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index,cppcoreguidelines-pro-bounds-pointer-arithmetic,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+} // namespace infectious::internal
@@ -1,50 +1,415 @@
 // Copyright (C) 2022 Storj Labs, Inc.
 // See LICENSE for copying information.
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory_resource>
+#include <mutex>
 #include "infectious/fec.hpp"
 #include "gf_alg.hpp"
+#include "matrix_cache.hpp"
 
 namespace infectious {
 
 namespace {
 
-const uint8_t interp_base = 2;
+// the syndrome check is done in tiles small enough to stay in L1 cache,
+// so that a clean set of shares never writes out anything share sized.
+constexpr size_t syndrome_tile = 4096;
 
-auto eval_point(int num) -> uint8_t {
-	if (num == 0) {
-		return 0;
+// correcting a run of dirty positions that share the same bad shares is done
+// over spans of at most correct_span bytes, starting with batches of
+// correct_batch_min positions.
+constexpr size_t correct_span = 1024;
+constexpr size_t correct_batch_min = 16;
+
+// the number of positions FindBadShares runs Berlekamp-Welch at.
+constexpr size_t bad_share_samples = 8;
+
+// any_nonzero is written to be easily vectorized by the compiler: it just
+// ORs together whole words and only looks at the result at the end.
+auto any_nonzero(const uint8_t* buf, size_t size) -> bool {
+	uint64_t acc = 0;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t word = 0;
+		std::memcpy(&word, buf + i, sizeof(word));
+		acc |= word;
 	}
-	return gf_pow(interp_base, num - 1);
+	for (; i < size; ++i) {
+		acc |= buf[i];
+	}
+	return acc != 0;
+}
+
+// eval_poly evaluates the polynomial with the size coefficients in poly,
+// highest power first, at x.
+auto eval_poly(const uint8_t* poly, int size, uint8_t x) -> uint8_t {
+	uint8_t out = 0;
+	for (int i = 0; i < size; i++) {
+		out = gf_add(gf_mul(out, x), poly[i]);
+	}
+	return out;
 }
 
 } // namespace
 
-void FEC::correct_(std::vector<uint8_t*>& shares_vec, std::vector<int>& shares_nums, long share_size) const {
+auto FEC::syndromeCheck(
+	std::span<const uint8_t* const> shares_vec, std::span<const int> shares_nums,
+	size_t share_size, std::pmr::vector<size_t>* dirty
+) const -> bool {
+	const auto synd_ptr = syndromeMatrix(shares_nums);
+	const auto& synd = *synd_ptr;
+	const auto rows = static_cast<size_t>(synd.get_r());
+	const auto cols = static_cast<size_t>(synd.get_c());
+
+	// the columns of the syndrome matrix are in share number order, which
+	// need not be the order the shares were given in.
+	std::array<const uint8_t*, byte_max> by_num {};
+	for (size_t i = shares_vec.size(); i-- > 0;) {
+		by_num[shares_nums[i]] = shares_vec[i];
+	}
+	std::array<const uint8_t*, byte_max> columns {};
+	size_t col = 0;
+	for (const auto* share : by_num) {
+		if (share != nullptr) {
+			columns[col++] = share;
+		}
+	}
+
+	// check_range checks [begin, end) tile by tile, stopping early once stop
+	// is set if it is not collecting dirty positions.
+	std::atomic<bool> stop {false};
+	auto check_range = [&](size_t begin, size_t end, std::pmr::vector<size_t>* range_dirty) -> bool {
+		std::array<const uint8_t*, byte_max> inputs {};
+		std::array<uint8_t, syndrome_tile> buf {};
+		std::array<uint8_t, syndrome_tile> dirty_bytes {};
+		uint8_t* const out = buf.data();
+		bool clean = true;
+
+		for (size_t offset = begin; offset < end; offset += syndrome_tile) {
+			if (range_dirty == nullptr && stop.load(std::memory_order_relaxed)) {
+				return false;
+			}
+
+			const size_t len = std::min(syndrome_tile, end - offset);
+			for (size_t j = 0; j < cols; j++) {
+				inputs[j] = columns[j] + offset;
+			}
+
+			bool tile_clean = true;
+			for (size_t i = 0; i < rows; i++) {
+				mul_matrix(synd.index_row(static_cast<long>(i)), 1, cols, inputs.data(), &out, len);
+				if (!any_nonzero(buf.data(), len)) {
+					continue;
+				}
+				if (range_dirty == nullptr) {
+					stop.store(true, std::memory_order_relaxed);
+					return false;
+				}
+				if (tile_clean) {
+					std::fill_n(dirty_bytes.begin(), len, uint8_t {0});
+					tile_clean = false;
+				}
+				for (size_t j = 0; j < len; j++) {
+					dirty_bytes[j] |= buf[j];
+				}
+			}
+
+			if (!tile_clean) {
+				clean = false;
+				for (size_t j = 0; j < len; j++) {
+					if (dirty_bytes[j] != 0) {
+						range_dirty->push_back(offset + j);
+					}
+				}
+			}
+		}
+
+		return clean;
+	};
+
+	// count_result tallies the outcome of the check on the way out.
+	auto count_result = [](bool clean) {
+		internal::count_stat(clean ? internal::Stat::SyndromeClean : internal::Stat::SyndromeDirty, 1);
+		return clean;
+	};
+
+	const size_t chunks = columnChunks(share_size);
+	if (chunks == 1) {
+		return count_result(check_range(0, share_size, dirty));
+	}
+
+	// each column range collects its own dirty positions, which are then
+	// put together in order. these are filled in on other threads, so they
+	// can't come from this thread's Workspace.
+	std::vector<std::pmr::vector<size_t>> chunk_dirty(dirty == nullptr ? 0 : chunks);
+	std::atomic<bool> clean {true};
+	parallelColumns(share_size, [&](size_t chunk, size_t begin, size_t end) {
+		if (!check_range(begin, end, dirty == nullptr ? nullptr : &chunk_dirty[chunk])) {
+			clean.store(false, std::memory_order_relaxed);
+		}
+	});
+	for (const auto& positions : chunk_dirty) {
+		dirty->insert(dirty->end(), positions.begin(), positions.end());
+	}
+	return count_result(clean.load(std::memory_order_relaxed));
+}
+
+void FEC::correct_(std::span<uint8_t* const> shares_vec, std::span<const int> shares_nums, size_t share_size, ShareFlags* changed) const {
+	auto& ws = Workspace::ForThisThread();
+
 	// fast path: check to see if there are no errors by evaluating it with
 	// the syndrome matrix.
-	auto synd = syndromeMatrix(shares_nums);
-	std::vector<uint8_t> buf(share_size);
+	std::pmr::vector<size_t> dirty(&ws);
+	if (syndromeCheck(shares_vec, shares_nums, share_size, &dirty)) {
+		return;
+	}
+	internal::count_stat(internal::Stat::BytesCorrected, dirty.size());
+
+	// run Berlekamp-Welch on the first dirty position to find out which
+	// shares are bad there, then fix as many of the following positions as we
+	// can on the assumption that the same shares are bad there too. Whatever
+	// that doesn't fix goes around again.
+	//
+	// the positions still to do are pending[first:], which is worked through
+	// in place.
+	auto correct_pending = [&](std::span<size_t> pending, ShareFlags& pending_changed) {
+		auto& local_ws = Workspace::ForThisThread();
+		const Workspace::Scope scope(local_ws);
+
+		// there can never be more rejected positions than pending ones, so
+		// with room for all of them up front it never needs to grow.
+		std::pmr::vector<size_t> rejected(&local_ws);
+		rejected.reserve(pending.size());
+		ShareFlags bad(shares_vec.size(), false, &local_ws);
+		std::array<uint8_t, byte_max> data {};
+		size_t first = 0;
+		while (first < pending.size()) {
+			const auto index = pending[first];
+			berlekampWelch(shares_vec, shares_nums, index, data.data());
 
-	for (int i = 0; i < synd.get_r(); i++) {
-		std::fill(buf.begin(), buf.end(), 0);
+			bool any_bad = false;
+			for (size_t c = 0; c < shares_vec.size(); ++c) {
+				const auto want = data[shares_nums[c]];
+				bad[c] = shares_vec[c][index] != want;
+				any_bad = any_bad || bad[c];
+				shares_vec[c][index] = want;
+			}
+			for (size_t c = 0; c < bad.size(); ++c) {
+				pending_changed[c] = pending_changed[c] || bad[c];
+			}
+
+			rejected.clear();
+			size_t done = first + 1;
+			if (any_bad) {
+				done = correctRun(shares_vec, shares_nums, bad, pending, done, rejected);
+			}
 
-		for (int j = 0; j < synd.get_c(); j++) {
-			addmul(buf.data(), buf.data() + share_size, shares_vec[j], static_cast<uint8_t>(synd.get(i, j)));
+			// the rejected positions all came from before done, so they fit
+			// back in, in order, just ahead of it.
+			first = done - rejected.size();
+			std::copy(rejected.begin(), rejected.end(), pending.begin() + static_cast<ptrdiff_t>(first));
 		}
+	};
+
+	ShareFlags all_changed(shares_vec.size(), false, &ws);
+	if (columnChunks(share_size) == 1) {
+		correct_pending(dirty, all_changed);
+	} else {
+		// every byte column is corrected independently of the others, so the
+		// dirty positions in each column range can be worked on concurrently.
+		std::mutex changed_mutex;
+		parallelColumns(share_size, [&](size_t, size_t begin, size_t end) {
+			auto first = std::lower_bound(dirty.begin(), dirty.end(), begin);
+			auto last = std::lower_bound(first, dirty.end(), end);
+			if (first == last) {
+				return;
+			}
+
+			auto& chunk_ws = Workspace::ForThisThread();
+			const Workspace::Scope scope(chunk_ws);
+			ShareFlags chunk_changed(shares_vec.size(), false, &chunk_ws);
+			correct_pending(std::span(first, last), chunk_changed);
 
-		for (int j = 0; j < static_cast<int>(buf.size()); j++) {
-			if (buf[j] == 0) {
+			const std::lock_guard lock(changed_mutex);
+			for (size_t c = 0; c < chunk_changed.size(); ++c) {
+				all_changed[c] = all_changed[c] || chunk_changed[c];
+			}
+		});
+	}
+
+	if (changed != nullptr) {
+		for (size_t c = 0; c < all_changed.size(); ++c) {
+			(*changed)[c] = (*changed)[c] || all_changed[c];
+		}
+	}
+}
+
+auto FEC::findBadShares_(std::span<uint8_t* const> shares_vec, std::span<const int> shares_nums, size_t share_size, bool* corrected) const -> std::vector<int> {
+	auto& ws = Workspace::ForThisThread();
+	std::pmr::vector<size_t> dirty(&ws);
+	if (syndromeCheck(shares_vec, shares_nums, share_size, &dirty)) {
+		return {};
+	}
+
+	// run Berlekamp-Welch at a few positions spread over the dirty ones, and
+	// take every share found bad at any of them.
+	const size_t samples = std::min(dirty.size(), bad_share_samples);
+	ShareFlags bad(shares_vec.size(), false, &ws);
+	std::array<uint8_t, byte_max> data {};
+	for (size_t i = 0; i < samples; ++i) {
+		const auto index = dirty[i * dirty.size() / samples];
+		berlekampWelch(shares_vec, shares_nums, index, data.data());
+		for (size_t c = 0; c < shares_vec.size(); ++c) {
+			bad[c] = bad[c] || shares_vec[c][index] != data[shares_nums[c]];
+		}
+	}
+
+	// if the remaining shares are consistent with each other everywhere, and
+	// there is some redundancy left among them to be sure of that, then those
+	// really were all the bad shares.
+	std::pmr::vector<const uint8_t*> rest_vec(&ws);
+	std::pmr::vector<int> rest_nums(&ws);
+	for (size_t c = 0; c < shares_vec.size(); ++c) {
+		if (!bad[c]) {
+			rest_vec.push_back(shares_vec[c]);
+			rest_nums.push_back(shares_nums[c]);
+		}
+	}
+	if (static_cast<int>(rest_vec.size()) <= k ||
+			!syndromeCheck(rest_vec, rest_nums, share_size, nullptr)) {
+		// the errors are spread around more than that; correct them all, and
+		// see which shares it took.
+		std::fill(bad.begin(), bad.end(), false);
+		correct_(shares_vec, shares_nums, share_size, &bad);
+		if (corrected != nullptr) {
+			*corrected = true;
+		}
+	}
+
+	std::vector<int> bad_nums;
+	for (size_t c = 0; c < shares_vec.size(); ++c) {
+		if (bad[c]) {
+			bad_nums.push_back(shares_nums[c]);
+		}
+	}
+	std::sort(bad_nums.begin(), bad_nums.end());
+	bad_nums.erase(std::unique(bad_nums.begin(), bad_nums.end()), bad_nums.end());
+	return bad_nums;
+}
+
+auto FEC::correctRun(
+	std::span<uint8_t* const> shares_vec, std::span<const int> shares_nums,
+	const ShareFlags& bad, std::span<const size_t> pending, size_t begin,
+	std::pmr::vector<size_t>& rejected
+) const -> size_t {
+	auto& ws = Workspace::ForThisThread();
+	const Workspace::Scope scope(ws);
+
+	// rebuild from the first k shares that are not bad, and recompute all of
+	// the others from them: the bad ones to replace, and the rest to check
+	// that the bad ones really are the only bad ones.
+	std::pmr::vector<size_t> good(&ws);
+	std::pmr::vector<size_t> targets(&ws);
+	good.reserve(shares_vec.size());
+	targets.reserve(shares_vec.size());
+	for (size_t c = 0; c < shares_vec.size(); ++c) {
+		if (!bad[c] && static_cast<int>(good.size()) < k) {
+			good.push_back(c);
+		} else {
+			targets.push_back(c);
+		}
+	}
+	if (static_cast<int>(good.size()) < k) {
+		return begin;
+	}
+
+	// the rows of the encoding matrix for the targets, times the inverse of
+	// the rows for the good shares, gives the targets in terms of the good
+	// shares directly.
+	std::array<int, byte_max> good_nums {};
+	for (int i = 0; i < k; ++i) {
+		good_nums[i] = shares_nums[good[i]];
+	}
+	auto good_matrix = ws.Allocate<uint8_t>(k*k);
+	invertShareRows(std::span(good_nums.data(), static_cast<size_t>(k)), good_matrix);
+
+	auto matrix = ws.Allocate<uint8_t>(targets.size()*k);
+	std::fill(matrix.begin(), matrix.end(), uint8_t {0});
+	for (size_t t = 0; t < targets.size(); ++t) {
+		auto* row = &matrix[t*k];
+		const auto* enc_row = &enc_matrix[shares_nums[targets[t]]*k];
+		for (int c = 0; c < k; ++c) {
+			addmul(row, row + k, &good_matrix[c*k], enc_row[c]);
+		}
+	}
+
+	std::array<const uint8_t*, byte_max> inputs {};
+	std::array<uint8_t*, byte_max> outputs {};
+	auto candidates = ws.Allocate<uint8_t>(targets.size()*correct_span);
+	for (size_t t = 0; t < targets.size(); ++t) {
+		outputs[t] = &candidates[t*correct_span];
+	}
+
+	// positions are taken in batches that grow while they keep being
+	// accepted, and span at most correct_span bytes so that the candidates
+	// for each can be computed with one matrix multiply over that span.
+	size_t batch = correct_batch_min;
+	size_t i = begin;
+	while (i < pending.size()) {
+		const size_t start = pending[i];
+		size_t end = i;
+		while (end < pending.size() && end - i < batch && pending[end] < start + correct_span) {
+			++end;
+		}
+		const size_t span = pending[end - 1] + 1 - start;
+
+		for (int c = 0; c < k; ++c) {
+			inputs[c] = shares_vec[good[c]] + start;
+		}
+		mul_matrix(matrix.data(), targets.size(), static_cast<size_t>(k), inputs.data(), outputs.data(), span);
+
+		size_t accepted = 0;
+		for (size_t q = i; q < end; ++q) {
+			const size_t index = pending[q];
+			const size_t at = index - start;
+
+			bool consistent = true;
+			for (size_t t = 0; t < targets.size() && consistent; ++t) {
+				consistent = bad[targets[t]] || outputs[t][at] == shares_vec[targets[t]][index];
+			}
+			if (!consistent) {
+				rejected.push_back(index);
 				continue;
 			}
-			auto data = berlekampWelch(shares_vec, shares_nums, j);
-			for (int k = 0; k < static_cast<int>(shares_vec.size()); ++k) {
-				shares_vec[k][j] = data[shares_nums[k]];
+
+			for (size_t t = 0; t < targets.size(); ++t) {
+				shares_vec[targets[t]][index] = outputs[t][at];
 			}
+			++accepted;
 		}
+
+		const size_t tried = end - i;
+		i = end;
+		if (accepted * 2 < tried) {
+			break;
+		}
+		batch = std::min(batch * 2, correct_span);
 	}
+
+	return i;
 }
 
 auto FEC::berlekampWelch(const std::vector<uint8_t*>& shares_vec, const std::vector<int>& shares_nums, int index) const -> std::vector<uint8_t> {
+	std::vector<uint8_t> out(n);
+	berlekampWelch(shares_vec, shares_nums, static_cast<size_t>(index), out.data());
+	return out;
+}
+
+void FEC::berlekampWelch(std::span<uint8_t* const> shares_vec, std::span<const int> shares_nums, size_t index, uint8_t* out) const {
 	auto r = static_cast<int>(shares_vec.size()); // required + redundancy size
 	auto e = (r - k) / 2;   // deg of E polynomial
 	auto q = e + k;         // def of Q polynomial
@@ -52,22 +417,29 @@ auto FEC::berlekampWelch(const std::vector<uint8_t*>& shares_vec, const std::vec
 	if (e <= 0) {
 		throw NotEnoughShares();
 	}
+	internal::count_stat(internal::Stat::BerlekampWelchRuns, 1);
 
 	auto dim = q + e;
 
+	auto& ws = Workspace::ForThisThread();
+	const Workspace::Scope scope(ws);
+
 	// build the system of equations s * u = f
-	GFMat s(dim, dim);           // constraint matrix
-	GFMat a(dim, dim);           // augmented matrix
-	std::vector<uint8_t> f(dim); // constant column vector
-	std::vector<uint8_t> u(dim); // solution vector
+	GFMat s(dim, dim, &ws);                  // constraint matrix
+	GFMat a(dim, dim, &ws);                  // augmented matrix
+	std::pmr::vector<uint8_t> f(dim, &ws);   // constant column vector
+	std::pmr::vector<uint8_t> u(dim, &ws);   // solution vector
 
 	for (int i = 0; i < dim; i++) {
-		auto x_i = eval_point(shares_nums[i]);
+		const uint8_t* x_i = &eval_powers[static_cast<size_t>(shares_nums[i] * n)];
 		auto r_i = shares_vec[i][index];
-		f[i] = gf_mul(gf_pow(x_i, e), r_i);
+		if (!share_weights.empty()) {
+			r_i = gf_mul(r_i, share_weights[shares_nums[i]]);
+		}
+		f[i] = gf_mul(x_i[e], r_i);
 
 		for (int j = 0; j < q; j++) {
-			s.set(i, j, gf_pow(x_i, j));
+			s.set(i, j, x_i[j]);
 			if (i == j) {
 				a.set(i, j, 1);
 			}
@@ -76,7 +448,7 @@ auto FEC::berlekampWelch(const std::vector<uint8_t*>& shares_vec, const std::vec
 		for (int k = 0; k < e; k++) {
 			auto j = k + q;
 
-			s.set(i, j, gf_mul(gf_pow(x_i, k), r_i));
+			s.set(i, j, gf_mul(x_i[k], r_i));
 			if (i == j) {
 				a.set(i, j, 1);
 			}
@@ -95,43 +467,51 @@ auto FEC::berlekampWelch(const std::vector<uint8_t*>& shares_vec, const std::vec
 	// reverse u for easier construction of the polynomials
 	std::reverse(u.begin(), u.end());
 
-	GFPoly q_poly(u);
-	q_poly.shift(e);
-	GFPoly e_poly(e+1);
-	e_poly[0] = 1;
-	std::copy(u.begin(), u.begin() + e, &e_poly[1]);
-
-	auto [p_poly, rem] = q_poly.div(e_poly);
-	if (!rem.is_zero()) {
+	// with the highest powers first, Q is u[e:] and E is 1 followed by
+	// u[:e]. E is monic, so P = Q / E can be found by synthetic division in
+	// place: afterward the first k coefficients are P, and the remaining e
+	// are the remainder.
+	uint8_t* const poly = u.data() + e;
+	for (int i = 0; i < k; i++) {
+		const auto coef = poly[i];
+		if (coef == 0) {
+			continue;
+		}
+		for (int j = 0; j < e; j++) {
+			poly[i + 1 + j] ^= gf_mul(coef, u[j]);
+		}
+	}
+	if (any_nonzero(poly + k, static_cast<size_t>(e))) {
 		throw TooManyErrors();
 	}
 
-	std::vector<uint8_t> out(n);
 	for (int i = 0; i < n; i++) {
-		uint8_t pt = 0;
-		if (i != 0) {
-			pt = gf_pow(interp_base, i - 1);
+		out[i] = eval_poly(poly, k, eval_powers[i*n + 1]);
+		if (!share_weights.empty()) {
+			out[i] = gf_mul(out[i], gf_inv(share_weights[i]));
 		}
-		out[i] = p_poly.eval(pt);
 	}
-
-	return out;
 }
 
-auto FEC::syndromeMatrix(const std::vector<int>& shares_nums) const -> GFMat {
+auto FEC::syndromeMatrix(std::span<const int> shares_nums) const -> std::shared_ptr<const GFMat> {
 	// get a list of keepers
-	std::vector<bool> keepers(n);
-	int shareCount = 0;
+	internal::ShareSet keepers;
 	for (auto share_num : shares_nums) {
-		if (!keepers[share_num]) {
-			keepers[share_num] = true;
-			++shareCount;
+		keepers.set(share_num);
+	}
+	const auto shareCount = static_cast<int>(keepers.count());
+
+	if (syndrome_cache) {
+		if (auto cached = syndrome_cache->get(keepers)) {
+			internal::count_stat(internal::Stat::SyndromeCacheHits, 1);
+			return cached;
 		}
 	}
 
 	// create a vandermonde matrix but skip columns where we're missing the
 	// share.
-	GFMat out(k, shareCount);
+	auto& ws = Workspace::ForThisThread();
+	GFMat out(k, shareCount, &ws);
 	for (int i = 0; i < k; i++) {
 		int skipped = 0;
 		for (int j = 0; j < n; j++) {
@@ -144,9 +524,30 @@ auto FEC::syndromeMatrix(const std::vector<int>& shares_nums) const -> GFMat {
 		}
 	}
 
-	// standardize the output and convert into parity form
+	// standardize the output and convert into parity form. a cached matrix
+	// outlives the Workspace scope it was built in, so only an uncached one
+	// can be allocated from it.
 	out.standardize();
-	return out.parity();
+	internal::count_stat(internal::Stat::MatrixInversions, 1);
+	if (syndrome_cache) {
+		return syndrome_cache->put(keepers, std::make_shared<const GFMat>(out.parity()));
+	}
+	return std::allocate_shared<GFMat>(std::pmr::polymorphic_allocator<>(&ws), out.parity(&ws));
+}
+
+void FEC::EnableSyndromeCache(size_t capacity) {
+	if (capacity == 0) {
+		syndrome_cache.reset();
+		return;
+	}
+	syndrome_cache = std::make_shared<internal::MatrixCache<GFMat>>(capacity);
+}
+
+auto FEC::SyndromeCacheStats() const -> CacheStats {
+	if (!syndrome_cache) {
+		return CacheStats {};
+	}
+	return syndrome_cache->stats();
 }
 
 } // namespace infectious
@@ -9,13 +9,62 @@
 //
 // Botan is released under the Simplified BSD License (see LICENSE).
 
+#include <atomic>
 #include <cassert>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
 
 #include "cpuid.hpp"
 
 namespace infectious {
 
+auto CPUID::feature_bit([[maybe_unused]] std::string_view name) -> uint64_t {
+#if defined(INFECTIOUS_TARGET_CPU_IS_X86_FAMILY)
+	if (name == "sse2") { return CPUID_SSE2_BIT; }
+	if (name == "ssse3") { return CPUID_SSSE3_BIT; }
+	if (name == "avx2") { return CPUID_AVX2_BIT; }
+	if (name == "avx512bw") { return CPUID_AVX512BW_BIT; }
+	if (name == "gfni") { return CPUID_GFNI_BIT; }
+#endif
+#if defined(INFECTIOUS_TARGET_CPU_IS_PPC_FAMILY)
+	if (name == "altivec") { return CPUID_ALTIVEC_BIT; }
+#endif
+#if defined(INFECTIOUS_TARGET_CPU_IS_ARM_FAMILY)
+	if (name == "neon") { return CPUID_ARM_NEON_BIT; }
+#endif
+	return 0;
+}
+
+auto CPUID::state() -> const CPUID_Data& {
+	// all three are constant initialized, so this is safe to call during
+	// static initialization, and costs no guard once the data is published.
+	static constinit std::atomic<const CPUID_Data*> published {nullptr};
+	static constinit std::once_flag detect_once;
+	static constinit std::optional<CPUID_Data> detected;
+
+	if (const auto* data = published.load(std::memory_order_acquire)) {
+		return *data;
+	}
+
+	std::call_once(detect_once, [] {
+		auto& data = detected.emplace();
+
+		if (const char* disable = std::getenv("INFECTIOUS_CPUID_DISABLE")) { // NOLINT(concurrency-mt-unsafe)
+			std::string_view names(disable);
+			while (!names.empty()) {
+				const auto comma = names.find(',');
+				data.clear_bits(feature_bit(names.substr(0, comma)));
+				names.remove_prefix(comma == std::string_view::npos ? names.size() : comma + 1);
+			}
+		}
+
+		published.store(&data, std::memory_order_release);
+	});
+	return *detected;
+}
+
 // they're not magic numbers, they're an endian check.
 // NOLINTBEGIN(readability-magic-numbers,cppcoreguidelines-avoid-magic-numbers)
 
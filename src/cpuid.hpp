@@ -13,6 +13,7 @@
 #define INFECTIOUS_CPUID_HPP
 
 #include <cinttypes>
+#include <string_view>
 
 #include "infectious/build_env.h"
 
@@ -26,7 +27,9 @@ namespace infectious {
 * This class supports:
 *
 *  - x86 features using CPUID. x86 is also the only processor with
-*    accurate cache line detection currently.
+*    accurate cache line detection currently. AVX2 and AVX-512 are only
+*    reported when the OS has enabled saving of the wider register
+*    state (checked with XGETBV).
 *
 *  - PowerPC AltiVec detection on Linux, NetBSD, OpenBSD, and macOS
 *
@@ -35,14 +38,27 @@ namespace infectious {
 *    feature information. Otherwise a relatively portable but
 *    thread-unsafe mechanism involving executing probe functions which
 *    catching SIGILL signal is used.
+*
+* Detection happens exactly once, on first use, and the result is then
+* published with a single atomic store; every later query is just an
+* acquire load. Concurrent first uses wait on a std::call_once, so the
+* probes never run on two threads at once.
+*
+* Features the CPU reports can be masked off by listing their names,
+* separated by commas, in the INFECTIOUS_CPUID_DISABLE environment
+* variable, which is read at detection time. This is for hypervisors
+* that misreport features, and for reproducing the behaviour of older
+* CPUs. The names are those of the has_ functions below, such as "avx2"
+* or "neon"; names not known on this CPU family are ignored.
 */
 class CPUID final {
 public:
 	/**
-	* Probe the CPU and see what extensions are supported
+	* Probe the CPU and see what extensions are supported, if that has
+	* not been done already
 	*/
 	static void initialize() {
-		state() = CPUID_Data();
+		static_cast<void>(state());
 	}
 
 	[[nodiscard]] static auto is_little_endian() -> bool {
@@ -70,6 +86,9 @@ public:
 		// These values have no relation to cpuid bitfields
 		CPUID_SSE2_BIT        = (1ULL << 0),
 		CPUID_SSSE3_BIT       = (1ULL << 1),
+		CPUID_AVX2_BIT        = (1ULL << 2),
+		CPUID_AVX512BW_BIT    = (1ULL << 3),
+		CPUID_GFNI_BIT        = (1ULL << 4),
 #endif
 
 #if defined(INFECTIOUS_TARGET_CPU_IS_PPC_FAMILY)
@@ -107,6 +126,23 @@ public:
 	* Check if the processor supports SSE2
 	*/
 	static auto has_sse2() -> bool { return has_cpuid_bit(CPUID_SSE2_BIT); }
+
+	/**
+	* Check if the processor and OS support AVX2
+	*/
+	static auto has_avx2() -> bool { return has_cpuid_bit(CPUID_AVX2_BIT); }
+
+	/**
+	* Check if the processor and OS support AVX-512 with the BW
+	* (byte and word) extension
+	*/
+	static auto has_avx512bw() -> bool { return has_cpuid_bit(CPUID_AVX512BW_BIT); }
+
+	/**
+	* Check if the processor supports the Galois Field New Instructions
+	* (GF2P8AFFINEQB and friends)
+	*/
+	static auto has_gfni() -> bool { return has_cpuid_bit(CPUID_GFNI_BIT); }
 #endif
 
 	/**
@@ -158,6 +194,10 @@ private:
 			return (m_processor_features & bit) == bit;
 		}
 
+		void clear_bits(uint64_t bits) {
+			m_processor_features &= ~bits;
+		}
+
 	private:
 		static auto runtime_check_endian() -> Endian_Status;
 
@@ -171,10 +211,11 @@ private:
 		Endian_Status m_endian_status {0};
 	};
 
-	static auto state() -> CPUID_Data& {
-		static CPUID::CPUID_Data g_cpuid;
-		return g_cpuid;
-	}
+	// feature_bit returns the bit of the feature named as in
+	// INFECTIOUS_CPUID_DISABLE, or 0 if there is no such feature.
+	static auto feature_bit(std::string_view name) -> uint64_t;
+
+	static auto state() -> const CPUID_Data&;
 };
 
 }
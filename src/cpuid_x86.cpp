@@ -49,6 +49,42 @@ void invoke_cpuid(uint32_t type, std::array<uint32_t, 4>& out) {
 #endif
 }
 
+void invoke_cpuid_sublevel(uint32_t type, uint32_t level, std::array<uint32_t, 4>& out) {
+#if defined(INFECTIOUS_BUILD_COMPILER_IS_MSVC) || defined(INFECTIOUS_BUILD_COMPILER_IS_INTEL)
+	__cpuidex(reinterpret_cast<int*>(out.data()), type, level);
+
+#elif defined(INFECTIOUS_BUILD_COMPILER_IS_GCC) || defined(INFECTIOUS_BUILD_COMPILER_IS_CLANG)
+	__cpuid_count(type, level, out[0], out[1], out[2], out[3]);
+
+#elif defined(INFECTIOUS_USE_GCC_INLINE_ASM)
+	asm("cpuid\n\t"
+		: "=a" (out[0]), "=b" (out[1]), "=c" (out[2]), "=d" (out[3])
+		: "0" (type), "2" (level));
+
+#else
+	#warning "No way of calling x86 cpuid instruction for this compiler"
+	clear_mem(out, 4);
+#endif
+}
+
+// Returns the XCR0 register, which tells us which register states the OS
+// saves across context switches. Only valid to call when CPUID reports
+// OSXSAVE.
+auto invoke_xgetbv() -> uint64_t {
+#if defined(INFECTIOUS_BUILD_COMPILER_IS_MSVC) || defined(INFECTIOUS_BUILD_COMPILER_IS_INTEL)
+	return _xgetbv(0);
+
+#elif defined(INFECTIOUS_USE_GCC_INLINE_ASM)
+	uint32_t lo = 0;
+	uint32_t hi = 0;
+	asm("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+	return (static_cast<uint64_t>(hi) << 32) | lo;
+
+#else
+	return 0;
+#endif
+}
+
 } // namespace
 
 auto CPUID::CPUID_Data::detect_cpu_features() -> uint64_t {
@@ -59,18 +95,64 @@ auto CPUID::CPUID_Data::detect_cpu_features() -> uint64_t {
 	invoke_cpuid(0, cpuid);
 	const uint32_t max_supported_sublevel = cpuid[0];
 
+	// XCR0 bits: SSE and AVX (YMM) state, then opmask and ZMM state
+	enum x86_XCR0_bits : uint64_t {
+		AVX_STATE    = 0x06,
+		AVX512_STATE = 0xE0,
+	};
+
+	uint64_t xcr0 = 0;
+
 	if (max_supported_sublevel >= 1) {
 		// CPUID 1: feature bits
 		invoke_cpuid(1, cpuid);
 		const uint64_t flags0 = (static_cast<uint64_t>(cpuid[2]) << 32) | cpuid[3];
 
 		enum x86_CPUID_1_bits : uint64_t {
-			SSE2  = (1ULL << 26),
-			SSSE3 = (1ULL << 41),
+			SSE2    = (1ULL << 26),
+			SSSE3   = (1ULL << 41),
+			OSXSAVE = (1ULL << 59),
 		};
 
 		if ((flags0 & x86_CPUID_1_bits::SSE2) != 0)  { features_detected |= CPUID::CPUID_SSE2_BIT; }
 		if ((flags0 & x86_CPUID_1_bits::SSSE3) != 0) { features_detected |= CPUID::CPUID_SSSE3_BIT; }
+
+		if ((flags0 & x86_CPUID_1_bits::OSXSAVE) != 0) {
+			xcr0 = invoke_xgetbv();
+		}
+	}
+
+	if (max_supported_sublevel >= 7) {
+		// CPUID 7, subleaf 0: extended feature bits
+		cpuid = {};
+		invoke_cpuid_sublevel(7, 0, cpuid);
+		const uint64_t flags7 = (static_cast<uint64_t>(cpuid[2]) << 32) | cpuid[1];
+
+		enum x86_CPUID_7_bits : uint64_t {
+			AVX2      = (1ULL << 5),
+			AVX512_F  = (1ULL << 16),
+			AVX512_BW = (1ULL << 30),
+			GFNI      = (1ULL << 40),
+		};
+
+		// the wide kernels are only usable if the OS saves the registers
+		const bool os_avx = (xcr0 & x86_XCR0_bits::AVX_STATE) == x86_XCR0_bits::AVX_STATE;
+		const bool os_avx512 = os_avx && (xcr0 & x86_XCR0_bits::AVX512_STATE) == x86_XCR0_bits::AVX512_STATE;
+
+		if (os_avx && (flags7 & x86_CPUID_7_bits::AVX2) != 0) {
+			features_detected |= CPUID::CPUID_AVX2_BIT;
+		}
+
+		const uint64_t avx512bw = x86_CPUID_7_bits::AVX512_F | x86_CPUID_7_bits::AVX512_BW;
+		if (os_avx512 && (flags7 & avx512bw) == avx512bw) {
+			features_detected |= CPUID::CPUID_AVX512BW_BIT;
+		}
+
+		// the 128-bit form only needs SSE state; the wider forms are gated
+		// on the AVX2 and AVX512BW bits above.
+		if ((flags7 & x86_CPUID_7_bits::GFNI) != 0) {
+			features_detected |= CPUID::CPUID_GFNI_BIT;
+		}
 	}
 
 	/*
@@ -0,0 +1,166 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "infectious/executor.hpp"
+
+namespace infectious {
+
+namespace {
+
+// Job is a single ParallelFor call. Indexes are claimed from next by
+// whichever threads are working on it, and the call returns once remaining
+// drops to zero.
+struct Job {
+	Job(size_t count_, const std::function<void(size_t)>& fn_)
+		: count {count_}
+		, fn {fn_}
+		, remaining {count_}
+	{}
+
+	const size_t count;
+	const std::function<void(size_t)>& fn;
+	std::atomic<size_t> next {0};
+	std::atomic<size_t> remaining;
+
+	std::mutex mutex;
+	std::condition_variable done;
+	std::exception_ptr error;
+
+	// work runs indexes of this job until there are none left to claim. It
+	// returns false if there were none to begin with.
+	auto work() -> bool {
+		bool any = false;
+		for (;;) {
+			const size_t i = next.fetch_add(1, std::memory_order_relaxed);
+			if (i >= count) {
+				return any;
+			}
+			any = true;
+
+			try {
+				fn(i);
+			} catch (...) {
+				const std::lock_guard lock(mutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+
+			if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				const std::lock_guard lock(mutex);
+				done.notify_all();
+			}
+		}
+	}
+
+	[[nodiscard]] auto exhausted() const -> bool {
+		return next.load(std::memory_order_relaxed) >= count;
+	}
+};
+
+} // namespace
+
+struct ThreadPool::State {
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::shared_ptr<Job>> jobs;
+	bool stopping = false;
+	std::vector<std::thread> workers;
+
+	void run() {
+		for (;;) {
+			std::shared_ptr<Job> job;
+			{
+				std::unique_lock lock(mutex);
+				wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (stopping) {
+					return;
+				}
+				job = jobs.front();
+				if (job->exhausted()) {
+					jobs.pop_front();
+					continue;
+				}
+			}
+			job->work();
+		}
+	}
+};
+
+ThreadPool::ThreadPool(size_t threads)
+	: state {std::make_unique<State>()}
+{
+	if (threads == 0) {
+		threads = std::max(std::thread::hardware_concurrency(), 1U) - 1;
+	}
+
+	state->workers.reserve(threads);
+	for (size_t i = 0; i < threads; ++i) {
+		state->workers.emplace_back([this] { state->run(); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		const std::lock_guard lock(state->mutex);
+		state->stopping = true;
+	}
+	state->wake.notify_all();
+	for (auto& worker : state->workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn) {
+	if (count == 0) {
+		return;
+	}
+	if (count == 1 || state->workers.empty()) {
+		for (size_t i = 0; i < count; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	auto job = std::make_shared<Job>(count, fn);
+	{
+		const std::lock_guard lock(state->mutex);
+		state->jobs.push_back(job);
+	}
+	state->wake.notify_all();
+
+	// the caller works on its own job rather than waiting for a worker to
+	// come free, which also keeps nested calls from deadlocking.
+	job->work();
+
+	{
+		std::unique_lock lock(job->mutex);
+		job->done.wait(lock, [&] { return job->remaining.load(std::memory_order_acquire) == 0; });
+	}
+
+	{
+		const std::lock_guard lock(state->mutex);
+		auto it = std::find(state->jobs.begin(), state->jobs.end(), job);
+		if (it != state->jobs.end()) {
+			state->jobs.erase(it);
+		}
+	}
+
+	if (job->error) {
+		std::rethrow_exception(job->error);
+	}
+}
+
+auto ThreadPool::Threads() const -> size_t {
+	return state->workers.size();
+}
+
+} // namespace infectious
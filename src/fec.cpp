@@ -2,14 +2,26 @@
 // See LICENSE for copying information.
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
 #include <cstring>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <string>
 #include <stdexcept>
 #include <vector>
 #include "infectious/fec.hpp"
+#include "matrix_cache.hpp"
 #include "tables.hpp"
 
 namespace infectious {
 
+static_assert(internal::constexpr_gf::mul_table_agrees(), "gf_mul_table must agree with constexpr_gf::mul");
+
 // we go without bounds checking on accesses to the gf_mul_table
 // and its friends.
 // NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
@@ -19,6 +31,11 @@ void FEC::initialize() {
 		throw std::domain_error("requires 1 <= k <= n <= 256");
 	}
 
+	if (matrix_kind == Matrix::Cauchy) {
+		initializeCauchy();
+		return;
+	}
+
 	std::vector<uint8_t> temp_matrix(n*k, 0);
 	createInvertedVdm(temp_matrix, k);
 
@@ -54,15 +71,180 @@ void FEC::initialize() {
 		}
 		g = gf_mul_table[2][g];
 	}
+
+	// share 0 is evaluated at 0, and share num at 2^(num-1).
+	for (int num = 0; num < n; num++) {
+		const uint8_t x = num == 0 ? 0 : gf_exp[num - 1];
+		uint8_t p {1};
+		for (int j = 0; j < n; j++) {
+			eval_powers[num*n + j] = p;
+			p = gf_mul_table[x][p];
+		}
+	}
+}
+
+namespace {
+
+// bit_ones returns the number of ones in the 8x8 binary matrix of
+// multiplication by y, which is the number of XORs it takes as a bitmatrix.
+auto bit_ones(uint8_t y) -> int {
+	int ones = 0;
+	for (int b = 0; b < 8; b++) {
+		ones += std::popcount(gf_mul_table[y][1U << b]);
+	}
+	return ones;
+}
+
+} // namespace
+
+// The Cauchy code evaluates at share number num itself, so that parity share
+// i and data piece j give the entry 1/(i + j) of the Cauchy matrix. That is
+// a generalized Reed-Solomon code: each share is the value of a polynomial
+// of degree below k at its point, divided by a weight that depends on the
+// share. Knowing the weights lets Berlekamp-Welch, and the closed form
+// inverse in invertShareRows, work on it as on any other Reed-Solomon code.
+//
+// With a_i the product of (i + m) over the data pieces m, and b_j that over
+// the data pieces m other than j, the unscaled matrix gives parity share i
+// the weight a_i and data piece j the weight b_j. Scaling column j by c_j
+// and row i by r_i multiplies those by c_j and 1/r_i respectively.
+void FEC::initializeCauchy() {
+	const auto point = [](int num) { return static_cast<uint8_t>(num); };
+
+	share_weights.assign(n, 1);
+	for (int num = 0; num < n; num++) {
+		uint8_t w {1};
+		for (int m = 0; m < k; m++) {
+			if (m != num) {
+				w = gf_mul_table[w][point(num) ^ point(m)];
+			}
+		}
+		share_weights[num] = w;
+	}
+
+	for (int i = 0; i < k; i++) {
+		enc_matrix[i*(k+1)] = 1;
+	}
+
+	// the columns are scaled to make the first parity share all ones, and
+	// each later row by whichever factor leaves it the fewest ones in binary.
+	std::array<int, byte_max> ones {};
+	for (int y = 0; y < byte_max; y++) {
+		ones[y] = bit_ones(static_cast<uint8_t>(y));
+	}
+	for (int row = k; row < n; row++) {
+		uint8_t* out = &enc_matrix[row*k];
+		for (int col = 0; col < k; col++) {
+			const uint8_t c = point(k) ^ point(col);
+			out[col] = gf_mul_table[c][gf_inverse[point(row) ^ point(col)]];
+		}
+
+		uint8_t best {1};
+		if (row > k) {
+			int best_ones = INT_MAX;
+			for (int r = 1; r < byte_max; r++) {
+				int total = 0;
+				for (int col = 0; col < k; col++) {
+					total += ones[gf_mul_table[r][out[col]]];
+				}
+				if (total < best_ones) {
+					best_ones = total;
+					best = static_cast<uint8_t>(r);
+				}
+			}
+			for (int col = 0; col < k; col++) {
+				out[col] = gf_mul_table[best][out[col]];
+			}
+		}
+		share_weights[row] = gf_mul_table[share_weights[row]][gf_inverse[best]];
+	}
+	for (int col = 0; col < k && k < n; col++) {
+		share_weights[col] = gf_mul_table[share_weights[col]][point(k) ^ point(col)];
+	}
+
+	// the shares' columns of the transposed encoding matrix generate the same
+	// code, which is all the syndrome check needs of vand_matrix.
+	for (int row = 0; row < k; row++) {
+		for (int col = 0; col < n; col++) {
+			vand_matrix[row*n+col] = enc_matrix[col*k+row];
+		}
+	}
+
+	for (int num = 0; num < n; num++) {
+		uint8_t p {1};
+		for (int j = 0; j < n; j++) {
+			eval_powers[num*n + j] = p;
+			p = gf_mul_table[point(num)][p];
+		}
+	}
+}
+
+// For a Cauchy matrix, data piece j is rebuilt by Lagrange interpolation
+// of the weighted shares at point j: the coefficient of share s is
+//
+//   (w_s / w_j) * prod_t (j + t) / ((j + s) * prod_{t != s} (s + t))
+//
+// with the products taken over the points of the k shares. The denominators
+// of the shares are the same for every j, so the whole inverse takes O(k^2).
+void FEC::invertShareRows(std::span<const int> nums, std::span<uint8_t> out) const {
+	if (matrix_kind != Matrix::Cauchy) {
+		for (int i = 0; i < k; i++) {
+			const auto* row = &enc_matrix[nums[i]*k];
+			std::copy(row, row + k, &out[i*k]);
+		}
+		invertMatrix(out, k);
+		return;
+	}
+
+	internal::count_stat(internal::Stat::MatrixInversions, 1);
+
+	std::array<int, byte_max> position {};
+	std::fill(position.begin(), position.end(), -1);
+	std::array<uint8_t, byte_max> share_factor {};
+	for (int s = 0; s < k; s++) {
+		const auto x_s = static_cast<uint8_t>(nums[s]);
+		uint8_t d {1};
+		for (int t = 0; t < k; t++) {
+			if (t != s) {
+				d = gf_mul_table[d][x_s ^ static_cast<uint8_t>(nums[t])];
+			}
+		}
+		if (d == 0) {
+			throw std::domain_error("singular matrix");
+		}
+		share_factor[s] = gf_mul_table[share_weights[nums[s]]][gf_inverse[d]];
+		if (nums[s] < k) {
+			position[nums[s]] = s;
+		}
+	}
+
+	for (int j = 0; j < k; j++) {
+		uint8_t* row = &out[j*k];
+		std::fill(row, row + k, uint8_t {0});
+		if (position[j] >= 0) {
+			row[position[j]] = 1;
+			continue;
+		}
+
+		const auto x_j = static_cast<uint8_t>(j);
+		uint8_t p {1};
+		for (int t = 0; t < k; t++) {
+			p = gf_mul_table[p][x_j ^ static_cast<uint8_t>(nums[t])];
+		}
+		const uint8_t base = gf_mul_table[p][gf_inverse[share_weights[j]]];
+		for (int s = 0; s < k; s++) {
+			const uint8_t x_s = static_cast<uint8_t>(nums[s]);
+			row[s] = gf_mul_table[base][gf_mul_table[share_factor[s]][gf_inverse[x_j ^ x_s]]];
+		}
+	}
 }
 
 struct pivotSearcher {
 	pivotSearcher(int k_)
 		: k {k_}
-		, ipiv(k)
 	{}
 
-	auto search(int col, const std::vector<uint8_t>& matrix) -> std::pair<int, int> {
+	auto search(int col, std::span<const uint8_t> matrix) -> std::pair<int, int> {
 		if (!ipiv[col] && matrix[col*k+col] != 0) {
 			ipiv[col] = true;
 			return std::make_pair(col, col);
@@ -86,20 +268,22 @@ struct pivotSearcher {
 
 private:
 	int k;
-	std::vector<bool> ipiv;
+	std::array<bool, FEC::byte_max> ipiv {};
 };
 
 // TODO(jeff): matrix is a K*K array, row major.
 //
 // NOLINTBEGIN(readability-function-cognitive-complexity)
-void FEC::invertMatrix(std::vector<uint8_t>& matrix, int k) {
+void FEC::invertMatrix(std::span<uint8_t> matrix, int k) {
+	internal::count_stat(internal::Stat::MatrixInversions, 1);
+
 	pivotSearcher pivot_searcher(k);
-	std::vector<int> indxc(k);
-	std::vector<int> indxr(k);
-	std::vector<uint8_t> id_row(k);
+	std::array<int, byte_max> indxc {};
+	std::array<int, byte_max> indxr {};
+	std::array<uint8_t, byte_max> id_row {};
 
 	for (int col = 0; col < k; col++) {
-		auto [icol, irow] = pivot_searcher.search(col, matrix);
+		auto [irow, icol] = pivot_searcher.search(col, matrix);
 
 		if (irow != icol) {
 			for (int i = 0; i < k; i++) {
@@ -142,7 +326,7 @@ void FEC::invertMatrix(std::vector<uint8_t>& matrix, int k) {
 		id_row[icol] = 0;
 	}
 
-	for (int i = 0; i < k; i++) {
+	for (int i = k - 1; i >= 0; i--) {
 		if (indxr[i] != indxc[i]) {
 			for (int row = 0; row < k; row++) {
 				std::swap(matrix[row*k+indxr[i]], matrix[row*k+indxc[i]]);
@@ -191,6 +375,316 @@ void FEC::createInvertedVdm(std::vector<uint8_t>& vdm, int k) {
 	}
 }
 
+auto FEC::Get(int k, int n) -> std::shared_ptr<const FEC> {
+	// the registry only ever grows, and there are at most 256*256 codes.
+	static std::shared_mutex mutex;
+	static std::map<std::pair<int, int>, std::shared_ptr<const FEC>> codes;
+
+	const auto key = std::make_pair(k, n);
+	{
+		const std::shared_lock lock(mutex);
+		if (auto it = codes.find(key); it != codes.end()) {
+			return it->second;
+		}
+	}
+
+	// building the code under the exclusive lock makes sure it is only ever
+	// built once, at the cost of making lookups of other codes wait for it.
+	const std::unique_lock lock(mutex);
+	if (auto it = codes.find(key); it != codes.end()) {
+		return it->second;
+	}
+	auto fec = std::make_shared<FEC>(k, n);
+	fec->EnableDecodeCache(registry_cache_capacity);
+	fec->EnableSyndromeCache(registry_cache_capacity);
+	return codes.try_emplace(key, std::move(fec)).first->second;
+}
+
+// column ranges handed to the executor start on cache line boundaries, so
+// that no two threads write to the same cache line of an output.
+constexpr size_t parallel_align = 64;
+
+void FEC::SetExecutor(std::shared_ptr<Executor> executor_, size_t chunk_size) {
+	executor = std::move(executor_);
+	parallel_chunk = std::max((chunk_size + parallel_align - 1) / parallel_align, size_t {1}) * parallel_align;
+}
+
+auto FEC::columnChunks(size_t size) const -> size_t {
+	if (!executor || size <= parallel_chunk) {
+		return 1;
+	}
+	return (size + parallel_chunk - 1) / parallel_chunk;
+}
+
+void FEC::parallelColumns(size_t size, const std::function<void(size_t chunk, size_t begin, size_t end)>& fn) const {
+	const size_t chunks = columnChunks(size);
+	if (chunks == 1) {
+		fn(0, 0, size);
+		return;
+	}
+
+	executor->ParallelFor(chunks, [&](size_t chunk) {
+		const size_t begin = chunk * parallel_chunk;
+		fn(chunk, begin, std::min(begin + parallel_chunk, size));
+	});
+}
+
+void FEC::mulMatrix(
+	const uint8_t* matrix, size_t rows, size_t cols,
+	const uint8_t* const* inputs, uint8_t* const* outputs,
+	size_t size
+) const {
+	if (columnChunks(size) == 1) {
+		mul_matrix(matrix, rows, cols, inputs, outputs, size);
+		return;
+	}
+
+	parallelColumns(size, [&](size_t, size_t begin, size_t end) {
+		BlockPointers chunk_inputs {};
+		std::array<uint8_t*, byte_max> chunk_outputs {};
+		for (size_t c = 0; c < cols; ++c) {
+			chunk_inputs[c] = inputs[c] + begin;
+		}
+		for (size_t r = 0; r < rows; ++r) {
+			chunk_outputs[r] = outputs[r] + begin;
+		}
+		mul_matrix(matrix, rows, cols, chunk_inputs.data(), chunk_outputs.data(), end - begin);
+	});
+}
+
+void FEC::EncodeParity(std::span<const uint8_t* const> blocks, size_t block_size, std::span<uint8_t* const> parity) const {
+	if (blocks.size() != static_cast<size_t>(k)) {
+		throw std::invalid_argument("blocks must have exactly "s + std::to_string(k) + " pointers");
+	}
+	if (parity.size() != static_cast<size_t>(n - k)) {
+		throw std::invalid_argument("parity must have exactly "s + std::to_string(n - k) + " buffers");
+	}
+
+	const internal::PhaseTimer timer(internal::Stat::EncodeNanos);
+	internal::count_stat(internal::Stat::BytesEncoded, static_cast<size_t>(k) * block_size);
+	encode_parity(blocks.data(), parity.data(), block_size);
+}
+
+void FEC::EncodeBatch(std::span<const ByteView> inputs, std::span<uint8_t* const> parity) const {
+	const auto parity_count = static_cast<size_t>(n - k);
+	if (parity.size() != inputs.size() * parity_count) {
+		throw std::invalid_argument("parity must have exactly "s + std::to_string(n - k) + " buffers per input");
+	}
+
+	const internal::PhaseTimer timer(internal::Stat::EncodeNanos);
+	BlockPointers blocks {};
+	for (size_t s = 0; s < inputs.size(); ++s) {
+		const auto& input = inputs[s];
+		if (input.size() % k != 0) {
+			throw std::invalid_argument("input length must be a multiple of k");
+		}
+
+		const size_t block_size = input.size() / k;
+		for (int i = 0; i < k; i++) {
+			blocks[i] = input.data() + i*block_size;
+		}
+		mulMatrix(&enc_matrix[k*k], parity_count, k, blocks.data(), &parity[s * parity_count], block_size);
+		internal::count_stat(internal::Stat::BytesEncoded, input.size());
+	}
+}
+
+void FEC::RebuildBatch(
+	std::span<const int> share_nums, std::span<const uint8_t* const> shares,
+	size_t share_size, std::span<uint8_t* const> outputs
+) const {
+	if (static_cast<int>(share_nums.size()) != k) {
+		throw std::invalid_argument("must specify exactly the number of required shares");
+	}
+	if (shares.size() != outputs.size() * k) {
+		throw std::invalid_argument("shares must have exactly "s + std::to_string(k) + " pointers per output");
+	}
+
+	const internal::PhaseTimer timer(internal::Stat::RebuildNanos);
+	internal::count_stat(internal::Stat::BytesRebuilt, outputs.size() * k * share_size);
+
+	// lay the shares out as RebuildSorted would: data share i at position i
+	// if we have it, and the remaining positions filled in from the highest
+	// numbered parity shares down. where[i] is where in share_nums the share
+	// at position i is.
+	std::array<int, byte_max> where {};
+	std::array<bool, byte_max> have {};
+	for (int j = 0; j < k; j++) {
+		const int num = share_nums[j];
+		if (num < 0 || num >= n) {
+			throw std::invalid_argument("invalid share id: "s + std::to_string(num));
+		}
+		if (have[num]) {
+			throw std::invalid_argument("duplicate share id: "s + std::to_string(num));
+		}
+		have[num] = true;
+		where[num] = j;
+	}
+
+	std::array<int, byte_max> indexes {};
+	std::array<int, byte_max> position {};
+	std::array<uint8_t*, byte_max> missing {};
+	size_t missing_count = 0;
+	int next_parity = n - 1;
+	for (int i = 0; i < k; i++) {
+		if (have[i]) {
+			indexes[i] = i;
+		} else {
+			while (!have[next_parity]) {
+				--next_parity;
+			}
+			indexes[i] = next_parity--;
+			++missing_count;
+		}
+		position[i] = where[indexes[i]];
+	}
+
+	// the rows of the decoding matrix for the missing data shares, packed
+	// together so that each stripe needs only one matrix multiply.
+	auto& ws = Workspace::ForThisThread();
+	const Workspace::Scope scope(ws);
+	std::pmr::vector<uint8_t> matrix(&ws);
+	if (missing_count > 0) {
+		const auto decoding_matrix = decodingMatrix(std::span(indexes.data(), static_cast<size_t>(k)));
+		matrix.reserve(missing_count * k);
+		for (int i = 0; i < k; i++) {
+			if (indexes[i] >= k) {
+				matrix.insert(matrix.end(), &(*decoding_matrix)[i*k], &(*decoding_matrix)[(i+1)*k]);
+			}
+		}
+	}
+
+	BlockPointers inputs {};
+	for (size_t s = 0; s < outputs.size(); ++s) {
+		const auto* const* stripe = &shares[s * k];
+		uint8_t* out = outputs[s];
+
+		size_t m = 0;
+		for (int i = 0; i < k; i++) {
+			inputs[i] = stripe[position[i]];
+			if (indexes[i] < k) {
+				std::copy_n(inputs[i], share_size, out + i*share_size);
+			} else {
+				missing[m++] = out + i*share_size;
+			}
+		}
+		if (missing_count > 0) {
+			mulMatrix(matrix.data(), missing_count, k, inputs.data(), missing.data(), share_size);
+		}
+	}
+}
+
+void FEC::EnableDecodeCache(size_t capacity) {
+	if (capacity == 0) {
+		decode_cache.reset();
+		return;
+	}
+	decode_cache = std::make_shared<internal::MatrixCache<std::pmr::vector<uint8_t>>>(capacity);
+}
+
+auto FEC::DecodeCacheStats() const -> CacheStats {
+	if (!decode_cache) {
+		return CacheStats {};
+	}
+	return decode_cache->stats();
+}
+
+auto FEC::decodingMatrix(std::span<const int> indexes) const -> std::shared_ptr<const std::pmr::vector<uint8_t>> {
+	// the order of indexes is fully determined by which shares are in it, so
+	// the set alone is enough to key the cache.
+	internal::ShareSet key;
+	if (decode_cache) {
+		for (auto index : indexes) {
+			key.set(index);
+		}
+		if (auto cached = decode_cache->get(key)) {
+			internal::count_stat(internal::Stat::DecodeCacheHits, 1);
+			return cached;
+		}
+	}
+
+	// a cached matrix outlives the Workspace scope it was built in, so only
+	// an uncached one can be allocated from it.
+	auto matrix = decode_cache
+		? std::make_shared<std::pmr::vector<uint8_t>>(k*k)
+		: std::allocate_shared<std::pmr::vector<uint8_t>>(std::pmr::polymorphic_allocator<>(&Workspace::ForThisThread()), k*k);
+	auto& decoding_matrix = *matrix;
+	invertShareRows(indexes, decoding_matrix);
+
+	if (decode_cache) {
+		return decode_cache->put(key, std::move(matrix));
+	}
+	return matrix;
+}
+
+void FEC::encode_parity(const uint8_t* const* inputs, uint8_t* const* parity, size_t size) const {
+	const auto rows = static_cast<size_t>(n - k);
+	const auto cols = static_cast<size_t>(k);
+
+	// each run of consecutive requested parity shares is computed together.
+	size_t row = 0;
+	while (row < rows) {
+		if (parity[row] == nullptr) {
+			++row;
+			continue;
+		}
+
+		size_t end = row + 1;
+		while (end < rows && parity[end] != nullptr) {
+			++end;
+		}
+
+		mulMatrix(&enc_matrix[(cols + row) * cols], end - row, cols, inputs, &parity[row], size);
+		row = end;
+	}
+}
+
+void FEC::encode_segments(const uint8_t* const* inputs, std::span<const ShareSegments> outputs, size_t block_size) const {
+	// per share, the current segment and how far into it we are.
+	std::array<size_t, byte_max> seg {};
+	std::array<size_t, byte_max> seg_off {};
+	BlockPointers in {};
+	std::array<uint8_t*, byte_max> out {};
+
+	// work through the column ranges between consecutive segment boundaries
+	// of any share, so that within a range every share is contiguous.
+	size_t pos = 0;
+	while (pos < block_size) {
+		size_t len = block_size - pos;
+		for (int i = 0; i < n; i++) {
+			const auto& segments = outputs[i];
+			if (segments.empty()) {
+				continue;
+			}
+			while (seg_off[i] == segments[seg[i]].size()) {
+				++seg[i];
+				seg_off[i] = 0;
+			}
+			len = std::min(len, segments[seg[i]].size() - seg_off[i]);
+		}
+
+		for (int i = 0; i < k; i++) {
+			in[i] = inputs[i] + pos;
+		}
+		for (int i = 0; i < n; i++) {
+			uint8_t* dst = nullptr;
+			if (!outputs[i].empty()) {
+				dst = outputs[i][seg[i]].data() + seg_off[i];
+				seg_off[i] += len;
+			}
+			if (i < k) {
+				if (dst != nullptr) {
+					std::copy_n(in[i], len, dst);
+				}
+			} else {
+				out[i - k] = dst;
+			}
+		}
+
+		encode_parity(in.data(), out.data(), len);
+		pos += len;
+	}
+}
+
 // NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
 
 auto build_environment() -> const char* {
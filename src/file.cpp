@@ -0,0 +1,262 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include "infectious/build_env.h"
+#include "infectious/file.hpp"
+
+#if defined(INFECTIOUS_TARGET_OS_HAS_POSIX1)
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(INFECTIOUS_TARGET_OS_IS_LINUX) || defined(INFECTIOUS_TARGET_OS_IS_ANDROID) || defined(INFECTIOUS_TARGET_OS_IS_FREEBSD)
+# define INFECTIOUS_HAS_POSIX_FALLOCATE
+#endif
+
+namespace infectious {
+
+namespace {
+
+auto system_error(const std::string& what, const std::string& path) -> std::system_error {
+	return {errno, std::generic_category(), what + " " + path};
+}
+
+// FileDescriptor closes a file descriptor when it goes out of scope. The
+// mapping of a file outlives it.
+class FileDescriptor {
+public:
+	explicit FileDescriptor(int fd_)
+		: fd {fd_}
+	{}
+	FileDescriptor(const FileDescriptor&) = delete;
+	FileDescriptor(FileDescriptor&&) = delete;
+	auto operator=(const FileDescriptor&) -> FileDescriptor& = delete;
+	auto operator=(FileDescriptor&&) -> FileDescriptor& = delete;
+	~FileDescriptor() {
+		::close(fd);
+	}
+
+	[[nodiscard]] auto get() const -> int {
+		return fd;
+	}
+
+private:
+	int fd;
+};
+
+} // namespace
+
+auto MappedFile::Open(const std::string& path, Mode mode, const MapOptions& options) -> MappedFile {
+	const FileDescriptor fd(::open(path.c_str(), mode == Mode::ReadWrite ? O_RDWR : O_RDONLY)); // NOLINT(cppcoreguidelines-pro-type-vararg)
+	if (fd.get() < 0) {
+		throw system_error("open", path);
+	}
+
+	struct stat st {};
+	if (::fstat(fd.get(), &st) != 0) {
+		throw system_error("stat", path);
+	}
+	return mapFile(fd.get(), static_cast<size_t>(st.st_size), mode, options, path);
+}
+
+auto MappedFile::Create(const std::string& path, size_t size, const MapOptions& options) -> MappedFile {
+	const FileDescriptor fd(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)); // NOLINT(cppcoreguidelines-pro-type-vararg)
+	if (fd.get() < 0) {
+		throw system_error("create", path);
+	}
+
+	if (::ftruncate(fd.get(), static_cast<off_t>(size)) != 0) {
+		throw system_error("truncate", path);
+	}
+
+#if defined(INFECTIOUS_HAS_POSIX_FALLOCATE)
+	// reserve the blocks up front, so that running out of space is reported
+	// here rather than as a SIGBUS part way through writing the mapping. Not
+	// every filesystem can, which is fine.
+	if (size > 0) {
+		const int err = ::posix_fallocate(fd.get(), 0, static_cast<off_t>(size));
+		if (err != 0 && err != EINVAL && err != EOPNOTSUPP) {
+			errno = err;
+			throw system_error("allocate", path);
+		}
+	}
+#endif
+
+	return mapFile(fd.get(), size, Mode::ReadWrite, options, path);
+}
+
+auto MappedFile::mapFile(int fd, size_t size, Mode mode, const MapOptions& options, const std::string& path) -> MappedFile {
+	if (size == 0) {
+		// there is nothing to map, and mmap refuses to try.
+		return {nullptr, 0};
+	}
+
+	const int prot = mode == Mode::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+	const int flags = mode == Mode::ReadWrite ? MAP_SHARED : MAP_PRIVATE;
+	void* p = ::mmap(nullptr, size, prot, flags, fd, 0);
+	if (p == MAP_FAILED) { // NOLINT(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+		throw system_error("map", path);
+	}
+
+	// the advice is only that, so it not being taken is no error.
+	if (options.sequential) {
+		(void)::posix_madvise(p, size, POSIX_MADV_SEQUENTIAL);
+	}
+#if defined(MADV_HUGEPAGE)
+	if (options.huge_pages) {
+		(void)::madvise(p, size, MADV_HUGEPAGE);
+	}
+#endif
+
+	return {static_cast<uint8_t*>(p), size};
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: addr {std::exchange(other.addr, nullptr)}
+	, length {std::exchange(other.length, 0)}
+{}
+
+auto MappedFile::operator=(MappedFile&& other) noexcept -> MappedFile& {
+	if (this != &other) {
+		if (addr != nullptr) {
+			::munmap(addr, length);
+		}
+		addr = std::exchange(other.addr, nullptr);
+		length = std::exchange(other.length, 0);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile() {
+	if (addr != nullptr) {
+		::munmap(addr, length);
+	}
+}
+
+void MappedFile::Sync() const {
+	if (addr != nullptr && ::msync(addr, length, MS_SYNC) != 0) {
+		throw std::system_error(errno, std::generic_category(), "msync");
+	}
+}
+
+auto EncodeFile(
+	const FEC& fec, const std::string& input_path, std::span<const std::string> share_paths,
+	const MapOptions& options
+) -> size_t {
+	const auto k = static_cast<size_t>(fec.Required());
+	const auto n = static_cast<size_t>(fec.Total());
+	if (share_paths.size() != n) {
+		throw std::invalid_argument("share_paths must have exactly "s + std::to_string(n) + " paths");
+	}
+
+	const auto input = MappedFile::Open(input_path, MappedFile::Mode::ReadOnly, options);
+	const size_t size = input.size();
+	const size_t block_size = (size + k - 1) / k;
+
+	std::vector<MappedFile> shares;
+	shares.reserve(n);
+	std::vector<uint8_t*> outputs(n, nullptr);
+	for (size_t i = 0; i < n; i++) {
+		if (!share_paths[i].empty()) {
+			shares.push_back(MappedFile::Create(share_paths[i], block_size, options));
+			outputs[i] = shares.back().data();
+		}
+	}
+	if (block_size == 0) {
+		return size;
+	}
+
+	// every full block is read straight from the input. The new share files
+	// are all zeros, so a block cut short by the end of the input is read
+	// from its data share once the rest of it is copied there, or from a
+	// padded copy if that share is being skipped.
+	std::vector<const uint8_t*> blocks(k);
+	std::vector<std::vector<uint8_t>> padded;
+	for (size_t i = 0; i < k; i++) {
+		const size_t begin = std::min(i * block_size, size);
+		const size_t end = std::min(begin + block_size, size);
+		const uint8_t* data = input.data() + begin;
+		if (outputs[i] != nullptr) {
+			std::copy(data, data + (end - begin), outputs[i]);
+		}
+
+		if (end - begin == block_size) {
+			blocks[i] = data;
+		} else if (outputs[i] != nullptr) {
+			blocks[i] = outputs[i];
+		} else {
+			auto& copy = padded.emplace_back(block_size, 0);
+			std::copy(data, data + (end - begin), copy.begin());
+			blocks[i] = copy.data();
+		}
+	}
+
+	fec.EncodeParity(blocks, block_size, std::span<uint8_t* const>(outputs.data() + k, n - k));
+
+	if (options.sync) {
+		for (const auto& share : shares) {
+			share.Sync();
+		}
+	}
+	return size;
+}
+
+void DecodeFile(
+	const FEC& fec, const std::map<int, std::string>& share_paths, const std::string& output_path, size_t size,
+	const MapOptions& options
+) {
+	const auto k = static_cast<size_t>(fec.Required());
+	if (share_paths.size() < k) {
+		throw std::invalid_argument("must specify at least the number of required shares");
+	}
+
+	// the shares are mapped copy on write, so that correcting them only
+	// touches private copies of the pages involved.
+	std::vector<MappedFile> mapped;
+	mapped.reserve(share_paths.size());
+	std::map<int, std::span<uint8_t>> shares;
+	for (const auto& [num, path] : share_paths) {
+		mapped.push_back(MappedFile::Open(path, MappedFile::Mode::CopyOnWrite, options));
+		if (mapped.back().size() != mapped.front().size()) {
+			throw std::invalid_argument("share files must all be the same size");
+		}
+		shares.try_emplace(num, mapped.back().Bytes());
+	}
+
+	const size_t block_size = mapped.front().size();
+	if (size > block_size * k) {
+		throw std::invalid_argument("share files are too small for "s + std::to_string(size) + " bytes");
+	}
+
+	const auto output = MappedFile::Create(output_path, size, options);
+	if (size == 0) {
+		return;
+	}
+
+	// anything past size is the padding EncodeFile added, and is left off.
+	fec.DecodeTo(shares, [&output, size, block_size](int num, ByteView data) {
+		const size_t begin = static_cast<size_t>(num) * block_size;
+		if (begin < size) {
+			const size_t len = std::min(data.size(), size - begin);
+			std::copy_n(data.begin(), len, output.data() + begin);
+		}
+	});
+
+	if (options.sync) {
+		output.Sync();
+	}
+}
+
+} // namespace infectious
+
+#endif // INFECTIOUS_TARGET_OS_HAS_POSIX1
@@ -4,7 +4,9 @@
 #ifndef INFECTIOUS_GF_ALG_HPP
 #define INFECTIOUS_GF_ALG_HPP
 
+#include <algorithm>
 #include <iomanip>
+#include <memory_resource>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -41,13 +43,20 @@ template <typename T>
 // and its friends.
 // NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
 
+// because apparently 255 is a 'magic number'
+const static int top_of_range = (1<<8) - 1;
+
+// gf_pow returns n to the power of val, which is just a multiplication of
+// logarithms. Like repeated multiplication starting from 1 would, it
+// returns 1 for any val <= 0, even for n = 0.
 [[nodiscard]] inline auto gf_pow(uint8_t n, int val) -> uint8_t {
-	uint8_t out = 1;
-	const auto& mul_base = gf_mul_table[n];
-	for (int i = 0; i < val; i++) {
-		out = mul_base[out];
+	if (val <= 0) {
+		return 1;
 	}
-	return out;
+	if (n == 0) {
+		return 0;
+	}
+	return gf_exp[(gf_log[n] * val) % top_of_range];
 }
 
 [[nodiscard]] inline auto gf_mul(uint8_t a, uint8_t b) -> uint8_t {
@@ -68,9 +77,6 @@ template <typename T>
 	return a ^ b;
 }
 
-// because apparently 255 is a 'magic number'
-const static int top_of_range = (1<<8) - 1;
-
 [[nodiscard]] inline auto gf_inv(uint8_t n) -> uint8_t {
 	if (n == 0) {
 		throw std::domain_error("invert zero");
@@ -241,12 +247,12 @@ public:
 		start_at += elements;
 	}
 
+	// eval evaluates the polynomial at x by Horner's rule, working down from
+	// the highest power.
 	[[nodiscard]] auto eval(uint8_t x) const -> uint8_t {
 		uint8_t out = 0;
-		for (int i = 0; i <= deg(); ++i) {
-			auto x_i = gf_pow(x, i);
-			auto p_i = index(i);
-			out = gf_add(out, gf_mul(p_i, x_i));
+		for (int i = 0; i < size(); ++i) {
+			out = gf_add(gf_mul(out, x), (*this)[i]);
 		}
 		return out;
 	}
@@ -268,8 +274,8 @@ private:
 
 class FEC::GFMat {
 public:
-	GFMat(long i, long j)
-		: d(i*j)
+	GFMat(long i, long j, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+		: d(i*j, resource)
 		, r {i}
 		, c {j}
 	{}
@@ -308,12 +314,8 @@ public:
 	}
 
 	void swap_row(long i, long j) {
-		std::vector<uint8_t> tmp(c, 0);
 		auto* ri = index_row(i);
-		auto* rj = index_row(j);
-		std::copy(ri, ri + c, tmp.begin());
-		std::copy(rj, rj + c, ri);
-		std::copy(tmp.begin(), tmp.end(), rj);
+		std::swap_ranges(ri, ri + c, index_row(j));
 	}
 
 	void scale_row(long r, uint8_t val) {
@@ -408,7 +410,7 @@ public:
 
 	// parity returns the new matrix because it changes dimensions and stuff. it
 	// can be done in place, but is easier to implement with a copy.
-	[[nodiscard]] auto parity() const -> GFMat {
+	[[nodiscard]] auto parity(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const -> GFMat {
 		// we assume *this is in standard form already
 		// it is of form [I_r | P]
 		// our output will be [-P_transpose | I_(c - r)]
@@ -421,7 +423,7 @@ public:
 		// I_(c-r) has c-r rows and c-r columns.
 		// so: out.r == c-r, out.c == r + c - r == c
 
-		GFMat out(c-r, c);
+		GFMat out(c-r, c, resource);
 
 		// step 1. fill in the identity. it starts at column offset r.
 		for (long i = 0; i < c-r; i++) {
@@ -447,7 +449,7 @@ public:
 	}
 
 private:
-	std::vector<uint8_t> d;
+	std::pmr::vector<uint8_t> d;
 	long r;
 	long c;
 };
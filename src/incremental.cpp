@@ -0,0 +1,145 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <map>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include "infectious/incremental.hpp"
+
+namespace infectious {
+
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+
+IncrementalDecoder::IncrementalDecoder(const FEC& fec_, size_t share_size_)
+	: fec {fec_}
+	, share_size {share_size_}
+	, shares(static_cast<size_t>(fec.Total()))
+	, written(static_cast<size_t>(fec.Total()))
+	, inverse(static_cast<size_t>(fec.Required() * fec.Required()))
+{
+	if (share_size == 0) {
+		throw std::invalid_argument("share size must be positive");
+	}
+}
+
+void IncrementalDecoder::Write(int num, ByteView data) {
+	if (num < 0 || num >= fec.Total()) {
+		throw std::invalid_argument("invalid share id: "s + std::to_string(num));
+	}
+
+	auto& share = shares[static_cast<size_t>(num)];
+	auto& length = written[static_cast<size_t>(num)];
+	if (length + data.size() > share_size) {
+		throw std::invalid_argument("share "s + std::to_string(num) + " is longer than " + std::to_string(share_size) + " bytes");
+	}
+	if (data.empty()) {
+		return;
+	}
+	if (share.empty()) {
+		share.resize(share_size);
+	}
+	std::copy(data.begin(), data.end(), share.begin() + static_cast<ptrdiff_t>(length));
+	length += data.size();
+	if (length == share_size) {
+		++complete;
+	}
+
+	// everything up to the k-th furthest share can be decoded now.
+	const auto k = static_cast<size_t>(fec.Required());
+	std::array<size_t, FEC::byte_max> lengths {};
+	std::copy(written.begin(), written.end(), lengths.begin());
+	std::nth_element(lengths.begin(), lengths.begin() + static_cast<ptrdiff_t>(k - 1), lengths.begin() + static_cast<ptrdiff_t>(written.size()), std::greater<>());
+	if (lengths[k - 1] > decoded) {
+		decode(lengths[k - 1]);
+	}
+}
+
+void IncrementalDecoder::decode(size_t end) {
+	const int k = fec.Required();
+
+	// as in RebuildSorted, every data share that has got this far is used,
+	// and the highest numbered parity shares that have in place of the rest.
+	std::array<int, FEC::byte_max> nums {};
+	int count = 0;
+	for (int i = 0; i < k; i++) {
+		if (written[static_cast<size_t>(i)] >= end) {
+			nums[count++] = i;
+		}
+	}
+	if (count == k) {
+		decoded = end;
+		return;
+	}
+	for (int num = fec.Total() - 1; count < k; num--) {
+		if (written[static_cast<size_t>(num)] >= end) {
+			nums[count++] = num;
+		}
+	}
+
+	const std::span<const int> now(nums.data(), static_cast<size_t>(k));
+	if (!std::equal(now.begin(), now.end(), picked.begin(), picked.end())) {
+		picked.assign(now.begin(), now.end());
+		fec.invertShareRows(now, inverse);
+	}
+
+	// a data piece whose share has got some of the way is only decoded
+	// beyond that, so that the share is never overwritten.
+	FEC::BlockPointers inputs {};
+	for (int i = 0; i < k; i++) {
+		const size_t length = written[static_cast<size_t>(i)];
+		if (length >= end) {
+			continue;
+		}
+		const size_t from = std::max(decoded, length);
+		auto& piece = shares[static_cast<size_t>(i)];
+		if (piece.empty()) {
+			piece.resize(share_size);
+		}
+		for (int j = 0; j < k; j++) {
+			inputs[j] = shares[static_cast<size_t>(nums[j])].data() + from;
+		}
+		uint8_t* const out = piece.data() + from;
+		fec.mulMatrix(&inverse[static_cast<size_t>(i * k)], 1, static_cast<size_t>(k), inputs.data(), &out, end - from);
+	}
+	decoded = end;
+}
+
+void IncrementalDecoder::Finish(const ShareOutputFunc& output) const {
+	if (!Ready()) {
+		throw NotEnoughShares();
+	}
+
+	for (int i = 0; i < fec.Required(); i++) {
+		output(i, ByteView(shares[static_cast<size_t>(i)].data(), share_size));
+	}
+}
+
+void IncrementalDecoder::FinishCorrected(const ShareOutputFunc& output) {
+	if (!Ready()) {
+		throw NotEnoughShares();
+	}
+
+	std::map<int, std::span<uint8_t>> done;
+	for (int num = 0; num < fec.Total(); num++) {
+		if (written[static_cast<size_t>(num)] == share_size) {
+			done.try_emplace(num, shares[static_cast<size_t>(num)]);
+		}
+	}
+	if (fec.Verify(done)) {
+		Finish(output);
+		return;
+	}
+
+	// the shares are fixed in place, so Finish would now give the corrected
+	// data shares, but the other data pieces as they were decoded before.
+	fec.Correct(done);
+	fec.RebuildSorted(done, output);
+}
+
+// NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+
+} // namespace infectious
@@ -0,0 +1,113 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#ifndef INFECTIOUS_MATRIX_CACHE_HPP
+#define INFECTIOUS_MATRIX_CACHE_HPP
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "infectious/fec.hpp"
+
+namespace infectious::internal {
+
+// ShareSet identifies a set of share numbers, one bit per share.
+using ShareSet = std::bitset<FEC::byte_max>;
+
+// MatrixCache is a bounded, thread-safe LRU cache of matrices derived from a
+// set of share numbers, such as the inverted decoding matrix for a given set
+// of available shares.
+//
+// Lookups only take a shared lock, so concurrent readers do not contend with
+// each other; recency is tracked with a per-entry atomic tick rather than by
+// reordering a list. Inserting and evicting take the lock exclusively. Since
+// the cache only holds a few distinct share patterns in practice, eviction
+// just scans for the least recently used entry.
+//
+// Values are handed out as shared pointers, so an entry that is evicted while
+// someone is still using it stays alive until they are done.
+template <typename Value>
+class MatrixCache {
+public:
+	explicit MatrixCache(size_t capacity_)
+		: capacity {capacity_}
+	{}
+
+	// get returns the cached value for key, or nullptr if there is none.
+	[[nodiscard]] auto get(const ShareSet& key) -> std::shared_ptr<const Value> {
+		const std::shared_lock lock(mutex);
+		auto it = entries.find(key);
+		if (it == entries.end()) {
+			misses.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		hits.fetch_add(1, std::memory_order_relaxed);
+		it->second.last_used.store(next_tick(), std::memory_order_relaxed);
+		return it->second.value;
+	}
+
+	// put stores value for key, evicting the least recently used entry if the
+	// cache is full. If another thread got there first, its value is kept and
+	// returned instead.
+	auto put(const ShareSet& key, std::shared_ptr<const Value> value) -> std::shared_ptr<const Value> {
+		const std::unique_lock lock(mutex);
+		if (auto it = entries.find(key); it != entries.end()) {
+			return it->second.value;
+		}
+
+		if (entries.size() >= capacity) {
+			auto oldest = entries.begin();
+			for (auto it = entries.begin(); it != entries.end(); ++it) {
+				if (it->second.last_used.load(std::memory_order_relaxed) <
+						oldest->second.last_used.load(std::memory_order_relaxed)) {
+					oldest = it;
+				}
+			}
+			entries.erase(oldest);
+		}
+
+		entries.try_emplace(key, value, next_tick());
+		return value;
+	}
+
+	[[nodiscard]] auto stats() const -> CacheStats {
+		const std::shared_lock lock(mutex);
+		return CacheStats {
+			.hits = hits.load(std::memory_order_relaxed),
+			.misses = misses.load(std::memory_order_relaxed),
+			.entries = entries.size(),
+			.capacity = capacity,
+		};
+	}
+
+private:
+	struct Entry {
+		Entry(std::shared_ptr<const Value> value_, uint64_t tick)
+			: value {std::move(value_)}
+			, last_used {tick}
+		{}
+
+		std::shared_ptr<const Value> value;
+		std::atomic<uint64_t> last_used;
+	};
+
+	auto next_tick() -> uint64_t {
+		return tick.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	const size_t capacity;
+	mutable std::shared_mutex mutex;
+	std::unordered_map<ShareSet, Entry> entries;
+	std::atomic<uint64_t> tick {0};
+	std::atomic<uint64_t> hits {0};
+	std::atomic<uint64_t> misses {0};
+};
+
+} // namespace infectious::internal
+
+#endif // INFECTIOUS_MATRIX_CACHE_HPP
@@ -0,0 +1,93 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <array>
+#include <atomic>
+
+#include "infectious/stats.hpp"
+
+namespace infectious {
+
+namespace {
+
+#if defined(INFECTIOUS_ENABLE_STATS)
+
+constexpr auto stat_count = static_cast<size_t>(internal::Stat::Count);
+
+// each thread counts into a shard of its own, handed out round robin, so
+// that threads do not contend for the same cache lines. Only with more
+// threads than shards do any two share one, which costs them some speed
+// but loses no counts.
+constexpr size_t stat_shards = 64;
+
+struct alignas(64) Shard {
+	std::array<std::atomic<uint64_t>, stat_count> counters {};
+};
+
+std::array<Shard, stat_shards> shards {};
+std::atomic<size_t> next_shard {0};
+
+auto this_thread_shard() -> Shard& {
+	thread_local Shard& shard = shards[next_shard.fetch_add(1, std::memory_order_relaxed) % stat_shards];
+	return shard;
+}
+
+auto total(internal::Stat stat) -> uint64_t {
+	uint64_t sum = 0;
+	for (const auto& shard : shards) {
+		sum += shard.counters[static_cast<size_t>(stat)].load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+#else
+
+auto total(internal::Stat /*stat*/) -> uint64_t {
+	return 0;
+}
+
+#endif
+
+auto total_time(internal::Stat stat) -> std::chrono::nanoseconds {
+	return std::chrono::nanoseconds(static_cast<std::chrono::nanoseconds::rep>(total(stat)));
+}
+
+} // namespace
+
+#if defined(INFECTIOUS_ENABLE_STATS)
+
+void internal::count_stat(Stat stat, uint64_t amount) noexcept {
+	this_thread_shard().counters[static_cast<size_t>(stat)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+#endif
+
+auto GetStats() -> Stats {
+	using internal::Stat;
+	return Stats {
+		.bytes_encoded = total(Stat::BytesEncoded),
+		.bytes_rebuilt = total(Stat::BytesRebuilt),
+		.bytes_corrected = total(Stat::BytesCorrected),
+		.matrix_inversions = total(Stat::MatrixInversions),
+		.decode_cache_hits = total(Stat::DecodeCacheHits),
+		.syndrome_cache_hits = total(Stat::SyndromeCacheHits),
+		.syndrome_clean = total(Stat::SyndromeClean),
+		.syndrome_dirty = total(Stat::SyndromeDirty),
+		.berlekamp_welch_runs = total(Stat::BerlekampWelchRuns),
+		.encode_time = total_time(Stat::EncodeNanos),
+		.rebuild_time = total_time(Stat::RebuildNanos),
+		.correct_time = total_time(Stat::CorrectNanos),
+	};
+}
+
+void ResetStats() {
+#if defined(INFECTIOUS_ENABLE_STATS)
+	for (auto& shard : shards) {
+		for (auto& counter : shard.counters) {
+			counter.store(0, std::memory_order_relaxed);
+		}
+	}
+#endif
+}
+
+} // namespace infectious
@@ -0,0 +1,232 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <algorithm>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include "infectious/stream.hpp"
+
+namespace infectious {
+
+StreamEncoder::StreamEncoder(const FEC& fec_, size_t stripe_size_)
+	: fec {fec_}
+	, stripe_size {stripe_size_}
+	, stripe(static_cast<size_t>(fec.Required()) * stripe_size)
+	, parity(static_cast<size_t>(fec.Total() - fec.Required()) * stripe_size)
+	, parity_ptrs(fec.Total() - fec.Required())
+{
+	if (stripe_size == 0) {
+		throw std::invalid_argument("stripe size must be positive");
+	}
+	for (size_t i = 0; i < parity_ptrs.size(); ++i) {
+		parity_ptrs[i] = &parity[i * stripe_size];
+	}
+}
+
+void StreamEncoder::encodeStripe(const uint8_t* data, size_t piece_size, const ShareOutputFunc& output) {
+	const int k = fec.Required();
+	const int n = fec.Total();
+
+	fec.EncodeParity(ByteView(data, piece_size * k), parity_ptrs);
+
+	for (int i = 0; i < k; i++) {
+		output(i, ByteView(data + i*piece_size, piece_size));
+	}
+	for (int i = k; i < n; i++) {
+		output(i, ByteView(parity_ptrs[i - k], piece_size));
+	}
+}
+
+void StreamEncoder::Write(ByteView data, const ShareOutputFunc& output) {
+	const size_t stripe_bytes = stripe.size();
+
+	// top up a partly filled stripe first.
+	if (buffered > 0) {
+		const size_t take = std::min(stripe_bytes - buffered, data.size());
+		std::copy_n(data.begin(), take, stripe.begin() + static_cast<ptrdiff_t>(buffered));
+		buffered += take;
+		data.remove_prefix(take);
+		if (buffered < stripe_bytes) {
+			return;
+		}
+		encodeStripe(stripe.data(), stripe_size, output);
+		buffered = 0;
+	}
+
+	// whole stripes can be encoded straight out of the caller's data.
+	while (data.size() >= stripe_bytes) {
+		encodeStripe(data.data(), stripe_size, output);
+		data.remove_prefix(stripe_bytes);
+	}
+
+	std::copy(data.begin(), data.end(), stripe.begin());
+	buffered = data.size();
+}
+
+// padFinalStripe pads the buffered data out to a multiple of k, and returns
+// the resulting piece size along with the padding added.
+auto StreamEncoder::padFinalStripe() -> std::pair<size_t, size_t> {
+	const auto k = static_cast<size_t>(fec.Required());
+	const size_t piece_size = (buffered + k - 1) / k;
+	const size_t padding = piece_size * k - buffered;
+	std::fill_n(stripe.begin() + static_cast<ptrdiff_t>(buffered), padding, uint8_t {0});
+	buffered = 0;
+	return {piece_size, padding};
+}
+
+auto StreamEncoder::Finish(const ShareOutputFunc& output) -> size_t {
+	if (buffered == 0) {
+		return 0;
+	}
+
+	const auto [piece_size, padding] = padFinalStripe();
+	encodeStripe(stripe.data(), piece_size, output);
+	return padding;
+}
+
+auto StreamEncoder::stripeChunks(const uint8_t* data, size_t piece_size) -> Generator<ShareChunk> {
+	const int k = fec.Required();
+	const int n = fec.Total();
+
+	if (piece_size == 0) {
+		co_return;
+	}
+
+	fec.EncodeParity(ByteView(data, piece_size * k), parity_ptrs);
+
+	for (int i = 0; i < k; i++) {
+		co_yield ShareChunk {i, ByteView(data + i*piece_size, piece_size)};
+	}
+	for (int i = k; i < n; i++) {
+		co_yield ShareChunk {i, ByteView(parity_ptrs[i - k], piece_size)};
+	}
+}
+
+auto StreamEncoder::Chunks(ByteView data) -> Generator<ShareChunk> {
+	const size_t stripe_bytes = stripe.size();
+
+	// this follows Write exactly, yielding where it would call output.
+	if (buffered > 0) {
+		const size_t take = std::min(stripe_bytes - buffered, data.size());
+		std::copy_n(data.begin(), take, stripe.begin() + static_cast<ptrdiff_t>(buffered));
+		buffered += take;
+		data.remove_prefix(take);
+		if (buffered < stripe_bytes) {
+			co_return;
+		}
+		for (const auto& chunk : stripeChunks(stripe.data(), stripe_size)) {
+			co_yield chunk;
+		}
+		buffered = 0;
+	}
+
+	while (data.size() >= stripe_bytes) {
+		for (const auto& chunk : stripeChunks(data.data(), stripe_size)) {
+			co_yield chunk;
+		}
+		data.remove_prefix(stripe_bytes);
+	}
+
+	std::copy(data.begin(), data.end(), stripe.begin());
+	buffered = data.size();
+}
+
+auto StreamEncoder::FinishChunks() -> std::pair<Generator<ShareChunk>, size_t> {
+	if (buffered == 0) {
+		return {stripeChunks(nullptr, 0), 0};
+	}
+
+	const auto [piece_size, padding] = padFinalStripe();
+	return {stripeChunks(stripe.data(), piece_size), padding};
+}
+
+StreamDecoder::StreamDecoder(const FEC& fec_, size_t stripe_size_, std::span<const int> share_nums)
+	: fec {fec_}
+	, stripe_size {stripe_size_}
+	, stripe(static_cast<size_t>(fec.Required()) * stripe_size)
+{
+	if (stripe_size == 0) {
+		throw std::invalid_argument("stripe size must be positive");
+	}
+
+	for (auto num : share_nums) {
+		if (num < 0 || num >= fec.Total()) {
+			throw std::invalid_argument("invalid share id: "s + std::to_string(num));
+		}
+		pieces[num].data.reserve(stripe_size);
+	}
+	if (static_cast<int>(pieces.size()) < fec.Required()) {
+		throw NotEnoughShares();
+	}
+
+	if (fec.DecodeCacheStats().capacity == 0) {
+		fec.EnableDecodeCache(1);
+	}
+	if (fec.SyndromeCacheStats().capacity == 0) {
+		fec.EnableSyndromeCache(1);
+	}
+}
+
+void StreamDecoder::ShareBuffer::consume(size_t len) {
+	start += len;
+	if (start == data.size()) {
+		data.clear();
+		start = 0;
+	} else if (start >= data.size() / 2) {
+		data.erase(data.begin(), data.begin() + static_cast<ptrdiff_t>(start));
+		start = 0;
+	}
+}
+
+void StreamDecoder::decodeStripe(size_t piece_size, const DataOutputFunc& output) {
+	auto& ws = Workspace::ForThisThread();
+	const Workspace::Scope scope(ws);
+	std::pmr::map<int, std::span<uint8_t>> shares(&ws);
+	for (auto& [num, piece] : pieces) {
+		shares.try_emplace(num, piece.data.data() + piece.start, piece_size);
+	}
+
+	fec.DecodeTo(shares, [&](int num, ByteView data) {
+		std::copy(data.begin(), data.end(), stripe.begin() + static_cast<ptrdiff_t>(num * piece_size));
+	});
+	output(ByteView(stripe.data(), piece_size * fec.Required()));
+
+	for (auto& [num, piece] : pieces) {
+		piece.consume(piece_size);
+	}
+}
+
+void StreamDecoder::Write(int num, ByteView data, const DataOutputFunc& output) {
+	auto it = pieces.find(num);
+	if (it == pieces.end()) {
+		throw std::invalid_argument("share "s + std::to_string(num) + " was not expected");
+	}
+	auto& piece = it->second.data;
+	piece.insert(piece.end(), data.begin(), data.end());
+
+	// decode for as long as every share has a whole stripe buffered. A share
+	// that gets ahead of the others just buffers more until they catch up.
+	for (;;) {
+		for (const auto& [_, other] : pieces) {
+			if (other.size() < stripe_size) {
+				return;
+			}
+		}
+		decodeStripe(stripe_size, output);
+	}
+}
+
+void StreamDecoder::Finish(const DataOutputFunc& output) {
+	const size_t piece_size = pieces.begin()->second.size();
+	for (const auto& [num, piece] : pieces) {
+		if (piece.size() != piece_size) {
+			throw std::invalid_argument("share "s + std::to_string(num) + " has a different length from the others");
+		}
+	}
+	if (piece_size > 0) {
+		decodeStripe(piece_size, output);
+	}
+}
+
+} // namespace infectious
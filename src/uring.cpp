@@ -0,0 +1,348 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+//
+// A minimal io_uring driver for UringShareWriter. liburing would do the
+// same job, but the little this needs of it is easily done with the raw
+// system calls, and so without another dependency.
+
+#include "infectious/build_env.h"
+#include "infectious/uring.hpp"
+
+#if defined(INFECTIOUS_TARGET_OS_HAS_IO_URING)
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace infectious {
+
+namespace {
+
+auto system_error(int err, const std::string& what) -> std::system_error {
+	return {err, std::generic_category(), what};
+}
+
+// the most that one write is submitted for. sqe.len is only 32 bits, so a
+// larger piece goes in several writes, the later ones through the same
+// resubmission as a short write. A whole number of pages keeps them page
+// aligned whenever the first one is.
+constexpr size_t page_size = 4096;
+constexpr size_t max_write = UINT32_MAX & ~(page_size - 1);
+
+// the system calls, which glibc has no wrappers for.
+// NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+auto uring_setup(unsigned entries, io_uring_params* params) -> int {
+	return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+auto uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) -> int {
+	return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+auto uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) -> int {
+	return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+// NOLINTEND(cppcoreguidelines-pro-type-vararg)
+
+// Mapping is one region of the rings shared with the kernel.
+struct Mapping {
+	void* ptr {MAP_FAILED};
+	size_t size {0};
+
+	void map(int fd, size_t size_, off_t offset) {
+		size = size_;
+		ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+		if (ptr == MAP_FAILED) {
+			throw system_error(errno, "io_uring mmap");
+		}
+	}
+
+	Mapping() = default;
+	Mapping(const Mapping&) = delete;
+	Mapping(Mapping&&) = delete;
+	auto operator=(const Mapping&) -> Mapping& = delete;
+	auto operator=(Mapping&&) -> Mapping& = delete;
+	~Mapping() {
+		if (ptr != MAP_FAILED) {
+			::munmap(ptr, size);
+		}
+	}
+
+	template <typename T>
+	[[nodiscard]] auto at(size_t offset) const -> T* {
+		return reinterpret_cast<T*>(static_cast<uint8_t*>(ptr) + offset); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	}
+};
+
+} // namespace
+
+// we index into the rings the kernel shares with us without bounds checking.
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+struct UringShareWriter::Ring {
+	// Pending is what is left to write of the piece for one share.
+	struct Pending {
+		const uint8_t* data {nullptr};
+		size_t size {0};
+		int buffer {-1};
+	};
+
+	std::vector<int> fds;
+	std::vector<Pending> pending;
+	std::vector<ByteView> registered;
+
+	int fd {-1};
+	Mapping sq_ring;
+	Mapping cq_ring;
+	Mapping sqe_ring;
+
+	unsigned* sq_tail {nullptr};
+	unsigned sq_mask {0};
+	unsigned* sq_array {nullptr};
+	io_uring_sqe* sqes {nullptr};
+	unsigned* cq_head {nullptr};
+	unsigned* cq_tail {nullptr};
+	unsigned cq_mask {0};
+	io_uring_cqe* cqes {nullptr};
+
+	// queued counts entries put on the submission queue but not yet
+	// submitted, and in_flight those submitted but not yet completed.
+	unsigned queued {0};
+	unsigned in_flight {0};
+
+	explicit Ring(std::span<const int> fds_)
+		: fds(fds_.begin(), fds_.end())
+		, pending(fds_.size())
+	{}
+
+	Ring(const Ring&) = delete;
+	Ring(Ring&&) = delete;
+	auto operator=(const Ring&) -> Ring& = delete;
+	auto operator=(Ring&&) -> Ring& = delete;
+	~Ring() {
+		if (fd >= 0) {
+			::close(fd);
+		}
+	}
+
+	void open() {
+		// one entry for every share lets a whole stripe go in one submission.
+		const unsigned entries = std::bit_ceil(std::max<unsigned>(static_cast<unsigned>(fds.size()), 1));
+
+		io_uring_params params {};
+		fd = uring_setup(entries, &params);
+		if (fd < 0) {
+			throw system_error(errno, "io_uring_setup");
+		}
+		if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+			throw system_error(ENOTSUP, "io_uring writes at the current position");
+		}
+
+		const size_t sq_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+		const size_t cq_size = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+		if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+			sq_ring.map(fd, std::max(sq_size, cq_size), IORING_OFF_SQ_RING);
+		} else {
+			sq_ring.map(fd, sq_size, IORING_OFF_SQ_RING);
+			cq_ring.map(fd, cq_size, IORING_OFF_CQ_RING);
+		}
+		const Mapping& cq = cq_ring.ptr != MAP_FAILED ? cq_ring : sq_ring;
+		sqe_ring.map(fd, params.sq_entries*sizeof(io_uring_sqe), IORING_OFF_SQES);
+
+		sq_tail = sq_ring.at<unsigned>(params.sq_off.tail);
+		sq_mask = *sq_ring.at<unsigned>(params.sq_off.ring_mask);
+		sq_array = sq_ring.at<unsigned>(params.sq_off.array);
+		sqes = sqe_ring.at<io_uring_sqe>(0);
+		cq_head = cq.at<unsigned>(params.cq_off.head);
+		cq_tail = cq.at<unsigned>(params.cq_off.tail);
+		cq_mask = *cq.at<unsigned>(params.cq_off.ring_mask);
+		cqes = cq.at<io_uring_cqe>(params.cq_off.cqes);
+	}
+
+	void registerBuffers(std::span<const ByteView> buffers) {
+		if (!registered.empty()) {
+			if (uring_register(fd, IORING_UNREGISTER_BUFFERS, nullptr, 0) < 0) {
+				throw system_error(errno, "io_uring unregister buffers");
+			}
+			registered.clear();
+		}
+
+		std::vector<iovec> iovs;
+		std::vector<ByteView> views;
+		for (const auto& buffer : buffers) {
+			if (!buffer.empty()) {
+				iovs.push_back({const_cast<uint8_t*>(buffer.data()), buffer.size()}); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+				views.push_back(buffer);
+			}
+		}
+		if (iovs.empty()) {
+			return;
+		}
+		if (uring_register(fd, IORING_REGISTER_BUFFERS, iovs.data(), static_cast<unsigned>(iovs.size())) < 0) {
+			throw system_error(errno, "io_uring register buffers");
+		}
+		registered = std::move(views);
+	}
+
+	// registeredBuffer returns the index of the registered buffer holding
+	// all of data, or -1 if there is none.
+	[[nodiscard]] auto registeredBuffer(ByteView data) const -> int {
+		for (size_t i = 0; i < registered.size(); i++) {
+			const auto& buffer = registered[i];
+			if (data.data() >= buffer.data() && data.data() + data.size() <= buffer.data() + buffer.size()) {
+				return static_cast<int>(i);
+			}
+		}
+		return -1;
+	}
+
+	// queue puts the write of what is pending for share num on the
+	// submission queue.
+	void queue(int num) {
+		const Pending& p = pending[static_cast<size_t>(num)];
+
+		const unsigned tail = *sq_tail;
+		const unsigned index = tail & sq_mask;
+		io_uring_sqe& sqe = sqes[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = p.buffer >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+		sqe.fd = fds[static_cast<size_t>(num)];
+		sqe.off = static_cast<uint64_t>(-1);
+		sqe.addr = reinterpret_cast<uint64_t>(p.data); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+		sqe.len = static_cast<uint32_t>(std::min(p.size, max_write));
+		sqe.buf_index = static_cast<uint16_t>(std::max(p.buffer, 0));
+		sqe.user_data = static_cast<uint64_t>(num);
+		sq_array[index] = index;
+		std::atomic_ref<unsigned>(*sq_tail).store(tail + 1, std::memory_order_release);
+
+		queued++;
+	}
+
+	void add(ShareChunk chunk) {
+		if (chunk.num < 0 || static_cast<size_t>(chunk.num) >= fds.size()) {
+			throw std::invalid_argument("share number "s + std::to_string(chunk.num) + " out of range");
+		}
+		if (fds[static_cast<size_t>(chunk.num)] < 0 || chunk.data.empty()) {
+			return;
+		}
+		if (pending[static_cast<size_t>(chunk.num)].size > 0) {
+			// only one write may be in flight for each file descriptor, or
+			// they could land in either order.
+			drain();
+		}
+		pending[static_cast<size_t>(chunk.num)] = {chunk.data.data(), chunk.data.size(), registeredBuffer(chunk.data)};
+		queue(chunk.num);
+	}
+
+	// drain submits everything queued, and waits for it all to be written,
+	// resubmitting what is left of any short write. If a write fails, the
+	// first error is thrown once nothing is left in flight.
+	void drain() {
+		int error = 0;
+		int error_num = 0;
+
+		while (queued > 0 || in_flight > 0) {
+			const int submitted = uring_enter(fd, queued, 1, IORING_ENTER_GETEVENTS);
+			if (submitted < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw system_error(errno, "io_uring_enter");
+			}
+			in_flight += static_cast<unsigned>(submitted);
+			queued -= static_cast<unsigned>(submitted);
+
+			unsigned head = *cq_head;
+			const unsigned tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+			for (; head != tail; head++) {
+				const io_uring_cqe& cqe = cqes[head & cq_mask];
+				const auto num = static_cast<int>(cqe.user_data);
+				Pending& p = pending[static_cast<size_t>(num)];
+				in_flight--;
+
+				if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+					queue(num);
+					continue;
+				}
+				if (cqe.res <= 0) {
+					if (error == 0) {
+						error = cqe.res < 0 ? -cqe.res : EIO;
+						error_num = num;
+					}
+					p.size = 0;
+					continue;
+				}
+				p.data += cqe.res;
+				p.size -= static_cast<size_t>(cqe.res);
+				if (p.size > 0) {
+					queue(num);
+				}
+			}
+			std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+		}
+
+		if (error != 0) {
+			throw system_error(error, "writing share "s + std::to_string(error_num));
+		}
+	}
+};
+
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+UringShareWriter::UringShareWriter(const FEC& fec, std::span<const int> fds)
+	: ring {std::make_unique<Ring>(fds)}
+{
+	// a stripe is taken to be done with once its last share comes along.
+	if (fds.size() != static_cast<size_t>(fec.Total())) {
+		throw std::invalid_argument("want "s + std::to_string(fec.Total()) + " file descriptors, got " + std::to_string(fds.size()));
+	}
+	ring->open();
+}
+
+UringShareWriter::~UringShareWriter() = default;
+UringShareWriter::UringShareWriter(UringShareWriter&&) noexcept = default;
+auto UringShareWriter::operator=(UringShareWriter&&) noexcept -> UringShareWriter& = default;
+
+void UringShareWriter::RegisterBuffers(const StreamEncoder& encoder) {
+	const auto buffers = encoder.Buffers();
+	ring->registerBuffers(buffers);
+}
+
+void UringShareWriter::Write(Generator<ShareChunk> chunks) {
+	const auto last = static_cast<int>(ring->fds.size()) - 1;
+	try {
+		for (const auto& chunk : chunks) {
+			ring->add(chunk);
+			// the pieces of a stripe are only valid until the next one is
+			// asked for.
+			if (chunk.num == last) {
+				ring->drain();
+			}
+		}
+	} catch (...) {
+		// nothing may still be reading the pieces once the generator is gone.
+		try {
+			ring->drain();
+		} catch (...) {} // NOLINT(bugprone-empty-catch)
+		throw;
+	}
+	ring->drain();
+}
+
+} // namespace infectious
+
+#endif // INFECTIOUS_TARGET_OS_HAS_IO_URING
@@ -0,0 +1,122 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include "infectious/workspace.hpp"
+
+namespace infectious {
+
+namespace {
+
+// the first chunk a Workspace allocates is at least this big, and each one
+// after that at least double the last.
+constexpr size_t min_chunk_size = 64UL * 1024UL;
+
+} // namespace
+
+auto Workspace::ForThisThread() -> Workspace& {
+	thread_local Workspace ws;
+	return ws;
+}
+
+Workspace::Scope::Scope(Workspace& ws_)
+	: ws {ws_}
+	, chunk {ws_.current}
+	, offset {ws_.offset}
+	, large {ws_.large_chunks.size()}
+{
+	++ws.depth;
+}
+
+Workspace::Scope::~Scope() {
+	ws.current = chunk;
+	ws.offset = offset;
+	ws.large_chunks.resize(large);
+
+	if (--ws.depth == 0) {
+		ws.trim();
+	}
+}
+
+void Workspace::trim() {
+	const size_t total = Capacity();
+	if (total > max_retained) {
+		// keep the biggest chunks that fit under the cap, and free the rest.
+		std::sort(chunks.begin(), chunks.end(), [](const Chunk& a, const Chunk& b) {
+			return a.size > b.size;
+		});
+		size_t kept = 0;
+		size_t keep = 0;
+		for (; keep < chunks.size() && kept + chunks[keep].size <= max_retained; ++keep) {
+			kept += chunks[keep].size;
+		}
+		chunks.resize(keep);
+	} else if (chunks.size() > 1) {
+		// it took more than one chunk; trade them all in for a single one big
+		// enough for the lot, so that the next time around fits without
+		// needing any more.
+		chunks.clear();
+		chunks.push_back(Chunk {std::make_unique_for_overwrite<std::byte[]>(total), total}); // NOLINT(cppcoreguidelines-avoid-c-arrays,modernize-avoid-c-arrays)
+	}
+	current = 0;
+	offset = 0;
+}
+
+auto Workspace::Capacity() const -> size_t {
+	size_t total = 0;
+	for (const auto& c : chunks) {
+		total += c.size;
+	}
+	return total;
+}
+
+void Workspace::Release() {
+	if (depth > 0) {
+		throw std::logic_error("cannot release a Workspace with a Scope open");
+	}
+	chunks.clear();
+	current = 0;
+	offset = 0;
+}
+
+auto Workspace::do_allocate(size_t bytes, size_t alignment) -> void* {
+	// chunk memory comes from operator new, so it is suitably aligned for
+	// anything ordinary.
+	if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+		throw std::bad_alloc();
+	}
+
+	if (bytes > max_retained) {
+		large_chunks.push_back(Chunk {std::make_unique_for_overwrite<std::byte[]>(bytes), bytes}); // NOLINT(cppcoreguidelines-avoid-c-arrays,modernize-avoid-c-arrays)
+		return large_chunks.back().data.get();
+	}
+
+	for (; current < chunks.size(); ++current, offset = 0) {
+		auto& c = chunks[current];
+		const size_t start = (offset + alignment - 1) / alignment * alignment;
+		if (start + bytes <= c.size) {
+			offset = start + bytes;
+			return c.data.get() + start;
+		}
+	}
+
+	// nothing left that fits; add a new chunk on the end.
+	const size_t last = chunks.empty() ? 0 : chunks.back().size;
+	const size_t size = std::max({bytes, std::min(2 * last, max_retained), min_chunk_size});
+	chunks.push_back(Chunk {std::make_unique_for_overwrite<std::byte[]>(size), size}); // NOLINT(cppcoreguidelines-avoid-c-arrays,modernize-avoid-c-arrays)
+	current = chunks.size() - 1;
+	offset = bytes;
+	return chunks.back().data.get();
+}
+
+void Workspace::do_deallocate(void* /*p*/, size_t /*bytes*/, size_t /*alignment*/) {
+	// memory is released when the enclosing Scope closes.
+}
+
+auto Workspace::do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool {
+	return this == &other;
+}
+
+} // namespace infectious
@@ -0,0 +1,182 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "infectious/fec.hpp"
+#include "random_env.hpp"
+
+namespace infectious::test {
+
+// clang-tidy doesn't much care for gtest's macros.
+// NOLINTBEGIN(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+// encode_all encodes input (starting offset bytes into it, so that the
+// kernels see unaligned pointers) and returns all n shares concatenated.
+auto encode_all(const FEC& fec, const std::vector<uint8_t>& input, size_t offset) -> std::vector<uint8_t> {
+	std::vector<uint8_t> out;
+	ByteView view(input.data() + offset, input.size() - offset);
+	fec.Encode(view, [&](int, ByteView share) {
+		out.insert(out.end(), share.begin(), share.end());
+	});
+	return out;
+}
+
+// Every supported provider must agree with the portable implementation, for
+// sizes that exercise all unrolled loops and tails of each kernel. The dot
+// product kernels take their inputs eight at a time, so the second scheme
+// has them go through a few groups, the last of them partial.
+TEST(Addmul, ProvidersMatchPortable) {
+	const int byte_limit = 256;
+	const std::vector<FEC> schemes {FEC(3, 7), FEC(19, 23)};
+
+	// "auto" is the best provider, unless INFECTIOUS_ADDMUL_PROVIDER pins
+	// another one.
+	set_addmul_provider("auto");
+	const auto automatic = addmul_provider();
+
+	const auto providers = addmul_providers();
+	ASSERT_FALSE(providers.empty());
+	if (std::getenv("INFECTIOUS_ADDMUL_PROVIDER") == nullptr) { // NOLINT(concurrency-mt-unsafe)
+		ASSERT_EQ(automatic, providers.front());
+	}
+	ASSERT_NE(std::find(providers.begin(), providers.end(), "none"), providers.end());
+	ASSERT_EQ(providers.back(), "xor");
+
+	for (const auto& fec : schemes) {
+		for (size_t block : {1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129, 200, 1000, 4099}) {
+			for (size_t offset : {0, 1, 7}) {
+				std::vector<uint8_t> input(offset + block*static_cast<size_t>(fec.Required()));
+				for (auto& b : input) {
+					b = static_cast<uint8_t>(random_env->randn(byte_limit));
+				}
+
+				set_addmul_provider("none");
+				const auto expected = encode_all(fec, input, offset);
+
+				for (const auto& provider : providers) {
+					set_addmul_provider(provider);
+					ASSERT_EQ(addmul_provider(), provider);
+					ASSERT_EQ(encode_all(fec, input, offset), expected)
+						<< "provider " << provider << " required " << fec.Required()
+						<< " block " << block << " offset " << offset;
+				}
+			}
+		}
+	}
+
+	set_addmul_provider("auto");
+	ASSERT_EQ(addmul_provider(), automatic);
+}
+
+// Decoding goes through the plain addmul kernels rather than the fused ones
+// used by encoding, so check those separately.
+TEST(Addmul, ProvidersDecode) {
+	const int required = 3;
+	const int total = 7;
+	const int byte_limit = 256;
+	FEC fec(required, total);
+
+	for (size_t block : {1, 17, 33, 65, 129, 4099}) {
+		std::vector<uint8_t> input(block*required);
+		for (auto& b : input) {
+			b = static_cast<uint8_t>(random_env->randn(byte_limit));
+		}
+
+		std::map<int, std::vector<uint8_t>> shares;
+		fec.Encode(input, [&](int num, ByteView share) {
+			if (num >= total - required) {
+				shares[num] = std::vector(share.begin(), share.end());
+			}
+		});
+
+		for (const auto& provider : addmul_providers()) {
+			set_addmul_provider(provider);
+			std::vector<uint8_t> got(input.size());
+			fec.Rebuild(shares, [&](int num, ByteView data) {
+				std::copy(data.begin(), data.end(), got.begin() + static_cast<ptrdiff_t>(num*block));
+			});
+			ASSERT_EQ(got, input) << "provider " << provider << " block " << block;
+		}
+	}
+
+	set_addmul_provider("auto");
+}
+
+TEST(Addmul, UnknownProvider) {
+	ASSERT_THROW(set_addmul_provider("no-such-provider"), std::invalid_argument);
+	set_addmul_provider("auto");
+}
+
+// Every thread must see the same CPU features, however many of them ask at
+// once.
+TEST(Addmul, ConcurrentQueries) {
+	const auto expected = addmul_providers();
+	std::vector<std::vector<std::string>> seen(8);
+	std::vector<std::thread> threads;
+	for (auto& s : seen) {
+		threads.emplace_back([&s] { s = addmul_providers(); });
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	for (const auto& s : seen) {
+		ASSERT_EQ(s, expected);
+	}
+}
+
+// This is run by ctest with INFECTIOUS_CPUID_DISABLE hiding one feature at
+// a time. No provider that is left may run a kernel that needs it, including
+// the narrower kernels that finish the tails of the wider ones.
+TEST(Addmul, DisabledFeatures) {
+	const char* disabled = std::getenv("INFECTIOUS_CPUID_DISABLE"); // NOLINT(concurrency-mt-unsafe)
+	if (disabled == nullptr || std::getenv("INFECTIOUS_ADDMUL_PROVIDER") != nullptr) { // NOLINT(concurrency-mt-unsafe)
+		GTEST_SKIP() << "not run with the environment set up by ctest";
+	}
+
+	const std::map<std::string, std::vector<std::string>> needs {
+		{"gfni-avx512", {"gfni", "avx512bw", "avx2"}},
+		{"avx512bw", {"avx512bw", "avx2", "ssse3"}},
+		{"gfni-avx2", {"gfni", "avx2"}},
+		{"avx2", {"avx2", "ssse3"}},
+		{"gfni", {"gfni"}},
+		{"ssse3", {"ssse3"}},
+		{"neon", {"neon"}},
+		{"sse2", {"sse2"}},
+	};
+	for (const auto& provider : addmul_providers()) {
+		const auto it = needs.find(provider);
+		if (it == needs.end()) {
+			continue;
+		}
+		for (const auto& feature : it->second) {
+			ASSERT_NE(feature, disabled) << "provider " << provider;
+		}
+	}
+}
+
+// This is run by ctest with INFECTIOUS_CPUID_DISABLE hiding every feature
+// the library knows of, and INFECTIOUS_ADDMUL_PROVIDER pinning "nibble".
+TEST(Addmul, EnvironmentOverrides) {
+	const char* pinned = std::getenv("INFECTIOUS_ADDMUL_PROVIDER"); // NOLINT(concurrency-mt-unsafe)
+	if (pinned == nullptr || std::string(pinned) != "nibble" || std::getenv("INFECTIOUS_CPUID_DISABLE") == nullptr) { // NOLINT(concurrency-mt-unsafe)
+		GTEST_SKIP() << "not run with the environment set up by ctest";
+	}
+
+	ASSERT_EQ(addmul_providers(), (std::vector<std::string> {"none", "nibble", "xor"}));
+	ASSERT_EQ(addmul_provider(), "nibble");
+	set_addmul_provider("none");
+	set_addmul_provider("auto");
+	ASSERT_EQ(addmul_provider(), "nibble");
+}
+
+// NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+} // namespace infectious::test
@@ -217,6 +217,192 @@ TEST(BerlekampWelch, RandomShares) {
 	}
 }
 
+TEST(BerlekampWelch, SyndromeCache) {
+	const int block = 4096;
+	const int total = 7;
+	const int required = 3;
+
+	BerlekampWelchTest test(required, total);
+	test.EnableSyndromeCache(4);
+	auto shares = test.SomeShares(block).second;
+
+	auto shares_upto_k = shares;
+	for (int a = required; a < total; ++a) {
+		shares_upto_k.erase(a);
+	}
+
+	for (int i = 0; i < 3; i++) {
+		auto corrupted = shares;
+		corrupted[i][i]++;
+		corrupted[total - 1][block - 1]++;
+
+		auto [decoded_shares, callback] = test.StoreShares();
+		test.DecodeTo(corrupted, callback);
+		test.AssertEqualShares(shares_upto_k, *decoded_shares);
+	}
+
+	auto stats = test.SyndromeCacheStats();
+	ASSERT_EQ(stats.hits, 2);
+	ASSERT_EQ(stats.misses, 1);
+	ASSERT_EQ(stats.entries, 1);
+
+	shares.erase(2);
+	test.DecodeTo(shares, BerlekampWelchTest::noop);
+	ASSERT_EQ(test.SyndromeCacheStats().misses, 2);
+}
+
+TEST(BerlekampWelch, Verify) {
+	const int block = 10000;
+	const int total = 7;
+	const int required = 3;
+
+	BerlekampWelchTest test(required, total);
+	auto shares = test.SomeShares(block).second;
+	ASSERT_TRUE(test.Verify(shares));
+
+	// the shares need not be in share number order.
+	std::vector<std::pair<int, std::vector<uint8_t>>> shuffled(shares.begin(), shares.end());
+	test.PermuteShares(shuffled);
+	ASSERT_TRUE(test.Verify(shuffled));
+
+	shuffled[0].second[block - 1]++;
+	ASSERT_FALSE(test.Verify(shuffled));
+
+	// an unordered set of shares with an error must also still be corrected.
+	auto [decoded_shares, callback] = test.StoreShares();
+	test.DecodeTo(shuffled, callback);
+	for (int a = required; a < total; ++a) {
+		shares.erase(a);
+	}
+	test.AssertEqualShares(shares, *decoded_shares);
+
+	shares.erase(0);
+	ASSERT_THROW(static_cast<void>(test.Verify(shares)), std::invalid_argument);
+}
+
+TEST(BerlekampWelch, CorruptedRuns) {
+	const int block = 64 * 1024;
+	const int total = 14;
+	const int required = 8;
+	const int run_start = 5000;
+	const int run_length = 20000;
+	const int scattered = 300;
+
+	BerlekampWelchTest test(required, total);
+	auto shares = test.SomeShares(block).second;
+	auto expected = shares;
+
+	// one share with a long corrupted run, overlapping a second one, and a
+	// third with errors scattered all over.
+	std::vector<std::pair<int, std::vector<uint8_t>>> corrupted(shares.begin(), shares.end());
+	for (int i = run_start; i < run_start + run_length; ++i) {
+		test.MutateShare(i, corrupted[2]);
+	}
+	for (int i = run_start + run_length / 2; i < run_start + 2 * run_length; ++i) {
+		test.MutateShare(i, corrupted[total - 1]);
+	}
+	for (int i = 0; i < scattered; ++i) {
+		test.MutateShare(random_env->randn(block), corrupted[required]);
+	}
+
+	test.Correct(corrupted);
+	test.AssertEqualShares(expected, corrupted);
+}
+
+TEST(BerlekampWelch, FindBadShares) {
+	const int block = 4096;
+	const int total = 10;
+	const int required = 4;
+
+	BerlekampWelchTest test(required, total);
+	auto shares = test.SomeShares(block).second;
+	ASSERT_TRUE(test.FindBadShares(shares).empty());
+
+	// whole shares gone bad are found, and the shares are left alone.
+	std::vector<std::pair<int, std::vector<uint8_t>>> corrupted(shares.begin(), shares.end());
+	for (int i = 0; i < block; ++i) {
+		test.MutateShare(i, corrupted[1]);
+		test.MutateShare(i, corrupted[7]);
+	}
+	auto untouched = corrupted;
+	ASSERT_EQ(test.FindBadShares(corrupted), (std::vector<int>{1, 7}));
+	ASSERT_EQ(corrupted, untouched);
+
+	auto [decoded_shares, callback] = test.StoreShares();
+	ASSERT_EQ(test.DecodeToDroppingBad(corrupted, callback), (std::vector<int>{1, 7}));
+	auto shares_upto_k = shares;
+	for (int a = required; a < total; ++a) {
+		shares_upto_k.erase(a);
+	}
+	test.AssertEqualShares(shares_upto_k, *decoded_shares);
+
+	// a stray error outside the sampled positions makes it fall back to
+	// correcting everything.
+	corrupted.assign(shares.begin(), shares.end());
+	for (int i = 0; i < block; ++i) {
+		test.MutateShare(i, corrupted[2]);
+	}
+	test.MutateShare(3, corrupted[5]);
+	ASSERT_EQ(test.FindBadShares(corrupted), (std::vector<int>{2, 5}));
+	test.AssertEqualShares(shares, corrupted);
+}
+
+// When the errors are spread over more shares than any sample explains,
+// every share has to be corrected rather than some dropped, since there are
+// fewer than k without the ones that had errors.
+TEST(BerlekampWelch, DecodeToDroppingBadSpreadErrors) {
+	const int block = 64;
+	const int total = 8;
+	const int required = 4;
+	const int spread = 5;
+
+	BerlekampWelchTest test(required, total);
+	auto shares = test.SomeShares(block).second;
+
+	std::vector<std::pair<int, std::vector<uint8_t>>> corrupted(shares.begin(), shares.end());
+	std::vector<int> want_bad;
+	for (int i = 0; i < spread; ++i) {
+		test.MutateShare(i * block / spread, corrupted[i]);
+		want_bad.push_back(corrupted[i].first);
+	}
+
+	auto [decoded_shares, callback] = test.StoreShares();
+	ASSERT_EQ(test.DecodeToDroppingBad(corrupted, callback), want_bad);
+	auto shares_upto_k = shares;
+	for (int a = required; a < total; ++a) {
+		shares_upto_k.erase(a);
+	}
+	test.AssertEqualShares(shares_upto_k, *decoded_shares);
+}
+
+// A Cauchy code is corrected the same way, by way of its share weights.
+TEST(BerlekampWelch, Cauchy) {
+	const int block = 1024;
+	const int total = 12;
+	const int required = 5;
+
+	BerlekampWelchTest test(required, total, FEC::Matrix::Cauchy);
+	auto shares = test.SomeShares(block).second;
+	ASSERT_TRUE(test.Verify(shares));
+
+	std::vector<std::pair<int, std::vector<uint8_t>>> corrupted(shares.begin(), shares.end());
+	for (int i = 0; i < block; ++i) {
+		test.MutateShare(i, corrupted[random_env->randn(total)]);
+		test.MutateShare(i, corrupted[random_env->randn(total)]);
+		test.MutateShare(i, corrupted[random_env->randn(total)]);
+	}
+	ASSERT_FALSE(test.Verify(corrupted));
+	test.Correct(corrupted);
+	test.AssertEqualShares(shares, corrupted);
+
+	std::vector<std::pair<int, std::vector<uint8_t>>> bad_shares(shares.begin(), shares.end());
+	for (int i = 0; i < block; ++i) {
+		test.MutateShare(i, bad_shares[3]);
+		test.MutateShare(i, bad_shares[9]);
+	}
+	ASSERT_EQ(test.FindBadShares(bad_shares), (std::vector<int>{3, 9}));
+}
+
 // NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
 
 } // namespace infectious::test
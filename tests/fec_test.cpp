@@ -3,14 +3,23 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <map>
 #include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
 #include <utility>
 #include <vector>
 #include "gtest/gtest.h"
 
+#if defined(__unix__)
+#include <sys/mman.h>
+#endif
+
 #include "infectious/fec.hpp"
 #include "random_env.hpp"
+#include "tables.hpp"
 
 namespace infectious::test {
 
@@ -98,6 +107,469 @@ TEST(FEC, EncodeSingle) {
 	ASSERT_EQ(data, got) << "reconstructed data did not match";
 }
 
+TEST(FEC, EncodeParity) {
+	const size_t block = 200UL * 1024UL + 3;
+	const size_t total = 80;
+	const size_t required = 29;
+	const int byte_limit = 256;
+
+	FEC code(required, total);
+
+	std::vector<uint8_t> data(required*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> expected;
+	code.Encode(data, [&](int num, ByteView output_data) {
+		expected[num] = std::vector(output_data.begin(), output_data.end());
+	});
+
+	std::vector<std::vector<uint8_t>> parity(total - required, std::vector<uint8_t>(block));
+	std::vector<uint8_t*> parity_ptrs;
+	for (auto& p : parity) {
+		parity_ptrs.push_back(p.data());
+	}
+	code.EncodeParity(data, parity_ptrs);
+
+	for (size_t i = 0; i < parity.size(); ++i) {
+		ASSERT_EQ(parity[i], expected[static_cast<int>(required + i)]) << "parity share " << required + i;
+	}
+
+	parity_ptrs.pop_back();
+	ASSERT_THROW(code.EncodeParity(data, parity_ptrs), std::invalid_argument);
+}
+
+TEST(FEC, EncodeInto) {
+	const size_t block = 4099;
+	const size_t total = 12;
+	const size_t required = 5;
+	const int byte_limit = 256;
+
+	FEC code(required, total);
+
+	std::vector<uint8_t> data(required*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> expected;
+	code.Encode(data, [&](int num, ByteView output_data) {
+		expected[num] = std::vector(output_data.begin(), output_data.end());
+	});
+
+	// skip the even shares, data and parity alike.
+	std::vector<std::vector<uint8_t>> outputs(total, std::vector<uint8_t>(block));
+	std::vector<uint8_t*> output_ptrs;
+	for (size_t i = 0; i < total; ++i) {
+		output_ptrs.push_back(i % 2 == 0 ? nullptr : outputs[i].data());
+	}
+	code.EncodeInto(data, output_ptrs);
+
+	for (size_t i = 0; i < total; ++i) {
+		if (i % 2 == 0) {
+			ASSERT_EQ(outputs[i], std::vector<uint8_t>(block)) << "share " << i << " should be untouched";
+		} else {
+			ASSERT_EQ(outputs[i], expected[static_cast<int>(i)]) << "share " << i;
+		}
+	}
+
+	output_ptrs.pop_back();
+	ASSERT_THROW(code.EncodeInto(data, output_ptrs), std::invalid_argument);
+}
+
+TEST(FEC, EncodeIntoSegments) {
+	const size_t block = 4099;
+	const size_t total = 12;
+	const size_t required = 5;
+	const int byte_limit = 256;
+	const int max_segment = 700;
+
+	FEC code(required, total);
+
+	std::vector<uint8_t> data(required*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> expected;
+	code.Encode(data, [&](int num, ByteView output_data) {
+		expected[num] = std::vector(output_data.begin(), output_data.end());
+	});
+
+	// split every share into randomly sized segments, empty ones included,
+	// all carved out of one buffer per share.
+	std::vector<std::vector<uint8_t>> outputs(total, std::vector<uint8_t>(block));
+	std::vector<std::vector<std::span<uint8_t>>> segments(total);
+	for (size_t i = 0; i < total; ++i) {
+		size_t pos = 0;
+		while (pos < block) {
+			const size_t len = std::min(block - pos, static_cast<size_t>(random_env->randn(max_segment)));
+			segments[i].emplace_back(outputs[i].data() + pos, len);
+			pos += len;
+		}
+	}
+	std::vector<ShareSegments> shares(segments.begin(), segments.end());
+	shares[1] = {};
+	code.EncodeInto(data, shares);
+
+	for (size_t i = 0; i < total; ++i) {
+		if (i == 1) {
+			ASSERT_EQ(outputs[i], std::vector<uint8_t>(block)) << "share " << i << " should be untouched";
+		} else {
+			ASSERT_EQ(outputs[i], expected[static_cast<int>(i)]) << "share " << i;
+		}
+	}
+
+	segments[0].pop_back();
+	shares[0] = segments[0];
+	ASSERT_THROW(code.EncodeInto(data, shares), std::invalid_argument);
+}
+
+TEST(FEC, DecodeCache) {
+	const size_t block = 1000;
+	const size_t total = 10;
+	const size_t required = 4;
+	const int byte_limit = 256;
+
+	FEC code(required, total);
+	ASSERT_EQ(code.DecodeCacheStats().capacity, 0);
+	code.EnableDecodeCache(2);
+
+	std::vector<uint8_t> data(required*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> outputs;
+	code.Encode(data, [&](int num, ByteView output_data) {
+		outputs[num] = std::vector(output_data.begin(), output_data.end());
+	});
+
+	auto rebuild = [&](std::initializer_list<int> nums) {
+		std::map<int, std::vector<uint8_t>> shares;
+		for (auto num : nums) {
+			shares[num] = outputs[num];
+		}
+		std::vector<uint8_t> got(required*block);
+		code.Rebuild(shares, [&](int num, ByteView output_data) {
+			std::copy(output_data.begin(), output_data.end(), &got[static_cast<size_t>(num)*block]);
+		});
+		ASSERT_EQ(data, got) << "reconstructed data did not match";
+	};
+
+	rebuild({0, 3, 5, 9});
+	rebuild({0, 3, 5, 9});
+	rebuild({1, 2, 6, 7});
+	rebuild({0, 3, 5, 9});
+
+	auto stats = code.DecodeCacheStats();
+	ASSERT_EQ(stats.hits, 2);
+	ASSERT_EQ(stats.misses, 2);
+	ASSERT_EQ(stats.entries, 2);
+	ASSERT_EQ(stats.capacity, 2);
+
+	// {1, 2, 6, 7} is now the least recently used, and gets evicted.
+	rebuild({4, 5, 6, 7});
+	rebuild({0, 3, 5, 9});
+	rebuild({1, 2, 6, 7});
+
+	stats = code.DecodeCacheStats();
+	ASSERT_EQ(stats.hits, 3);
+	ASSERT_EQ(stats.misses, 4);
+	ASSERT_EQ(stats.entries, 2);
+
+	// with all the data shares there is nothing to invert and no lookup.
+	rebuild({0, 1, 2, 3});
+	ASSERT_EQ(code.DecodeCacheStats().misses, 4);
+
+	code.EnableDecodeCache(0);
+	ASSERT_EQ(code.DecodeCacheStats().entries, 0);
+	rebuild({0, 3, 5, 9});
+}
+
+struct InvertMatrixTest : public FEC {
+	using FEC::invertMatrix;
+};
+
+TEST(FEC, InvertMatrix) {
+	const int byte_limit = 256;
+	const int max_k = 12;
+	const int trials = 200;
+
+	for (int trial = 0; trial < trials; ++trial) {
+		const int k = 2 + random_env->randn(max_k - 1);
+
+		// an upper triangular matrix with ones on the diagonal is always
+		// invertible, and shuffling its rows moves the pivots off the
+		// diagonal.
+		std::vector<uint8_t> triangular(k*k);
+		for (int row = 0; row < k; ++row) {
+			triangular[row*k+row] = 1;
+			for (int col = row + 1; col < k; ++col) {
+				triangular[row*k+col] = static_cast<uint8_t>(random_env->randn(byte_limit));
+			}
+		}
+		std::vector<int> order(k);
+		for (int row = 0; row < k; ++row) {
+			order[row] = row;
+		}
+		for (int row = k - 1; row > 0; --row) {
+			std::swap(order[row], order[random_env->randn(row + 1)]);
+		}
+
+		std::vector<uint8_t> matrix(k*k);
+		for (int row = 0; row < k; ++row) {
+			std::copy_n(&triangular[order[row]*k], k, &matrix[row*k]);
+		}
+
+		auto inverse = matrix;
+		InvertMatrixTest::invertMatrix(inverse, k);
+
+		for (int row = 0; row < k; ++row) {
+			for (int col = 0; col < k; ++col) {
+				uint8_t acc = 0;
+				for (int i = 0; i < k; ++i) {
+					acc ^= gf_mul_table[matrix[row*k+i]][inverse[i*k+col]];
+				}
+				ASSERT_EQ(acc, row == col ? 1 : 0) << "k=" << k << " row=" << row << " col=" << col;
+			}
+		}
+	}
+}
+
+TEST(FEC, RebuildEverySubset) {
+	const size_t block = 64;
+	const int total = 9;
+	const int required = 4;
+	const int byte_limit = 256;
+
+	FEC code(required, total);
+
+	std::vector<uint8_t> data(required*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> outputs;
+	code.Encode(data, [&](int num, ByteView output_data) {
+		outputs[num] = std::vector(output_data.begin(), output_data.end());
+	});
+
+	for (unsigned mask = 0; mask < (1U << total); ++mask) {
+		if (std::popcount(mask) != required) {
+			continue;
+		}
+
+		std::map<int, std::vector<uint8_t>> shares;
+		for (int i = 0; i < total; ++i) {
+			if ((mask & (1U << i)) != 0) {
+				shares[i] = outputs[i];
+			}
+		}
+
+		std::vector<uint8_t> got(required*block);
+		code.Rebuild(shares, [&](int num, ByteView output_data) {
+			std::copy(output_data.begin(), output_data.end(), &got[static_cast<size_t>(num)*block]);
+		});
+		ASSERT_EQ(data, got) << "reconstructed data did not match for shares " << mask;
+	}
+}
+
+TEST(FEC, Cauchy) {
+	const size_t block = 300;
+	const int total = 10;
+	const int required = 6;
+	const int byte_limit = 256;
+
+	FEC code(required, total, FEC::Matrix::Cauchy);
+	ASSERT_EQ(code.EncodingMatrix(), FEC::Matrix::Cauchy);
+	ASSERT_EQ(FEC(required, total).EncodingMatrix(), FEC::Matrix::Vandermonde);
+
+	std::vector<uint8_t> data(required*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> outputs;
+	code.Encode(data, [&](int num, ByteView output_data) {
+		outputs[num] = std::vector(output_data.begin(), output_data.end());
+	});
+
+	// the first parity share is the XOR of the data pieces.
+	for (size_t i = 0; i < block; ++i) {
+		uint8_t x = 0;
+		for (int j = 0; j < required; ++j) {
+			x ^= data[j*block + i];
+		}
+		ASSERT_EQ(outputs[required][i], x) << "byte " << i;
+	}
+
+	// the parity differs from the Vandermonde code's, but every subset of
+	// the shares still rebuilds the data, through the closed form inverse
+	// and with the decode cache both off and on.
+	for (const size_t cache : {0, 8}) {
+		code.EnableDecodeCache(cache);
+		for (unsigned mask = 0; mask < (1U << total); ++mask) {
+			if (std::popcount(mask) != required) {
+				continue;
+			}
+
+			std::map<int, std::vector<uint8_t>> shares;
+			for (int i = 0; i < total; ++i) {
+				if ((mask & (1U << i)) != 0) {
+					shares[i] = outputs[i];
+				}
+			}
+
+			std::vector<uint8_t> got(required*block);
+			code.Rebuild(shares, [&](int num, ByteView output_data) {
+				std::copy(output_data.begin(), output_data.end(), &got[static_cast<size_t>(num)*block]);
+			});
+			ASSERT_EQ(data, got) << "reconstructed data did not match for shares " << mask;
+		}
+	}
+
+	// the same holds with the XOR-only kernels, at the largest k.
+	set_addmul_provider("xor");
+	FEC wide(FEC::byte_max - 4, FEC::byte_max, FEC::Matrix::Cauchy);
+	std::vector<uint8_t> wide_data(static_cast<size_t>(wide.Required()) * 64);
+	for (auto& b : wide_data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+	std::map<int, std::vector<uint8_t>> wide_shares;
+	wide.Encode(wide_data, [&](int num, ByteView output_data) {
+		if (num % 64 != 1) {
+			wide_shares[num] = std::vector(output_data.begin(), output_data.end());
+		}
+	});
+	set_addmul_provider("auto");
+	std::vector<uint8_t> wide_got(wide_data.size());
+	wide.Rebuild(wide_shares, [&](int num, ByteView output_data) {
+		std::copy(output_data.begin(), output_data.end(), &wide_got[static_cast<size_t>(num)*64]);
+	});
+	ASSERT_EQ(wide_data, wide_got);
+}
+
+TEST(FEC, RebuildRange) {
+	const size_t block = 5000;
+	const int total = 8;
+	const int required = 4;
+	const int byte_limit = 256;
+
+	FEC code(required, total);
+	code.EnableDecodeCache(2);
+
+	std::vector<uint8_t> data(required*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> outputs;
+	code.Encode(data, [&](int num, ByteView output_data) {
+		outputs[num] = std::vector(output_data.begin(), output_data.end());
+	});
+
+	for (const auto& nums : std::vector<std::vector<int>> {{0, 1, 2, 3}, {1, 3, 5, 6}, {4, 5, 6, 7}, {0, 2, 4, 5, 6, 7}}) {
+		std::map<int, ByteView> shares;
+		for (auto num : nums) {
+			shares.try_emplace(num, outputs[num].data(), block);
+		}
+
+		for (int i = 0; i < 20; i++) {
+			const auto offset = static_cast<size_t>(random_env->randn(static_cast<int>(block)));
+			const auto length = static_cast<size_t>(random_env->randn(static_cast<int>(block - offset) + 1));
+			const std::vector<int> wanted {static_cast<int>(random_env->randn(required)), required - 1};
+
+			std::vector<int> seen;
+			code.RebuildRange(shares, offset, length, wanted, [&](int num, ByteView output_data) {
+				seen.push_back(num);
+				ASSERT_EQ(output_data, ByteView(&data[static_cast<size_t>(num)*block + offset], length));
+			});
+			ASSERT_EQ(seen, wanted);
+		}
+
+		// with nothing wanted in particular, every data piece is rebuilt.
+		std::vector<int> seen;
+		code.RebuildRange(shares, block - 10, 10, {}, [&](int num, ByteView output_data) {
+			seen.push_back(num);
+			ASSERT_EQ(output_data, ByteView(&data[static_cast<size_t>(num + 1)*block - 10], 10));
+		});
+		ASSERT_EQ(seen, (std::vector<int> {0, 1, 2, 3}));
+
+		ASSERT_THROW(code.RebuildRange(shares, block - 10, 11, {}, [](int, ByteView) {}), std::invalid_argument);
+		const std::vector<int> bad {required};
+		ASSERT_THROW(code.RebuildRange(shares, 0, 1, bad, [](int, ByteView) {}), std::invalid_argument);
+	}
+
+	// each set of shares with a data piece missing inverted once, however
+	// many ranges were rebuilt from it.
+	ASSERT_EQ(code.DecodeCacheStats().misses, 3);
+}
+
+TEST(FEC, Batch) {
+	const size_t stripes = 50;
+	const size_t block = 1024;
+	const int total = 8;
+	const int required = 4;
+	const int byte_limit = 256;
+
+	FEC code(required, total);
+
+	std::vector<uint8_t> data(stripes*required*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::vector<ByteView> inputs;
+	for (size_t s = 0; s < stripes; ++s) {
+		inputs.emplace_back(&data[s*required*block], required*block);
+	}
+
+	std::vector<uint8_t> parity(stripes*(total-required)*block);
+	std::vector<uint8_t*> parity_ptrs;
+	for (size_t i = 0; i < stripes*(total-required); ++i) {
+		parity_ptrs.push_back(&parity[i*block]);
+	}
+	code.EncodeBatch(inputs, parity_ptrs);
+
+	for (size_t s = 0; s < stripes; ++s) {
+		code.Encode(inputs[s], [&](int num, ByteView output) {
+			if (num >= required) {
+				ASSERT_EQ(output, ByteView(&parity[(s*(total-required) + num-required)*block], block)) << "stripe " << s << " share " << num;
+			}
+		});
+	}
+
+	// rebuild from two data shares and two parity shares, in no particular
+	// order.
+	const std::vector<int> nums {6, 1, 4, 2};
+	std::vector<const uint8_t*> shares;
+	for (size_t s = 0; s < stripes; ++s) {
+		for (auto num : nums) {
+			if (num < required) {
+				shares.push_back(inputs[s].data() + num*block);
+			} else {
+				shares.push_back(parity_ptrs[s*(total-required) + num-required]);
+			}
+		}
+	}
+
+	std::vector<uint8_t> got(data.size());
+	std::vector<uint8_t*> outputs;
+	for (size_t s = 0; s < stripes; ++s) {
+		outputs.push_back(&got[s*required*block]);
+	}
+	code.EnableDecodeCache(1);
+	code.RebuildBatch(nums, shares, block, outputs);
+	ASSERT_EQ(got, data);
+	ASSERT_EQ(code.DecodeCacheStats().misses, 1);
+
+	ASSERT_THROW(code.RebuildBatch(std::vector<int>{6, 1, 4, 4}, shares, block, outputs), std::invalid_argument);
+	parity_ptrs.pop_back();
+	ASSERT_THROW(code.EncodeBatch(inputs, parity_ptrs), std::invalid_argument);
+}
+
 // NoCopyBytes is a class holding a byte string which should only be copyable
 // using explicit calls to its begin() and end() methods.
 class NoCopyBytes {
@@ -201,6 +673,198 @@ TEST(FEC, NoImplicitCopies) {
 	ASSERT_EQ(input_data, decode_result);
 }
 
+// FEC::Get hands every thread the same const instance, which they can all
+// decode with at once.
+TEST(FEC, Registry) {
+	const int required = 5;
+	const int total = 9;
+	const size_t block = 512;
+	const size_t threads = 8;
+
+	ASSERT_THROW(static_cast<void>(FEC::Get(0, 4)), std::domain_error);
+	ASSERT_THROW(static_cast<void>(FEC::Get(5, 4)), std::domain_error);
+
+	std::vector<uint8_t> data(required * block);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = static_cast<uint8_t>(i ^ (i >> 8));
+	}
+
+	std::vector<std::shared_ptr<const FEC>> seen(threads);
+	std::vector<int> decoded(threads, 0);
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t] {
+			const auto fec = FEC::Get(required, total);
+			seen[t] = fec;
+
+			std::map<int, std::vector<uint8_t>> shares;
+			fec->Encode(data, [&](int num, ByteView share) {
+				// drop a different pair of shares on each thread, and
+				// corrupt one of the rest.
+				if (num != static_cast<int>(t % total) && num != static_cast<int>((t + 3) % total)) {
+					shares[num].assign(share.begin(), share.end());
+				}
+			});
+			shares.begin()->second[t] ^= 0xFF;
+
+			std::vector<uint8_t> out(data.size());
+			fec->Decode(shares, out);
+			decoded[t] = out == data ? 1 : 0;
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	for (size_t t = 0; t < threads; ++t) {
+		ASSERT_EQ(seen[t], seen[0]);
+		ASSERT_EQ(decoded[t], 1) << "thread " << t;
+	}
+	ASSERT_EQ(FEC::Get(required, total), seen[0]);
+	ASSERT_NE(FEC::Get(required, total + 1), seen[0]);
+	ASSERT_GT(seen[0]->DecodeCacheStats().capacity, 0);
+}
+
+TEST(FEC, DecodeViews) {
+	const int required = 4;
+	const int total = 8;
+	const size_t block = 300;
+
+	const FEC fec(required, total);
+	std::vector<uint8_t> data(required * block);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = static_cast<uint8_t>(i * 31);
+	}
+
+	// shares in an unsorted container, out of order.
+	std::vector<std::pair<int, std::vector<uint8_t>>> shares;
+	fec.Encode(data, [&](int num, ByteView share) {
+		shares.emplace_back(num, std::vector<uint8_t>(share.begin(), share.end()));
+	});
+	std::reverse(shares.begin(), shares.end());
+
+	auto concat = [](std::span<const ByteView> pieces) {
+		std::vector<uint8_t> out;
+		for (auto piece : pieces) {
+			out.insert(out.end(), piece.begin(), piece.end());
+		}
+		return out;
+	};
+
+	// with every data share there, the views are of the shares themselves,
+	// after correction, and no scratch space is needed.
+	std::vector<ByteView> pieces(required);
+	shares[1].second[7] ^= 0x10;
+	fec.DecodeViews(shares, pieces, {});
+	ASSERT_EQ(concat(pieces), data);
+	for (const auto& [num, share] : shares) {
+		if (num < required) {
+			ASSERT_EQ(pieces[num].data(), share.data());
+		}
+	}
+
+	// with two data shares missing, those two are rebuilt into scratch.
+	std::erase_if(shares, [](const auto& share) { return share.first == 1 || share.first == 2; });
+	std::vector<uint8_t> scratch(2 * block);
+	ASSERT_THROW(fec.DecodeViews(shares, pieces, std::span(scratch).first(block)), std::invalid_argument);
+	fec.DecodeViews(shares, pieces, scratch);
+	ASSERT_EQ(concat(pieces), data);
+	ASSERT_EQ(pieces[1].data(), scratch.data());
+	ASSERT_EQ(pieces[2].data(), scratch.data() + block);
+
+	std::vector<ByteView> too_few(required - 1);
+	ASSERT_THROW(fec.DecodeViews(shares, too_few, scratch), std::invalid_argument);
+}
+
+#if defined(__unix__)
+// Mapping is an anonymous, never reserved mapping, which reads as zeros and
+// only takes memory for the pages that are written to.
+class Mapping {
+public:
+	explicit Mapping(size_t size_)
+		: size {size_}
+		, mem {mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)}
+	{}
+
+	Mapping(const Mapping&) = delete;
+	Mapping(Mapping&&) = delete;
+	auto operator=(const Mapping&) -> Mapping& = delete;
+	auto operator=(Mapping&&) -> Mapping& = delete;
+	~Mapping() {
+		if (ok()) {
+			munmap(mem, size);
+		}
+	}
+
+	[[nodiscard]] auto ok() const -> bool { return mem != MAP_FAILED; }
+	[[nodiscard]] auto data() const -> uint8_t* { return static_cast<uint8_t*>(mem); }
+
+private:
+	size_t size;
+	void* mem;
+};
+
+// Sizes past 2 GiB used to overflow. Each share here is just over 2 GiB, and
+// all but a few sampled columns of it are zero, so the kernels go through
+// every byte while only the parity, or the rebuilt piece, takes memory.
+TEST(FEC, LargeSizes) {
+	const int required = 2;
+	const int total = 3;
+	const size_t block = (1UL << 31) + 65;
+	const std::array<size_t, 5> samples {0, (1UL << 31) - 1, 1UL << 31, block - 33, block - 1};
+	const int byte_limit = 256;
+
+	FEC fec(required, total);
+
+	Mapping input(required * block);
+	if (!input.ok()) {
+		GTEST_SKIP() << "could not map " << required * block << " bytes";
+	}
+
+	// for each sampled column, some data bytes and the parity they encode to.
+	std::array<std::array<uint8_t, total>, samples.size()> columns {};
+	for (size_t i = 0; i < samples.size(); ++i) {
+		auto& column = columns[i];
+		for (int num = 0; num < required; ++num) {
+			column[num] = static_cast<uint8_t>(1 + random_env->randn(byte_limit - 1));
+			input.data()[num*block + samples[i]] = column[num];
+		}
+		fec.EncodeParity(ByteView(column.data(), required), std::array {&column[required]});
+	}
+
+	{
+		Mapping parity(block);
+		ASSERT_TRUE(parity.ok());
+		fec.EncodeParity(ByteView(input.data(), required * block), std::array {parity.data()});
+		for (size_t i = 0; i < samples.size(); ++i) {
+			ASSERT_EQ(parity.data()[samples[i]], columns[i][required]) << "at " << samples[i];
+		}
+	}
+
+	// rebuild data piece 0 from piece 1 and a parity share holding just the
+	// sampled columns, which is all there is to the parity of this input.
+	Mapping parity(block);
+	ASSERT_TRUE(parity.ok());
+	for (size_t i = 0; i < samples.size(); ++i) {
+		parity.data()[samples[i]] = columns[i][required];
+	}
+
+	std::map<int, ByteView> shares;
+	shares.try_emplace(1, input.data() + block, block);
+	shares.try_emplace(2, parity.data(), block);
+
+	int rebuilt = 0;
+	fec.RebuildSorted(shares, [&](int num, ByteView data) {
+		ASSERT_EQ(data.size(), block);
+		for (size_t i = 0; i < samples.size(); ++i) {
+			ASSERT_EQ(data[samples[i]], columns[i][num]) << "piece " << num << " at " << samples[i];
+		}
+		++rebuilt;
+	});
+	ASSERT_EQ(rebuilt, required);
+}
+#endif
+
 // NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
 
 } // namespace infectious::test
@@ -0,0 +1,156 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "infectious/fec.hpp"
+#include "infectious/file.hpp"
+#include "random_env.hpp"
+
+#if defined(INFECTIOUS_TARGET_OS_HAS_POSIX1)
+
+namespace infectious::test {
+
+// clang-tidy doesn't much care for gtest's macros.
+// NOLINTBEGIN(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+namespace {
+
+// TempDir is a directory that is removed, along with everything in it, when
+// it goes out of scope.
+class TempDir {
+public:
+	TempDir()
+		: path {std::filesystem::temp_directory_path() / ("infectious-test-" + std::to_string(random_env->randn(1 << 30)))}
+	{
+		std::filesystem::create_directories(path);
+	}
+	TempDir(const TempDir&) = delete;
+	TempDir(TempDir&&) = delete;
+	auto operator=(const TempDir&) -> TempDir& = delete;
+	auto operator=(TempDir&&) -> TempDir& = delete;
+	~TempDir() {
+		std::filesystem::remove_all(path);
+	}
+
+	[[nodiscard]] auto File(const std::string& name) const -> std::string {
+		return (path / name).string();
+	}
+
+private:
+	std::filesystem::path path;
+};
+
+auto read_file(const std::string& path) -> std::vector<uint8_t> {
+	std::ifstream in(path, std::ios::binary);
+	return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+void write_file(const std::string& path, const std::vector<uint8_t>& data) {
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+}
+
+} // namespace
+
+TEST(File, RoundTrip) {
+	const int required = 4;
+	const int total = 7;
+	const int byte_limit = 256;
+	FEC fec(required, total);
+	const TempDir dir;
+
+	for (const size_t size : {0, 1, 3, 4000, 4003, 100001}) {
+		std::vector<uint8_t> data(size);
+		for (auto& b : data) {
+			b = static_cast<uint8_t>(random_env->randn(byte_limit));
+		}
+		write_file(dir.File("input"), data);
+
+		std::vector<std::string> share_paths;
+		for (int i = 0; i < total; i++) {
+			share_paths.push_back(dir.File("share" + std::to_string(i)));
+		}
+		ASSERT_EQ(EncodeFile(fec, dir.File("input"), share_paths), size);
+
+		// the shares are those of the data padded out to a multiple of k.
+		auto padded = data;
+		padded.resize((size + required - 1) / required * required);
+		std::map<int, std::vector<uint8_t>> expected;
+		fec.Encode(padded, [&](int num, ByteView piece) {
+			expected[num] = std::vector<uint8_t>(piece.begin(), piece.end());
+		});
+		for (int i = 0; i < total; i++) {
+			ASSERT_EQ(read_file(share_paths[i]), expected[i]) << "size " << size << " share " << i;
+		}
+
+		// rebuild from just the last k shares.
+		std::map<int, std::string> last;
+		for (int i = total - required; i < total; i++) {
+			last.try_emplace(i, share_paths[i]);
+		}
+		DecodeFile(fec, last, dir.File("output"), size);
+		ASSERT_EQ(read_file(dir.File("output")), data) << "size " << size;
+
+		if (size == 0) {
+			continue;
+		}
+
+		// correct a corrupted share, without changing its file.
+		auto corrupted = read_file(share_paths[1]);
+		corrupted[0] ^= 0x5a;
+		write_file(share_paths[1], corrupted);
+		std::map<int, std::string> all;
+		for (int i = 0; i < total; i++) {
+			all.try_emplace(i, share_paths[i]);
+		}
+		DecodeFile(fec, all, dir.File("output"), size);
+		ASSERT_EQ(read_file(dir.File("output")), data) << "size " << size;
+		ASSERT_EQ(read_file(share_paths[1]), corrupted);
+	}
+}
+
+TEST(File, SkippedShares) {
+	const int required = 3;
+	const int total = 5;
+	const int byte_limit = 256;
+	const FEC fec(required, total);
+	const TempDir dir;
+
+	// skipping the data share cut short by padding needs the padded copy.
+	std::vector<uint8_t> data(1000);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+	write_file(dir.File("input"), data);
+
+	std::vector<std::string> share_paths(total);
+	share_paths[0] = dir.File("share0");
+	share_paths[4] = dir.File("share4");
+	ASSERT_EQ(EncodeFile(fec, dir.File("input"), share_paths), data.size());
+	ASSERT_FALSE(std::filesystem::exists(dir.File("share2")));
+
+	auto padded = data;
+	padded.resize(1002);
+	std::map<int, std::vector<uint8_t>> expected;
+	fec.Encode(padded, [&](int num, ByteView piece) {
+		expected[num] = std::vector<uint8_t>(piece.begin(), piece.end());
+	});
+	ASSERT_EQ(read_file(share_paths[0]), expected[0]);
+	ASSERT_EQ(read_file(share_paths[4]), expected[4]);
+
+	ASSERT_THROW(EncodeFile(fec, dir.File("input"), std::vector<std::string>(total - 1)), std::invalid_argument);
+	ASSERT_THROW(EncodeFile(fec, dir.File("missing"), share_paths), std::system_error);
+}
+
+// NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+} // namespace infectious::test
+
+#endif // INFECTIOUS_TARGET_OS_HAS_POSIX1
@@ -0,0 +1,65 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <map>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "infectious/fec.hpp"
+#include "infectious/fixed_fec.hpp"
+#include "random_env.hpp"
+
+namespace infectious::test {
+
+// clang-tidy doesn't much care for gtest's macros.
+// NOLINTBEGIN(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+template <int K, int N>
+void check_matches_runtime(size_t block) {
+	const int byte_limit = 256;
+	FEC fec(K, N);
+	using Fixed = FixedFEC<K, N>;
+
+	std::vector<uint8_t> data(K*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+	ByteView input(data.data(), data.size());
+
+	std::map<int, std::vector<uint8_t>> expected;
+	fec.Encode(input, [&](int num, ByteView output) {
+		expected[num] = std::vector(output.begin(), output.end());
+	});
+
+	std::vector<uint8_t> parity_buf((N - K) * block);
+	std::map<int, std::vector<uint8_t>> got;
+	Fixed::Encode(input, parity_buf, [&](int num, ByteView output) {
+		got[num] = std::vector(output.begin(), output.end());
+	});
+	ASSERT_EQ(got, expected) << K << "/" << N;
+
+	for (int i = 0; i < N; ++i) {
+		std::vector<uint8_t> out(block);
+		Fixed::EncodeSingle(i, input, out.data());
+		ASSERT_EQ(out, expected[i]) << K << "/" << N << " share " << i;
+	}
+}
+
+TEST(FixedFEC, MatchesRuntime) {
+	check_matches_runtime<1, 1>(100);
+	check_matches_runtime<1, 3>(100);
+	check_matches_runtime<4, 8>(1000);
+	check_matches_runtime<29, 80>(333);
+	check_matches_runtime<20, 40>(4096);
+}
+
+TEST(FixedFEC, CompileTime) {
+	// the matrix really is available at compile time.
+	static_assert(FixedFEC<4, 8>::Matrix()[0] == 1);
+	static_assert(FixedFEC<4, 8>::Matrix()[1] == 0);
+	static_assert(FixedFEC<4, 8>::Total() == 8);
+}
+
+// NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+} // namespace infectious::test
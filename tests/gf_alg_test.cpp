@@ -27,6 +27,30 @@ TEST(GaloisFieldMath, PolynomialDivision) {
 	(void) q.div(e);
 }
 
+TEST(GaloisFieldMath, Pow) {
+	for (int x = 0; x < FEC::byte_max; x++) {
+		uint8_t want = 1;
+		for (int val = 0; val < 2 * FEC::byte_max; val++) {
+			ASSERT_EQ(gf_pow(static_cast<uint8_t>(x), val), want) << x << "^" << val;
+			want = gf_mul(want, static_cast<uint8_t>(x));
+		}
+	}
+}
+
+TEST(GaloisFieldMath, PolynomialEval) {
+	// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+	const GFPoly p({0x5e, 0x60, 0x8c, 0x3d, 0xc6, 0x00, 0x7e});
+	// NOLINTEND(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+	for (int x = 0; x < FEC::byte_max; x++) {
+		uint8_t want = 0;
+		for (int i = 0; i <= p.deg(); i++) {
+			want = gf_add(want, gf_mul(p.index(i), gf_pow(static_cast<uint8_t>(x), i)));
+		}
+		ASSERT_EQ(p.eval(static_cast<uint8_t>(x)), want) << x;
+	}
+}
+
 // NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
 
 } // namespace infectious::test
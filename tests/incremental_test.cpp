@@ -0,0 +1,168 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "infectious/fec.hpp"
+#include "infectious/incremental.hpp"
+#include "random_env.hpp"
+
+namespace infectious::test {
+
+// clang-tidy doesn't much care for gtest's macros.
+// NOLINTBEGIN(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+namespace {
+
+struct Encoded {
+	std::vector<uint8_t> data;
+	std::map<int, std::vector<uint8_t>> shares;
+};
+
+auto encode(const FEC& fec, size_t block) -> Encoded {
+	const int byte_limit = 256;
+	Encoded e;
+	e.data.resize(block * fec.Required());
+	for (auto& b : e.data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+	fec.Encode(e.data, [&](int num, ByteView piece) {
+		e.shares[num] = std::vector(piece.begin(), piece.end());
+	});
+	return e;
+}
+
+auto collect(size_t block, std::vector<uint8_t>& got) -> ShareOutputFunc {
+	return [&got, block](int num, ByteView piece) {
+		ASSERT_EQ(piece.size(), block);
+		std::copy(piece.begin(), piece.end(), got.begin() + static_cast<ptrdiff_t>(static_cast<size_t>(num) * block));
+	};
+}
+
+} // namespace
+
+TEST(IncrementalDecoder, RandomArrival) {
+	const size_t block = 777;
+	const int total = 10;
+	const int required = 4;
+	const FEC fec(required, total);
+	const auto e = encode(fec, block);
+
+	for (int trial = 0; trial < 50; trial++) {
+		std::vector<int> order(total);
+		std::iota(order.begin(), order.end(), 0);
+		for (int i = total - 1; i > 0; i--) {
+			std::swap(order[i], order[random_env->randn(i + 1)]);
+		}
+
+		// every share but the last to complete is written in a few chunks,
+		// interleaved with the others.
+		IncrementalDecoder decoder(fec, block);
+		std::map<int, size_t> written;
+		for (int i = 0; i < required; i++) {
+			written[order[i]] = 0;
+		}
+		while (!decoder.Ready()) {
+			ASSERT_THROW(decoder.Finish([](int, ByteView) {}), NotEnoughShares);
+			const int num = order[random_env->randn(required)];
+			auto& pos = written[num];
+			const auto len = std::min(block - pos, static_cast<size_t>(1 + random_env->randn(static_cast<int>(block / 2))));
+			decoder.Write(num, ByteView(&e.shares.at(num)[pos], len));
+			pos += len;
+		}
+		ASSERT_EQ(decoder.Complete(), required);
+
+		std::vector<uint8_t> got(e.data.size());
+		decoder.Finish(collect(block, got));
+		ASSERT_EQ(got, e.data) << "trial " << trial;
+	}
+}
+
+TEST(IncrementalDecoder, DecodesPerChunk) {
+	const size_t block = 777;
+	const int total = 10;
+	const int required = 4;
+	const FEC fec(required, total);
+	const auto e = encode(fec, block);
+
+	for (int trial = 0; trial < 50; trial++) {
+		// every share arrives in small chunks, interleaved, so data shares
+		// are often part way in when their pieces are decoded, and the
+		// shares decoded from change as the leaders do.
+		IncrementalDecoder decoder(fec, block);
+		std::vector<size_t> written(total);
+		while (!decoder.Ready()) {
+			const int num = random_env->randn(total);
+			auto& pos = written[num];
+			const auto len = std::min(block - pos, static_cast<size_t>(1 + random_env->randn(static_cast<int>(block / 8))));
+			decoder.Write(num, ByteView(&e.shares.at(num)[pos], len));
+			pos += len;
+
+			auto sorted = written;
+			std::sort(sorted.begin(), sorted.end(), std::greater<>());
+			ASSERT_EQ(decoder.Decoded(), sorted[required - 1]);
+		}
+		ASSERT_EQ(decoder.Decoded(), block);
+
+		std::vector<uint8_t> got(e.data.size());
+		decoder.Finish(collect(block, got));
+		ASSERT_EQ(got, e.data) << "trial " << trial;
+
+		// the shares still arriving are kept too.
+		for (int num = 0; num < total; num++) {
+			decoder.Write(num, ByteView(&e.shares.at(num)[written[num]], block - written[num]));
+		}
+		ASSERT_EQ(decoder.Complete(), total);
+		std::fill(got.begin(), got.end(), 0);
+		decoder.FinishCorrected(collect(block, got));
+		ASSERT_EQ(got, e.data) << "trial " << trial;
+	}
+}
+
+TEST(IncrementalDecoder, Corrected) {
+	const size_t block = 500;
+	const int total = 8;
+	const int required = 3;
+	const FEC fec(required, total);
+	const auto e = encode(fec, block);
+
+	// one of the first shares to arrive is corrupt, which Finish trusts but
+	// FinishCorrected does not, given enough shares to check it against.
+	IncrementalDecoder decoder(fec, block);
+	auto bad = e.shares.at(5);
+	bad[17] ^= 0x5a;
+	decoder.Write(5, ByteView(bad.data(), bad.size()));
+	for (const int num : {1, 7, 0, 6}) {
+		decoder.Write(num, ByteView(e.shares.at(num).data(), block));
+	}
+	ASSERT_TRUE(decoder.Ready());
+	ASSERT_EQ(decoder.Complete(), 5);
+
+	std::vector<uint8_t> got(e.data.size());
+	decoder.Finish(collect(block, got));
+	ASSERT_NE(got, e.data);
+
+	decoder.FinishCorrected(collect(block, got));
+	ASSERT_EQ(got, e.data);
+
+	// with nothing wrong, FinishCorrected is just Finish.
+	IncrementalDecoder clean(fec, block);
+	for (const int num : {2, 3, 4, 5}) {
+		clean.Write(num, ByteView(e.shares.at(num).data(), block));
+	}
+	std::fill(got.begin(), got.end(), 0);
+	clean.FinishCorrected(collect(block, got));
+	ASSERT_EQ(got, e.data);
+
+	ASSERT_THROW(clean.Write(2, ByteView(e.shares.at(2).data(), 1)), std::invalid_argument);
+	ASSERT_THROW(clean.Write(total, ByteView(e.shares.at(2).data(), 1)), std::invalid_argument);
+}
+
+// NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+} // namespace infectious::test
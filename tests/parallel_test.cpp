@@ -0,0 +1,123 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "infectious/executor.hpp"
+#include "infectious/fec.hpp"
+#include "random_env.hpp"
+
+namespace infectious::test {
+
+// clang-tidy doesn't much care for gtest's macros.
+// NOLINTBEGIN(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+TEST(ThreadPool, ParallelFor) {
+	const size_t count = 1000;
+	ThreadPool pool(4);
+	ASSERT_EQ(pool.Threads(), 4);
+
+	std::vector<std::atomic<int>> seen(count);
+	pool.ParallelFor(count, [&](size_t i) {
+		seen[i].fetch_add(1);
+	});
+	for (size_t i = 0; i < count; ++i) {
+		ASSERT_EQ(seen[i].load(), 1) << "index " << i;
+	}
+
+	// nested calls must not deadlock, even with every worker busy.
+	std::atomic<size_t> total {0};
+	pool.ParallelFor(8, [&](size_t) {
+		pool.ParallelFor(8, [&](size_t) {
+			total.fetch_add(1);
+		});
+	});
+	ASSERT_EQ(total.load(), 64);
+}
+
+TEST(ThreadPool, Exceptions) {
+	ThreadPool pool(2);
+	std::atomic<size_t> calls {0};
+	ASSERT_THROW(pool.ParallelFor(100, [&](size_t i) {
+		calls.fetch_add(1);
+		if (i == 17) {
+			throw std::runtime_error("boom");
+		}
+	}), std::runtime_error);
+	ASSERT_EQ(calls.load(), 100);
+}
+
+// With a tiny chunk size everything gets split up as finely as it can be,
+// and must still agree with doing it all on one thread.
+TEST(FEC, ParallelMatchesSerial) {
+	const size_t block = 10000;
+	const int total = 12;
+	const int required = 5;
+	const int byte_limit = 256;
+	const size_t chunk = 100;
+
+	FEC serial(required, total);
+	FEC parallel(required, total);
+	parallel.SetExecutor(std::make_shared<ThreadPool>(3), chunk);
+
+	std::vector<uint8_t> data(required*block);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> expected;
+	serial.Encode(data, [&](int num, ByteView output) {
+		expected[num] = std::vector(output.begin(), output.end());
+	});
+
+	std::map<int, std::vector<uint8_t>> shares;
+	parallel.Encode(data, [&](int num, ByteView output) {
+		shares[num] = std::vector(output.begin(), output.end());
+	});
+	ASSERT_EQ(shares, expected);
+
+	for (int i = 0; i < total; ++i) {
+		std::vector<uint8_t> out(block);
+		parallel.EncodeSingle(i, data.begin(), data.end(), out.begin(), out.end());
+		ASSERT_EQ(out, expected[i]) << "share " << i;
+	}
+
+	std::vector<std::vector<uint8_t>> parity(total - required, std::vector<uint8_t>(block));
+	std::vector<uint8_t*> parity_ptrs;
+	for (auto& p : parity) {
+		parity_ptrs.push_back(p.data());
+	}
+	parallel.EncodeParity(data, parity_ptrs);
+	for (int i = required; i < total; ++i) {
+		ASSERT_EQ(parity[i - required], expected[i]) << "share " << i;
+	}
+
+	// rebuild from the parity shares alone.
+	std::map<int, std::vector<uint8_t>> parity_shares(shares.find(total - required), shares.end());
+	std::vector<uint8_t> got(data.size());
+	parallel.Rebuild(parity_shares, [&](int num, ByteView output) {
+		std::copy(output.begin(), output.end(), got.begin() + static_cast<ptrdiff_t>(num*block));
+	});
+	ASSERT_EQ(got, data);
+
+	// and correct errors scattered over every chunk.
+	ASSERT_TRUE(parallel.Verify(shares));
+	auto corrupted = shares;
+	for (size_t i = 0; i < block; i += chunk / 3) {
+		corrupted[static_cast<int>(i % total)][i] ^= 1;
+		corrupted[static_cast<int>((i + 1) % total)][i] ^= 2;
+	}
+	ASSERT_FALSE(parallel.Verify(corrupted));
+	parallel.Correct(corrupted);
+	ASSERT_EQ(corrupted, expected);
+}
+
+// NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+} // namespace infectious::test
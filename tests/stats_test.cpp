@@ -0,0 +1,124 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <map>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "infectious/fec.hpp"
+#include "infectious/stats.hpp"
+
+namespace infectious::test {
+
+// clang-tidy doesn't much care for gtest's macros.
+// NOLINTBEGIN(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+namespace {
+
+auto encode_all(const FEC& fec, const std::vector<uint8_t>& data) -> std::map<int, std::vector<uint8_t>> {
+	std::map<int, std::vector<uint8_t>> shares;
+	fec.Encode(data, [&](int num, ByteView share) {
+		shares[num].assign(share.begin(), share.end());
+	});
+	return shares;
+}
+
+} // namespace
+
+TEST(Stats, Counts) {
+	const int required = 4;
+	const int total = 8;
+	const size_t block = 1000;
+
+	FEC fec(required, total);
+	fec.EnableDecodeCache(4);
+	std::vector<uint8_t> data(required * block);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = static_cast<uint8_t>(i * 7);
+	}
+
+	ResetStats();
+	auto shares = encode_all(fec, data);
+
+	if constexpr (!stats_enabled) {
+		const auto stats = GetStats();
+		ASSERT_EQ(stats.bytes_encoded, 0);
+		ASSERT_EQ(stats.encode_time.count(), 0);
+		return;
+	}
+
+	ASSERT_EQ(GetStats().bytes_encoded, data.size());
+	ASSERT_GT(GetStats().encode_time.count(), 0);
+
+	// a clean set of shares only needs the syndrome check.
+	fec.Correct(shares);
+	auto stats = GetStats();
+	ASSERT_EQ(stats.syndrome_clean, 1);
+	ASSERT_EQ(stats.syndrome_dirty, 0);
+	ASSERT_EQ(stats.berlekamp_welch_runs, 0);
+	ASSERT_EQ(stats.bytes_corrected, 0);
+
+	// two corrupt positions in different shares.
+	auto corrupted = shares;
+	corrupted[1][10] ^= 0x55;
+	corrupted[6][500] ^= 0x01;
+	fec.Correct(corrupted);
+	ASSERT_EQ(corrupted, shares);
+	stats = GetStats();
+	ASSERT_EQ(stats.syndrome_dirty, 1);
+	ASSERT_EQ(stats.bytes_corrected, 2);
+	ASSERT_GE(stats.berlekamp_welch_runs, 1);
+	ASSERT_GT(stats.correct_time.count(), 0);
+
+	// rebuilding without two of the data shares inverts a matrix the first
+	// time, and finds it in the cache the second.
+	auto partial = shares;
+	partial.erase(0);
+	partial.erase(2);
+	const auto inversions = stats.matrix_inversions;
+	for (int i = 0; i < 2; ++i) {
+		fec.Rebuild(partial, [](int, ByteView) {});
+	}
+	stats = GetStats();
+	ASSERT_EQ(stats.bytes_rebuilt, 2 * data.size());
+	ASSERT_EQ(stats.matrix_inversions, inversions + 1);
+	ASSERT_EQ(stats.decode_cache_hits, 1);
+	ASSERT_GT(stats.rebuild_time.count(), 0);
+
+	ResetStats();
+	stats = GetStats();
+	ASSERT_EQ(stats.bytes_encoded, 0);
+	ASSERT_EQ(stats.bytes_rebuilt, 0);
+	ASSERT_EQ(stats.rebuild_time.count(), 0);
+}
+
+TEST(Stats, Threads) {
+	const int required = 3;
+	const int total = 6;
+	const size_t threads = 8;
+	const size_t rounds = 100;
+
+	const FEC fec(required, total);
+	const std::vector<uint8_t> data(required * 64, 0xA5);
+
+	ResetStats();
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&] {
+			for (size_t r = 0; r < rounds; ++r) {
+				std::vector<uint8_t> out(data.size() / required);
+				fec.EncodeSingle(total - 1, data.begin(), data.end(), out.begin(), out.end());
+			}
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	ASSERT_EQ(GetStats().bytes_encoded, stats_enabled ? threads * rounds * data.size() : 0);
+}
+
+// NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type,cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+} // namespace infectious::test
@@ -0,0 +1,347 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <optional>
+#include <system_error>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "infectious/fec.hpp"
+#include "infectious/stream.hpp"
+#include "infectious/uring.hpp"
+#include "random_env.hpp"
+
+#if defined(INFECTIOUS_TARGET_OS_HAS_IO_URING)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace infectious::test {
+
+// clang-tidy doesn't much care for gtest's macros.
+// NOLINTBEGIN(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+// random_chunks feeds data to fn in randomly sized chunks.
+template <typename Func>
+void random_chunks(ByteView data, size_t max_chunk, Func fn) {
+	while (!data.empty()) {
+		const size_t len = std::min(data.size(), 1 + static_cast<size_t>(random_env->randn(static_cast<int>(max_chunk))));
+		fn(data.substr(0, len));
+		data.remove_prefix(len);
+	}
+}
+
+TEST(Stream, RoundTrip) {
+	const int total = 9;
+	const int required = 4;
+	const size_t stripe_size = 1000;
+	const size_t length = 4 * stripe_size * 7 + 1234;
+	const int byte_limit = 256;
+
+	FEC fec(required, total);
+
+	std::vector<uint8_t> data(length);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> shares;
+	auto collect = [&](int num, ByteView piece) {
+		shares[num].insert(shares[num].end(), piece.begin(), piece.end());
+	};
+
+	StreamEncoder encoder(fec, stripe_size);
+	random_chunks(ByteView(data.data(), data.size()), 3 * stripe_size, [&](ByteView chunk) {
+		encoder.Write(chunk, collect);
+	});
+	const size_t padding = encoder.Finish(collect);
+	ASSERT_EQ((length + padding) % required, 0);
+	ASSERT_EQ(shares[0].size(), (length + padding) / required);
+
+	// every stripe is an independent encoding of its slice of the data.
+	std::map<int, std::vector<uint8_t>> first_stripe;
+	fec.Encode(ByteView(data.data(), required * stripe_size), [&](int num, ByteView piece) {
+		first_stripe[num] = std::vector(piece.begin(), piece.end());
+	});
+	for (int i = 0; i < total; ++i) {
+		ASSERT_TRUE(std::equal(first_stripe[i].begin(), first_stripe[i].end(), shares[i].begin())) << "share " << i;
+	}
+
+	// decode from a mix of shares, one of them corrupted, each arriving in
+	// its own chunks.
+	shares[6][stripe_size + 3] ^= 1;
+	std::vector<int> nums {1, 2, 5, 6, 7, 8};
+	StreamDecoder decoder(fec, stripe_size, nums);
+
+	std::vector<uint8_t> got;
+	auto append = [&](ByteView chunk) {
+		got.insert(got.end(), chunk.begin(), chunk.end());
+	};
+	for (auto num : nums) {
+		random_chunks(ByteView(shares[num].data(), shares[num].size()), 2 * stripe_size, [&](ByteView chunk) {
+			decoder.Write(num, chunk, append);
+		});
+	}
+	decoder.Finish(append);
+
+	got.resize(length);
+	ASSERT_EQ(got, data);
+
+	ASSERT_THROW(decoder.Write(0, ByteView(), append), std::invalid_argument);
+	ASSERT_THROW(StreamDecoder(fec, stripe_size, std::vector<int>{1, 2, 3}), NotEnoughShares);
+}
+
+// A share given all at once runs far ahead of the others, which are given
+// a chunk at a time in turn, so that stripes complete at every offset into
+// the buffers.
+TEST(Stream, DecodeUneven) {
+	const int total = 6;
+	const int required = 3;
+	const size_t stripe_size = 100;
+	const size_t length = required * stripe_size * 40 + 17;
+	const int byte_limit = 256;
+
+	FEC fec(required, total);
+
+	std::vector<uint8_t> data(length);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> shares;
+	auto collect = [&](int num, ByteView piece) {
+		shares[num].insert(shares[num].end(), piece.begin(), piece.end());
+	};
+	StreamEncoder encoder(fec, stripe_size);
+	encoder.Write(ByteView(data.data(), data.size()), collect);
+	encoder.Finish(collect);
+
+	std::vector<int> nums {0, 2, 4, 5};
+	StreamDecoder decoder(fec, stripe_size, nums);
+
+	std::vector<uint8_t> got;
+	auto append = [&](ByteView chunk) {
+		got.insert(got.end(), chunk.begin(), chunk.end());
+	};
+
+	decoder.Write(nums[0], ByteView(shares[nums[0]].data(), shares[nums[0]].size()), append);
+	ASSERT_TRUE(got.empty());
+
+	std::map<int, size_t> written;
+	const size_t share_size = shares[nums[0]].size();
+	bool more = true;
+	while (more) {
+		more = false;
+		for (size_t i = 1; i < nums.size(); ++i) {
+			const int num = nums[i];
+			const size_t len = std::min(share_size - written[num], 1 + static_cast<size_t>(random_env->randn(static_cast<int>(2 * stripe_size))));
+			decoder.Write(num, ByteView(shares[num].data() + written[num], len), append);
+			written[num] += len;
+			more = more || written[num] < share_size;
+		}
+	}
+	decoder.Finish(append);
+
+	got.resize(length);
+	ASSERT_EQ(got, data);
+}
+
+TEST(Stream, Chunks) {
+	const int total = 7;
+	const int required = 3;
+	const size_t stripe_size = 500;
+	const size_t length = 3 * stripe_size * 5 + 321;
+	const int byte_limit = 256;
+
+	FEC fec(required, total);
+
+	std::vector<uint8_t> data(length);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> want;
+	auto collect = [&](int num, ByteView piece) {
+		want[num].insert(want[num].end(), piece.begin(), piece.end());
+	};
+	StreamEncoder encoder(fec, stripe_size);
+	encoder.Write(ByteView(data.data(), data.size()), collect);
+	const size_t want_padding = encoder.Finish(collect);
+
+	// the same pieces come out, stripe by stripe in share order, however
+	// the data is split up.
+	std::map<int, std::vector<uint8_t>> got;
+	int next = 0;
+	auto take = [&](Generator<ShareChunk> chunks) {
+		for (const auto& chunk : chunks) {
+			ASSERT_EQ(chunk.num, next);
+			next = (next + 1) % total;
+			got[chunk.num].insert(got[chunk.num].end(), chunk.data.begin(), chunk.data.end());
+		}
+	};
+	StreamEncoder chunked(fec, stripe_size);
+	random_chunks(ByteView(data.data(), data.size()), 2 * stripe_size, [&](ByteView part) {
+		take(chunked.Chunks(part));
+	});
+	auto [last, padding] = chunked.FinishChunks();
+	take(std::move(last));
+	ASSERT_EQ(next, 0);
+	ASSERT_EQ(padding, want_padding);
+	ASSERT_EQ(got, want);
+
+	// there is nothing left to finish.
+	auto [none, none_padding] = chunked.FinishChunks();
+	ASSERT_EQ(none_padding, 0);
+	ASSERT_EQ(none.begin(), none.end());
+
+	// nothing is encoded ahead of what has been taken.
+	StreamEncoder lazy(fec, stripe_size);
+	auto chunks = lazy.Chunks(ByteView(data.data(), data.size()));
+	auto it = chunks.begin();
+	ASSERT_EQ(it->num, 0);
+	ASSERT_EQ(it->data.data(), data.data());
+}
+
+#if defined(INFECTIOUS_TARGET_OS_HAS_IO_URING)
+
+// MemFile is an anonymous file that is closed when it goes out of scope.
+class MemFile {
+public:
+	MemFile()
+		: fd {::memfd_create("infectious-test", 0)}
+	{}
+	MemFile(const MemFile&) = delete;
+	MemFile(MemFile&&) = delete;
+	auto operator=(const MemFile&) -> MemFile& = delete;
+	auto operator=(MemFile&&) -> MemFile& = delete;
+	~MemFile() {
+		::close(fd);
+	}
+
+	[[nodiscard]] auto contents() const -> std::vector<uint8_t> {
+		std::vector<uint8_t> out(static_cast<size_t>(::lseek(fd, 0, SEEK_END)));
+		EXPECT_EQ(::pread(fd, out.data(), out.size(), 0), static_cast<ssize_t>(out.size()));
+		return out;
+	}
+
+	int fd;
+};
+
+TEST(Stream, UringShareWriter) {
+	const int total = 6;
+	const int required = 4;
+	const size_t stripe_size = 4096;
+	const size_t length = 4 * stripe_size * 3 + 777;
+	const int byte_limit = 256;
+
+	FEC fec(required, total);
+
+	std::vector<uint8_t> data(length);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(random_env->randn(byte_limit));
+	}
+
+	std::map<int, std::vector<uint8_t>> want;
+	StreamEncoder encoder(fec, stripe_size);
+	auto collect = [&](int num, ByteView piece) {
+		want[num].insert(want[num].end(), piece.begin(), piece.end());
+	};
+	encoder.Write(ByteView(data.data(), data.size()), collect);
+	encoder.Finish(collect);
+
+	std::vector<MemFile> files(total);
+	std::vector<int> fds;
+	for (const auto& file : files) {
+		ASSERT_GE(file.fd, 0);
+		fds.push_back(file.fd);
+	}
+	// share 2 is not wanted.
+	fds[2] = -1;
+
+	std::optional<UringShareWriter> writer;
+	try {
+		writer.emplace(fec, fds);
+	} catch (const std::system_error& e) {
+		GTEST_SKIP() << "io_uring unavailable: " << e.what();
+	}
+
+	StreamEncoder chunked(fec, stripe_size);
+	writer->RegisterBuffers(chunked);
+	random_chunks(ByteView(data.data(), data.size()), 3 * stripe_size, [&](ByteView part) {
+		writer->Write(chunked.Chunks(part));
+	});
+	writer->Write(chunked.FinishChunks().first);
+
+	for (int i = 0; i < total; ++i) {
+		if (i == 2) {
+			ASSERT_TRUE(files[static_cast<size_t>(i)].contents().empty());
+		} else {
+			ASSERT_EQ(files[static_cast<size_t>(i)].contents(), want[i]) << "share " << i;
+		}
+	}
+
+	// there must be a file descriptor for every share, no more and no less.
+	std::vector<int> extra = fds;
+	extra.push_back(-1);
+	ASSERT_THROW(UringShareWriter(fec, extra), std::invalid_argument);
+
+	// a failed write is reported once the stripe is done with.
+	fds[2] = ::open("/dev/null", O_RDONLY); // NOLINT(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+	ASSERT_GE(fds[2], 0);
+	UringShareWriter bad(fec, fds);
+	StreamEncoder failing(fec, stripe_size);
+	try {
+		bad.Write(failing.Chunks(ByteView(data.data(), data.size())));
+		ADD_FAILURE() << "write to a read-only file descriptor succeeded";
+	} catch (const std::system_error& e) {
+		ASSERT_EQ(e.code().value(), EBADF) << e.what();
+	}
+	::close(fds[2]);
+}
+
+auto single_chunk(ShareChunk chunk) -> Generator<ShareChunk> {
+	co_yield chunk;
+}
+
+// A piece of 4 GiB or more does not fit in one submission, whose length is
+// 32 bits. The piece is a never touched mapping, and /dev/null does not read
+// it, so this is cheap.
+TEST(Stream, UringLargePiece) {
+	const int fd = ::open("/dev/null", O_WRONLY); // NOLINT(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+	ASSERT_GE(fd, 0);
+	const std::vector<int> fds {fd, -1};
+
+	const size_t size = (4UL << 30) + 1;
+	void* mem = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mem == MAP_FAILED) {
+		::close(fd);
+		GTEST_SKIP() << "could not map " << size << " bytes";
+	}
+
+	FEC fec(1, 2);
+	std::optional<UringShareWriter> writer;
+	try {
+		writer.emplace(fec, fds);
+	} catch (const std::system_error& e) {
+		::close(fd);
+		::munmap(mem, size);
+		GTEST_SKIP() << "io_uring unavailable: " << e.what();
+	}
+
+	EXPECT_NO_THROW(writer->Write(single_chunk({0, ByteView(static_cast<const uint8_t*>(mem), size)})));
+	// exactly 4 GiB used to be submitted as an empty write.
+	EXPECT_NO_THROW(writer->Write(single_chunk({0, ByteView(static_cast<const uint8_t*>(mem), size - 1)})));
+
+	::close(fd);
+	::munmap(mem, size);
+}
+
+#endif
+
+// NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+} // namespace infectious::test
@@ -0,0 +1,204 @@
+// Copyright (C) 2022 Storj Labs, Inc.
+// See LICENSE for copying information.
+
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "infectious/fec.hpp"
+#include "infectious/workspace.hpp"
+#include "random_env.hpp"
+
+// every heap allocation in the test binary, and in the library, goes through
+// these, so that the tests below can count them.
+
+namespace {
+
+std::atomic<size_t> allocations {0};
+
+} // namespace
+
+// NOLINTBEGIN(cppcoreguidelines-no-malloc,cppcoreguidelines-owning-memory)
+
+// once these are inlined, GCC sees memory from operator new passed to free,
+// and warns of a mismatch without noticing that both were replaced.
+#if defined(__GNUC__) && !defined(__clang__)
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+auto operator new(size_t size) -> void* {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size == 0 ? 1 : size)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t /*size*/) noexcept {
+	std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+# pragma GCC diagnostic pop
+#endif
+
+// NOLINTEND(cppcoreguidelines-no-malloc,cppcoreguidelines-owning-memory)
+
+namespace infectious::test {
+
+// clang-tidy doesn't much care for gtest's macros.
+// NOLINTBEGIN(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+TEST(Workspace, Scopes) {
+	Workspace ws;
+	{
+		const Workspace::Scope outer(ws);
+		auto a = ws.Allocate<uint8_t>(100);
+		{
+			const Workspace::Scope inner(ws);
+			auto b = ws.Allocate<uint64_t>(1);
+			ASSERT_EQ(reinterpret_cast<uintptr_t>(b.data()) % alignof(uint64_t), 0); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+			ASSERT_GE(reinterpret_cast<uintptr_t>(b.data()), reinterpret_cast<uintptr_t>(a.data() + a.size())); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+		}
+		// closing the inner scope hands its memory back out again.
+		{
+			const Workspace::Scope inner(ws);
+			auto c = ws.Allocate<uint8_t>(1);
+			ASSERT_EQ(c.data(), a.data() + a.size());
+		}
+	}
+
+	// outgrowing the first chunk needs more of them, but once everything is
+	// released they are merged, so the same again needs nothing new.
+	{
+		const Workspace::Scope scope(ws);
+		for (int i = 0; i < 10; i++) {
+			(void)ws.Allocate<uint8_t>(100000);
+		}
+	}
+	const auto capacity = ws.Capacity();
+	ASSERT_GE(capacity, 1000000);
+	const auto before = allocations.load();
+	{
+		const Workspace::Scope scope(ws);
+		for (int i = 0; i < 10; i++) {
+			(void)ws.Allocate<uint8_t>(100000);
+		}
+	}
+	ASSERT_EQ(allocations.load(), before);
+	ASSERT_EQ(ws.Capacity(), capacity);
+}
+
+// However much is needed at once, no more than max_retained is held on to
+// afterwards, and Release gives back the rest.
+TEST(Workspace, RetainedCap) {
+	Workspace ws;
+	const size_t piece = Workspace::max_retained / 4 + 1;
+	{
+		const Workspace::Scope scope(ws);
+		for (int i = 0; i < 12; i++) {
+			(void)ws.Allocate<uint8_t>(piece);
+		}
+		ASSERT_GE(ws.Capacity(), 12 * piece);
+	}
+	ASSERT_GT(ws.Capacity(), 0);
+	ASSERT_LE(ws.Capacity(), Workspace::max_retained);
+
+	// what is kept is still reused.
+	const auto capacity = ws.Capacity();
+	const auto before = allocations.load();
+	{
+		const Workspace::Scope scope(ws);
+		(void)ws.Allocate<uint8_t>(piece);
+	}
+	ASSERT_EQ(allocations.load(), before);
+	ASSERT_EQ(ws.Capacity(), capacity);
+
+	{
+		const Workspace::Scope scope(ws);
+		ASSERT_THROW(ws.Release(), std::logic_error);
+	}
+	ws.Release();
+	ASSERT_EQ(ws.Capacity(), 0);
+}
+
+TEST(Workspace, SteadyStateAllocations) {
+	const int required = 4;
+	const int total = 8;
+	const int block = 4096;
+
+	for (const bool cached : {false, true}) {
+		FEC fec(required, total);
+		if (cached) {
+			fec.EnableDecodeCache(4);
+			fec.EnableSyndromeCache(4);
+		}
+
+		std::vector<uint8_t> data(required * block);
+		for (auto& b : data) {
+			b = static_cast<uint8_t>(random_env->randn(256));
+		}
+
+		std::vector<std::vector<uint8_t>> pieces(total, std::vector<uint8_t>(block));
+		std::vector<uint8_t*> outputs;
+		for (auto& piece : pieces) {
+			outputs.push_back(piece.data());
+		}
+		std::vector<uint8_t> single(block);
+		std::vector<uint8_t> decoded(data.size());
+
+		// the share maps and callbacks are set up ahead of time, so that only
+		// the library itself is being counted.
+		std::map<int, std::span<uint8_t>> shares;
+		for (int i = 0; i < total; i++) {
+			shares.try_emplace(i, pieces[i]);
+		}
+		std::map<int, std::span<uint8_t>> parity_only;
+		for (int i = total - required; i < total; i++) {
+			parity_only.try_emplace(i, pieces[i]);
+		}
+		size_t seen = 0;
+		const ShareOutputFunc sink = [&seen](int, ByteView piece) {
+			seen += piece.size();
+		};
+
+		auto run = [&] {
+			fec.Encode(data, sink);
+			fec.EncodeInto(data, std::span<uint8_t* const>(outputs));
+			fec.EncodeParity(data, std::span<uint8_t* const>(&outputs[required], total - required));
+			fec.EncodeSingle(total - 1, data.begin(), data.end(), single.begin(), single.end());
+			fec.Rebuild(parity_only, sink);
+			ASSERT_TRUE(fec.Verify(shares));
+			fec.Correct(shares);
+
+			// corrupt a few bytes of one share, for Decode to fix.
+			for (int i = 0; i < 8; i++) {
+				pieces[1][random_env->randn(block)] ^= 0x5a;
+			}
+			ASSERT_EQ(fec.Decode(shares, decoded), data.size());
+			ASSERT_EQ(decoded, data);
+		};
+
+		run();
+		const auto before = allocations.load();
+		for (int i = 0; i < 10; i++) {
+			run();
+		}
+		ASSERT_EQ(allocations.load(), before) << "cached " << cached;
+		ASSERT_GT(seen, 0);
+	}
+}
+
+// NOLINTEND(cert-err58-cpp,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+} // namespace infectious::test